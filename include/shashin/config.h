@@ -1,6 +1,8 @@
 #pragma once
 
+#include <shashin/util/encoder.h>
 #include <shashin/util/filesystem.h>
+#include <shashin/util/io.h>
 #include <string>
 
 namespace shashin {
@@ -29,6 +31,53 @@ public:
     auto salt_small() const -> std::string const&;
     auto salt_medium() const -> std::string const&;
     auto salt_large() const -> std::string const&;
+    auto checkpoint_size() const -> int;
+    auto checkpoint_interval() const -> int;
+    auto snapshot_interval() const -> int;
+    auto io_backend() const -> util::IoBackend;
+    auto exif_header_size() const -> std::size_t;
+    auto exif_batch_size() const -> int;
+    auto image_batch_size() const -> int;
+    auto benchmark_size() const -> int;
+    auto streaming_threshold() const -> long long;
+    auto deepzoom_file() const -> std::string const&;
+    auto deepzoom_tile_size() const -> int;
+    auto deepzoom_overlap() const -> int;
+    auto deepzoom_batch_size() const -> int;
+    auto deepzoom_encoder_settings() const -> util::EncoderSettings const&;
+    auto sprites() const -> bool;
+    auto sprite_columns() const -> int;
+    auto sprite_rows() const -> int;
+    auto search_dir() const -> std::string const&;
+    auto search_prefix_length() const -> int;
+    auto map_dir() const -> std::string const&;
+    auto map_max_zoom() const -> int;
+    auto map_tile_size() const -> int;
+    auto map_cluster_size() const -> int;
+    auto passthrough_min_quality() const -> int;
+    auto passthrough_max_quality() const -> int;
+    auto jpeg_quality() const -> int;
+    auto encoder_backend() const -> util::EncoderBackend;
+    auto small_encoder_settings() const -> util::EncoderSettings const&;
+    auto medium_encoder_settings() const -> util::EncoderSettings const&;
+    auto large_encoder_settings() const -> util::EncoderSettings const&;
+    auto quality_search() const -> bool;
+    auto quality_target_ssim() const -> double;
+    auto quality_min() const -> int;
+    auto quality_max() const -> int;
+    auto quality_crop_size() const -> int;
+    auto quality_crop_count() const -> int;
+    auto pages() const -> bool;
+    auto pages_dir() const -> std::string const&;
+    auto templates_dir() const -> std::string const&;
+    auto serve_port() const -> int;
+    auto serve_chunk_size() const -> int;
+    auto serve_timeout() const -> int;
+    auto duplicate_distance() const -> int;
+    auto skip_duplicates() const -> bool;
+    auto newest_first() const -> bool;
+    auto priority_file() const -> std::string;
+    auto partial_export_interval() const -> int;
 
 private:
     std::string const m_current_time{""};
@@ -63,6 +112,65 @@ private:
     int const m_medium_size{800};
     int const m_large_size{1440};
 
+    int const m_checkpoint_size{64}; // images per commit
+    int const m_checkpoint_interval{10}; // seconds between commits
+    int const m_snapshot_interval{300}; // seconds between write backs of an in-memory database
+
+    util::IoBackend const m_io_backend{util::io_backend_default()};
+    std::size_t const m_exif_header_size{128 * 1024}; // the EXIF segment is limited to 64 KiB right after SOI
+    int const m_exif_batch_size{64}; // EXIF headers in flight per worker
+    int const m_image_batch_size{4}; // source images in flight per worker
+    int const m_benchmark_size{1000}; // images read and written per benchmark pass
+    long long const m_streaming_threshold{50000000}; // source pixels above which JPEGs are downscaled while decoding
+    int const m_passthrough_min_quality{50}; // JPEG quality range of sources that are served as they are when they fit a tier
+    int const m_passthrough_max_quality{90};
+
+    int const m_jpeg_quality{80}; // of every tier unless the quality is searched
+    util::EncoderBackend const m_encoder_backend{util::encoder_backend_default()};
+    // quality, progressive, optimize, subsampling, trellis; small tiers are many and favour speed, large ones favour size
+    util::EncoderSettings const m_small_encoder_settings{80, false, true, 420, false};
+    util::EncoderSettings const m_medium_encoder_settings{80, true, true, 420, false};
+    util::EncoderSettings const m_large_encoder_settings{80, true, true, 420, true};
+    bool const m_quality_search{true}; // per image and tier the lowest quality that reaches the SSIM target
+    double const m_quality_target_ssim{0.98};
+    int const m_quality_min{50};
+    int const m_quality_max{92};
+    int const m_quality_crop_size{256}; // the search encodes crops of the tier at its own resolution, a multiple of 16 keeps the blocks aligned
+    int const m_quality_crop_count{4};
+
+    std::string const m_deepzoom_file{".deepzoom"}; // in a gallery directory, empty for all images or one image name per line
+    int const m_deepzoom_tile_size{256};
+    int const m_deepzoom_overlap{1};
+    int const m_deepzoom_batch_size{16}; // tiles encoded per worker batch
+    util::EncoderSettings const m_deepzoom_encoder_settings{80, false, true, 420, false}; // tiles are small and shown at once, baseline suits them
+
+    bool const m_sprites{true}; // pack the small tiers of each node into sprite sheets
+    int const m_sprite_columns{10};
+    int const m_sprite_rows{10};
+
+    std::string const m_search_dir{"search"}; // below the cache, the index is fetched by the browser
+    int const m_search_prefix_length{2}; // leading token bytes that pick the shard
+
+    std::string const m_map_dir{"map"}; // below the cache, marker tiles as <zoom>/<x>/<y>.json
+    int const m_map_max_zoom{14}; // deeper zoom levels reuse these tiles
+    int const m_map_tile_size{256};
+    int const m_map_cluster_size{64}; // pixels of a clustering grid cell, a power of two below the tile size
+
+    bool const m_pages{false}; // render gallery and image pages instead of leaving them to Jekyll
+    std::string const m_pages_dir{"gallery"}; // below the site, one directory per node url
+    std::string const m_templates_dir{"_templates"}; // in the project, <name>.html there replaces the built-in template
+
+    int const m_serve_port{8080}; // on 127.0.0.1 only
+    int const m_serve_chunk_size{32}; // images rendered in the background between two looks at the requested ones
+    int const m_serve_timeout{120}; // seconds a request waits for its tier
+
+    int const m_duplicate_distance{6}; // differing bits of the perceptual hashes up to which two images count as near duplicates
+    bool const m_skip_duplicates{false}; // medium and large tier of a near duplicate become links to the ones of the image it duplicates
+
+    bool const m_newest_first{true}; // nodes added by a later run are processed first, among them the one captured last
+    std::string const m_priority_file{".priority"}; // in the gallery, one node path per line whose images are processed before all others in that order
+    int const m_partial_export_interval{60}; // seconds between exports of the completed nodes while processing, 0 exports only at the end
+
     std::string m_salt_small;
     std::string m_salt_medium;
     std::string m_salt_large;
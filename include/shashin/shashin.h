@@ -4,34 +4,81 @@
 #include <shashin/util/filesystem.h>
 #include <shashin/util/time.h>
 #include <shashin/util/sqlite.h>
+#include <shashin/util/template.h>
 #include <string>
+#include <tuple>
+#include <vector>
+#include <unordered_map>
 
 namespace shashin {
 
 class Shashin {
 public:
-    Shashin(fs::path const& project_path = fs::current_path(), std::string const& watermark_text = "");
+    Shashin(fs::path const& project_path = fs::current_path(), std::string const& watermark_text = "", bool in_memory_database = false);
     ~Shashin();
 
+    auto run() const -> void;
+    auto benchmark() const -> void;
+    auto exif() const -> void;
+    auto search(std::string const& query) const -> void;
+    auto changed_since(long long generation) const -> void;
+    auto duplicates() const -> void;
+    auto serve() const -> void;
+
 private:
     Config m_config;
     sqlite3* m_db{nullptr};
+    bool m_in_memory{false};
+    long long m_generation{0}; // rows inserted or changed by this run carry it
 
-    auto open_database() -> void;
+    auto open_database(bool in_memory = false) -> void;
     auto close_database() -> void;
+    auto save_database() const -> void;
+    auto migrate_database() const -> void;
     auto exec_query(std::string const& query, int (*callback)(void*, int argc, char**, char**) = nullptr, void* dst = nullptr) const -> void;
     auto exec_transaction(char const* const query, std::function<void(sqlite3_stmt* stmt)> func) const -> void;
 
     auto create_directories() const -> void;
+    auto remove_stray_files() const -> void;
     auto is_gallery(std::string const& name) const -> bool;
     auto gallery_parts(std::string const& name) const -> std::tuple<std::string, std::string, std::string, std::string, std::string, std::string>;
 
+    auto load_priorities() const -> std::vector<std::string>;
+
+    auto load_failures() const -> std::unordered_map<std::string, std::tuple<long long, long long>>;
+    auto is_quarantined(std::unordered_map<std::string, std::tuple<long long, long long>> const& failures, std::string const& path) const -> bool;
+    auto insert_failures(std::vector<std::tuple<std::string, std::string, std::string>> const& failures) const -> void;
+    auto delete_failures(std::vector<std::string> const& paths) const -> void;
+
+    auto export_signature() const -> std::string;
+    auto load_export_signatures() const -> std::unordered_map<std::string, std::string>;
+    auto store_export_signatures(std::vector<std::string> const& names, std::string const& signature) const -> void;
+    auto store_export_signatures(std::vector<std::tuple<std::string, std::string>> const& signatures) const -> void;
+    auto load_template(std::string const& name) const -> std::tuple<util::Template, std::string>;
+
+    auto manifest_entry(fs::path const& path, std::vector<unsigned char> const& data, bool immutable) const -> std::tuple<std::string, long long, std::string, bool>;
+    auto manifest_entries(std::vector<fs::path> const& paths, bool immutable) const -> std::vector<std::tuple<std::string, long long, std::string, bool>>;
+    auto store_manifest(std::vector<std::tuple<std::string, long long, std::string, bool>> const& entries) const -> void;
+    auto sweep_manifest() const -> void;
+
     auto sync_nodes() const -> void;
     auto sync_images() const -> void;
-    auto update_exif() const -> void;
+    auto dictionary_ids(std::vector<std::tuple<bool, std::string, double, double, int, double, int, int, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, int, double, double, double>> const& infos, std::vector<size_t> const& indices) const -> std::vector<std::tuple<long long, long long, long long>>;
+    auto update_exif(bool all = false) const -> void;
+    auto store_sidecars(std::vector<std::tuple<std::string, bool, std::tuple<int, std::string, int, std::string, std::vector<std::string>>>> const& sidecars) const -> void;
     auto dump_list_html() const -> void;
     auto create_gallery_files() const -> void;
-    auto process_images() const -> void;
+    auto create_aggregate_files() const -> void;
+    auto create_search_index() const -> void;
+    auto create_map_tiles() const -> void;
+    auto create_pages() const -> void;
+    auto compress_outputs() const -> void;
+    auto read_sources(std::vector<fs::path> const& paths) const -> std::vector<std::tuple<std::vector<unsigned char>, std::string>>;
+    auto process_images(std::vector<std::string> const& paths = {}) const -> void;
+    auto process_deepzoom() const -> void;
+    auto create_sprites() const -> void;
+    auto remove_stale_sprites() const -> void;
+    auto print_failures() const -> void;
 };
 
 } // namespace shashin
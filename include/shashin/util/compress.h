@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+enum class Compression {
+    gzip,
+    brotli,
+};
+
+// file extension of the precompressed sibling, ".gz" or ".br"
+auto compression_extension(Compression compression) -> std::string;
+
+// gzip always, brotli if it was compiled in
+auto compressions_available() -> std::vector<Compression>;
+
+// at the maximum level, the outputs are compressed once per change and served many times
+auto compress(std::vector<unsigned char> const& data, Compression compression) -> std::vector<unsigned char>;
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+namespace shashin {
+namespace util {
+
+enum class EncoderBackend {
+    opencv,
+    libjpeg,
+};
+
+auto encoder_backend_name(EncoderBackend backend) -> std::string;
+
+// libjpeg if it was compiled in, OpenCV otherwise
+auto encoder_backend_default() -> EncoderBackend;
+
+// subsampling is 444, 422 or 420; trellis quantization only exists in mozjpeg and is ignored elsewhere,
+// OpenCV only knows quality, progressive and optimize
+struct EncoderSettings {
+    int quality{80};
+    bool progressive{true};
+    bool optimize{true};
+    int subsampling{420};
+    bool trellis{false};
+};
+
+} // namespace util
+} // namespace shashin
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <tuple>
 #if 0
 #include <ghc/filesystem.hpp>
 namespace fs {
@@ -15,3 +16,22 @@ namespace fs = std::filesystem;
 #endif
 
 auto list_directory_recursive(fs::path const& base, std::function<bool(fs::path const& path)> const& condition) -> std::vector<fs::path>;
+
+namespace shashin {
+namespace util {
+
+// flushes a file or a directory to the disk, false if it cannot be opened or synced
+auto sync_path(fs::path const& path) -> bool;
+
+// writes to "<path>.tmp", syncs it and renames it over path, so neither readers nor a crash leave a partially written file;
+// the directory is synced as well unless the caller syncs it once for many files
+auto write_file_atomic(fs::path const& path, char const* data, std::size_t size, bool sync_directory = true) -> void;
+
+// makes path a hard link to target in the same way, or a copy where the file system cannot link
+auto link_file_atomic(fs::path const& target, fs::path const& path) -> void;
+
+// size and modification time in seconds, both -1 if the file cannot be stat'ed
+auto file_stat(fs::path const& path) -> std::tuple<long long, long long>;
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <tuple>
+
+namespace shashin {
+namespace util {
+
+// Web Mercator pixel position of a coordinate at a zoom level, the world is tile_size << zoom pixels wide
+auto lat_lon_to_pixel(double latitude, double longitude, int zoom, int tile_size) -> std::tuple<double, double>;
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+auto hamming_distance(std::uint64_t a, std::uint64_t b) -> int;
+
+// multi-index hashing: every hash is filed under each of its four 16 bit chunks; two hashes within distance
+// agree up to distance / 4 bits in at least one chunk, so only the buckets next to the chunks of a query are searched
+class HammingIndex {
+public:
+    explicit HammingIndex(int distance);
+
+    // ids are given out in the order of insertion
+    auto insert(std::uint64_t hash) -> std::size_t;
+    auto hash(std::size_t id) const -> std::uint64_t;
+    auto size() const -> std::size_t;
+
+    // ids of the hashes within the distance of the index, closest first
+    auto find(std::uint64_t hash) const -> std::vector<std::size_t>;
+
+private:
+    int m_distance;
+    std::vector<std::uint16_t> m_masks; // all chunk values with up to distance / 4 bits set
+    std::vector<std::uint64_t> m_hashes;
+    std::vector<std::vector<std::uint32_t>> m_buckets;
+};
+
+// groups of two or more hashes connected by pairs within distance, each sorted and ordered by their first id
+auto hamming_clusters(std::vector<std::uint64_t> const& hashes, int distance) -> std::vector<std::vector<std::size_t>>;
+
+} // namespace util
+} // namespace shashin
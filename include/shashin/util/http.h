@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+// status code, content type and body of a response
+using HttpResponse = std::tuple<int, std::string, std::vector<unsigned char>>;
+
+// content type by file extension, application/octet-stream for unknown ones
+auto mime_type(std::string const& path) -> std::string;
+
+// the path of a request target without query and fragment, percent escapes decoded
+auto url_decode_path(std::string const& target) -> std::string;
+
+// answers GET and HEAD requests on 127.0.0.1 only and for the host names 127.0.0.1 and localhost, one thread per connection so a slow response never blocks the others;
+// returns once stop() is true, checked a few times per second
+auto serve_http(int port, std::function<HttpResponse(std::string const& path)> const& handler, std::function<bool()> const& stop) -> void;
+
+} // namespace util
+} // namespace shashin
@@ -1,18 +1,66 @@
 #pragma once
 
 #include <opencv2/core.hpp>
+#include <cstdint>
+#include <memory>
 #include <tuple>
+#include <vector>
 #include <string>
+#include <shashin/util/encoder.h>
 #include <shashin/util/filesystem.h>
 
 namespace shashin {
 namespace util {
 
 auto watermark(cv::Mat& mat, std::string const& text = "", int fontsize = 32, int margin = 32, int thickness = 4) -> void;
-auto resize(cv::Mat& src_mat, fs::path const& dst_path, int size, std::string const& text = "", int fontsize = 32, int margin = 32, int thickness = 4) -> void;
-auto crop(cv::Mat& src_mat, fs::path const& dst_path, int cropped_width, int cropped_height, std::string const& text = "", int fontsize = 32, int margin = 32, int thickness = 4) -> void;
+auto resize(cv::Mat const& src_mat, int size, std::string const& text = "", int fontsize = 32, int margin = 32, int thickness = 4) -> cv::Mat;
+auto crop(cv::Mat const& src_mat, int cropped_width, int cropped_height, std::string const& text = "", int fontsize = 32, int margin = 32, int thickness = 4) -> cv::Mat;
 
-auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, double, double>;
+// encoders keep state between images, so every worker owns one; errors are thrown
+class Encoder {
+public:
+    virtual ~Encoder() = default;
+    virtual auto encode(cv::Mat const& mat, EncoderSettings const& settings) -> std::vector<unsigned char> = 0;
+};
+
+auto make_encoder(EncoderBackend backend) -> std::unique_ptr<Encoder>;
+
+// tiers are encoded into memory so the caller decides how they are written, errors are thrown
+auto encode_jpeg(cv::Mat const& mat, int quality = 80) -> std::vector<unsigned char>;
+
+// mean structural similarity of the luma of two images of the same size, 1 for identical images
+auto ssim(cv::Mat const& a, cv::Mat const& b) -> double;
+
+// the lowest quality in [min_quality, max_quality] whose encoding of crop_count crops of crop_size pixels, cut from mat at its own resolution,
+// still reaches target_ssim in every crop; returns the full size encoding at that quality and the quality, the other settings are used as they are
+auto encode_jpeg_targeted(Encoder& encoder, cv::Mat const& mat, EncoderSettings settings, double target_ssim, int min_quality, int max_quality, int crop_size, int crop_count) -> std::tuple<std::vector<unsigned char>, int>;
+auto decode_image(std::vector<unsigned char> const& buffer) -> cv::Mat;
+
+// blurhash, base64 data URI of a tiny JPEG and the dominant color as #rrggbb, meant to be computed from the small tier
+auto placeholders(cv::Mat const& mat) -> std::tuple<std::string, std::string, std::string>;
+
+// 64 bit DCT hash of the luma, near duplicates differ in a few bits only; meant to be computed from the small tier as well
+auto perceptual_hash(cv::Mat const& mat) -> std::uint64_t;
+
+// tiles are placed row by row, tiles of another size are scaled to tile_size first
+auto sprite_sheet(std::vector<cv::Mat> const& tiles, int columns, cv::Size const& tile_size) -> cv::Mat;
+
+// deep zoom tiles overlap their neighbours by overlap pixels, edge tiles are clipped to the level
+auto tile_rect(cv::Size const& level_size, int tile_size, int overlap, int col, int row) -> cv::Rect;
+auto deepzoom_next_level(cv::Mat const& level_mat) -> cv::Mat;
+auto deepzoom_manifest(cv::Size const& size, int tile_size, int overlap) -> std::string;
+
+// EXIF values are kept as numbers, the format functions turn them into the strings of the exported files
+auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, double, double, int, double, int, int, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, int, double, double, double>;
+auto exif_info(unsigned char const* data, std::size_t size) -> std::tuple<bool, std::string, double, double, int, double, int, int, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, int, double, double, double>;
+auto format_fstop(double fstop) -> std::string;
+auto format_exposure_time(double exposure_time) -> std::string;
+auto format_iso_speed(int iso_speed) -> std::string;
+auto format_exposure_bias(double exposure_bias) -> std::string;
+auto format_flash(int flash) -> std::string;
+auto format_metering_mode(int metering_mode) -> std::string;
+auto format_focal_length(double focal_length) -> std::string;
+auto format_gps(double latitude, double longitude) -> std::string;
 
 } // namespace util
 } // namespace shashin
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <shashin/util/filesystem.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+enum class IoBackend {
+    blocking,
+    uring,
+};
+
+auto io_backend_name(IoBackend backend) -> std::string;
+
+// io_uring if it was compiled in and the kernel supports it, blocking otherwise
+auto io_backend_default() -> IoBackend;
+
+// reads every file (only its first head_size bytes if head_size > 0), each entry holds the data or an error message;
+// with io_uring all reads of the list are in flight at once instead of one per calling thread
+auto read_files(std::vector<fs::path> const& paths, IoBackend backend, std::size_t head_size = 0) -> std::vector<std::tuple<std::vector<unsigned char>, std::string>>;
+
+// reads length bytes at offset of every file (up to its end if length is 0), e.g. the embedded preview of a RAW file
+auto read_file_ranges(std::vector<std::tuple<fs::path, std::size_t, std::size_t>> const& ranges, IoBackend backend) -> std::vector<std::tuple<std::vector<unsigned char>, std::string>>;
+
+// writes every buffer to "<path>.tmp", syncs it and renames it over path, then syncs each directory once; each entry holds an error message or is empty
+auto write_files_atomic(std::vector<std::tuple<fs::path, std::vector<unsigned char>>> const& files, IoBackend backend) -> std::vector<std::string>;
+
+// drops the files from the page cache where the platform allows it, so benchmarks start cold
+auto evict_files(std::vector<fs::path> const& paths) -> void;
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <shashin/util/image.h>
+#include <opencv2/core.hpp>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+// image size from the SOF marker without decoding anything, empty if the data is no JPEG
+auto jpeg_size(std::vector<unsigned char> const& buffer) -> cv::Size;
+
+// libjpeg quality setting that reproduces the luminance quantization table, 0 if the data has none
+auto jpeg_quality(std::vector<unsigned char> const& buffer) -> int;
+
+// the JPEG without EXIF, XMP, IPTC and comments, ready to be served as it is; empty if it is no baseline or progressive
+// Huffman JPEG with one or three components or if dropping the EXIF orientation would turn it
+auto jpeg_passthrough(std::vector<unsigned char> const& buffer) -> std::vector<unsigned char>;
+
+// decodes the JPEG in scanline strips and area averages them on the fly, so the full resolution image never exists in memory;
+// returns the image with size as its long edge and the oriented source size, or an empty Mat if libjpeg cannot stream it
+auto decode_jpeg_downscaled(std::vector<unsigned char> const& buffer, int size) -> std::tuple<cv::Mat, cv::Size>;
+
+// encodes straight into a buffer that is kept for the next image, nullptr if libjpeg was not compiled in
+auto make_libjpeg_encoder() -> std::unique_ptr<Encoder>;
+
+} // namespace util
+} // namespace shashin
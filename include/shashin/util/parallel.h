@@ -2,11 +2,59 @@
 
 #include <thread>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 namespace shashin {
 namespace util {
 
 auto process_parallel(std::function<void(int worker_number, int lower_bound, int upper_bound)> process_func, int list_size, int worker_size = int(std::thread::hardware_concurrency())) -> void;
 
+// hands out batch_size items at a time, so workers stay busy when items differ a lot in cost
+auto process_parallel_dynamic(std::function<void(int worker_number, int lower_bound, int upper_bound)> process_func, int list_size, int batch_size = 1, int worker_size = int(std::thread::hardware_concurrency())) -> void;
+
+// first SIGINT/SIGTERM only raises the flag so workers can stop and pending results get committed, a second one terminates
+auto install_interrupt_handler() -> void;
+auto interrupted() -> bool;
+
+// unbounded multi producer queue, pop blocks until an item arrives or the queue is closed and drained
+template<typename T>
+class Queue {
+public:
+    auto push(T item) -> void {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_items.push_back(std::move(item));
+        }
+        m_cv.notify_one();
+    }
+
+    auto pop(T& item) -> bool {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_cv.wait(lock, [this]() { return !m_items.empty() || m_closed; });
+        if (m_items.empty()) {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+
+    auto close() -> void {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_closed = true;
+        }
+        m_cv.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<T> m_items;
+    bool m_closed{false};
+};
+
 } // namespace util
 } // namespace shashin
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <shashin/util/filesystem.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+// NEF, NRW, CR2, ARW and DNG files are TIFF containers, any case of the extension counts
+auto is_raw(fs::path const& path) -> bool;
+
+// offset and length of the largest baseline or progressive JPEG embedded in a TIFF based RAW file and the orientation of IFD0;
+// only the IFDs and the marker segments of the candidates are read, never the image data; an error if there is no such JPEG
+auto raw_preview(fs::path const& path) -> std::tuple<std::size_t, std::size_t, int, std::string>;
+
+// IFD0 with the EXIF and GPS IFD of a TIFF based RAW file as a compact TIFF structure for exif_info; only the IFDs and their values
+// are read wherever they are in the file, maker notes and other values above 64 KiB are left out
+auto raw_exif(fs::path const& path) -> std::tuple<std::vector<unsigned char>, std::string>;
+
+// previews carry no orientation of their own, an EXIF segment with the one of the RAW file lets decoders turn them;
+// a preview that already has an EXIF segment is left as it is
+auto orient_preview(std::vector<unsigned char>& buffer, int orientation) -> void;
+
+} // namespace util
+} // namespace shashin
@@ -11,5 +11,8 @@ auto sqlite3_bind_string_or_null(sqlite3_stmt* stmt, int i, std::string const& s
 auto sqlite3_bind_double_or_null(sqlite3_stmt* stmt, int i, double value, bool valid = true) -> void;
 auto sqlite3_bind_int_or_null(sqlite3_stmt* stmt, int i, int value, bool valid = true) -> void;
 
+// copies the main database of src over the one of dst with the online backup API
+auto sqlite3_copy(sqlite3* src, sqlite3* dst) -> int;
+
 } // namespace util
 } // namespace shashin
@@ -13,6 +13,7 @@ auto double_to_string(double value, int precision = 0) -> std::string;
 auto str_split(const std::string& str, const std::string& delim) -> std::vector<std::string>;
 auto make_zero_empty(std::string& input) -> void;
 auto remove_precision(std::string& input) -> void;
+auto base64_encode(unsigned char const* data, std::size_t size) -> std::string;
 
 namespace stackoverflow {
 auto load_file_binary(std::string const& path) -> std::vector<std::byte>;
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+// the five characters that are special in HTML text and attribute values
+auto html_escape(std::string const& str) -> std::string;
+
+// a subset of mustache, parsed once and rendered many times against JSON:
+// {{name}} escaped, {{{name}}} and {{&name}} raw, {{#name}}...{{/name}} once per list item or once for any other truthy value,
+// {{^name}}...{{/name}} for false, null, 0, "" and empty lists, {{!comment}}, dotted names and {{.}} for the current item
+class Template {
+public:
+    // throws std::runtime_error on unclosed tags and unbalanced sections
+    explicit Template(std::string const& source);
+
+    auto render(nlohmann::json const& context) const -> std::string;
+
+private:
+    enum class Kind {
+        text,
+        escaped,
+        raw,
+        section,
+        inverted,
+    };
+
+    struct Node {
+        Kind kind;
+        std::string value; // the text, or the name of a tag
+        std::vector<Node> children; // of a section
+    };
+
+    std::vector<Node> m_nodes;
+
+    static auto parse(std::string const& source, size_t& pos, std::string const& closing) -> std::vector<Node>;
+    static auto lookup(std::vector<nlohmann::json const*> const& stack, std::string const& name) -> nlohmann::json const*;
+    static auto render(std::vector<Node> const& nodes, std::vector<nlohmann::json const*>& stack, std::string& out) -> void;
+};
+
+} // namespace util
+} // namespace shashin
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace shashin {
 namespace util {
@@ -9,6 +10,7 @@ auto to_slash(std::string const& str) -> std::string const;
 auto to_backslash(std::string const& str) -> std::string const;
 auto without_leading_slashes(std::string const& str) -> std::string const;
 auto string_to_url(std::string const& str) -> std::string const;
+auto string_to_tokens(std::string const& str) -> std::vector<std::string> const;
 
 } // namespace util
 } // namespace shashin
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <shashin/util/filesystem.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace shashin {
+namespace util {
+
+enum class XmlTokenType {
+    open, // <name attributes>
+    close, // </name>
+    empty, // <name attributes/>
+    text,
+    end,
+};
+
+// one token, name, attributes and text point into the tokenized buffer and are only valid as long as it is
+struct XmlToken {
+    XmlTokenType type{XmlTokenType::end};
+    std::string_view name;
+    std::string_view attributes;
+    std::string_view text;
+};
+
+// a streaming tokenizer that never allocates, it skips declarations, processing instructions and comments and
+// returns CDATA as text; malformed input ends the stream early instead of throwing
+class XmlTokenizer {
+public:
+    XmlTokenizer(char const* data, std::size_t size);
+
+    auto next() -> XmlToken;
+
+private:
+    std::string_view m_data;
+    std::size_t m_pos{0};
+};
+
+// takes the next name="value" pair off attributes, false once none is left
+auto next_xml_attribute(std::string_view& attributes, std::string_view& name, std::string_view& value) -> bool;
+
+// resolves the predefined entities and numeric character references
+auto xml_unescape(std::string_view text) -> std::string;
+
+// rating (-1 rejected, 0 to 5), color label, pick (1 picked, -1 rejected, 0 unflagged), caption and keywords
+// of an XMP sidecar as Lightroom, darktable, Bridge and Photo Mechanic write them
+auto xmp_info(char const* data, std::size_t size) -> std::tuple<int, std::string, int, std::string, std::vector<std::string>>;
+
+// <name>.<ext>.xmp as darktable names it, or <name>.xmp as Lightroom does, empty if neither exists
+auto xmp_sidecar_path(fs::path const& image_path) -> fs::path;
+
+} // namespace util
+} // namespace shashin
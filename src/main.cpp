@@ -2,11 +2,41 @@
 #include <iostream>
 
 int main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
+    std::string command{"run"};
+    std::string arguments;
+    auto in_memory_database{false};
+    auto has_command{false};
+    for (auto i{1}; i < argc; ++i) {
+        if (std::string{argv[i]} == "--in-memory") {
+            in_memory_database = true;
+        } else if (!has_command) {
+            command = argv[i];
+            has_command = true;
+        } else {
+            arguments += (arguments.size() > 0 ? " " : "") + std::string{argv[i]};
+        }
+    }
 
     try {
-        shashin::Shashin shashin{fs::current_path(), "couch-concert.com"};
+        shashin::Shashin shashin{fs::current_path(), "couch-concert.com", in_memory_database};
+        if (command == "run") {
+            shashin.run();
+        } else if (command == "benchmark") {
+            shashin.benchmark();
+        } else if (command == "exif") {
+            shashin.exif();
+        } else if (command == "search" && arguments.size() > 0) {
+            shashin.search(arguments);
+        } else if (command == "serve") {
+            shashin.serve();
+        } else if (command == "changed-since" && arguments.size() > 0) {
+            shashin.changed_since(std::stoll(arguments));
+        } else if (command == "duplicates") {
+            shashin.duplicates();
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--in-memory] [run|serve|exif|benchmark|search <words>|changed-since <generation>|duplicates]" << "\n";
+            return 1;
+        }
     } catch (std::exception const& e) {
         std::cerr << "Error: " << e.what() << "\n";
     }
@@ -106,4 +106,192 @@ auto Config::salt_large() const -> std::string const& {
     return m_salt_large;
 }
 
+auto Config::checkpoint_size() const -> int {
+    return m_checkpoint_size;
+}
+
+auto Config::checkpoint_interval() const -> int {
+    return m_checkpoint_interval;
+}
+
+auto Config::snapshot_interval() const -> int {
+    return m_snapshot_interval;
+}
+
+auto Config::io_backend() const -> util::IoBackend {
+    return m_io_backend;
+}
+
+auto Config::exif_header_size() const -> std::size_t {
+    return m_exif_header_size;
+}
+
+auto Config::exif_batch_size() const -> int {
+    return m_exif_batch_size;
+}
+
+auto Config::image_batch_size() const -> int {
+    return m_image_batch_size;
+}
+
+auto Config::benchmark_size() const -> int {
+    return m_benchmark_size;
+}
+
+auto Config::streaming_threshold() const -> long long {
+    return m_streaming_threshold;
+}
+
+auto Config::deepzoom_file() const -> std::string const& {
+    return m_deepzoom_file;
+}
+
+auto Config::deepzoom_tile_size() const -> int {
+    return m_deepzoom_tile_size;
+}
+
+auto Config::deepzoom_overlap() const -> int {
+    return m_deepzoom_overlap;
+}
+
+auto Config::deepzoom_batch_size() const -> int {
+    return m_deepzoom_batch_size;
+}
+
+auto Config::deepzoom_encoder_settings() const -> util::EncoderSettings const& {
+    return m_deepzoom_encoder_settings;
+}
+
+auto Config::sprites() const -> bool {
+    return m_sprites;
+}
+
+auto Config::sprite_columns() const -> int {
+    return m_sprite_columns;
+}
+
+auto Config::sprite_rows() const -> int {
+    return m_sprite_rows;
+}
+
+auto Config::search_dir() const -> std::string const& {
+    return m_search_dir;
+}
+
+auto Config::search_prefix_length() const -> int {
+    return m_search_prefix_length;
+}
+
+auto Config::map_dir() const -> std::string const& {
+    return m_map_dir;
+}
+
+auto Config::map_max_zoom() const -> int {
+    return m_map_max_zoom;
+}
+
+auto Config::map_tile_size() const -> int {
+    return m_map_tile_size;
+}
+
+auto Config::map_cluster_size() const -> int {
+    return m_map_cluster_size;
+}
+
+auto Config::passthrough_min_quality() const -> int {
+    return m_passthrough_min_quality;
+}
+
+auto Config::passthrough_max_quality() const -> int {
+    return m_passthrough_max_quality;
+}
+
+auto Config::jpeg_quality() const -> int {
+    return m_jpeg_quality;
+}
+
+auto Config::encoder_backend() const -> util::EncoderBackend {
+    return m_encoder_backend;
+}
+
+auto Config::small_encoder_settings() const -> util::EncoderSettings const& {
+    return m_small_encoder_settings;
+}
+
+auto Config::medium_encoder_settings() const -> util::EncoderSettings const& {
+    return m_medium_encoder_settings;
+}
+
+auto Config::large_encoder_settings() const -> util::EncoderSettings const& {
+    return m_large_encoder_settings;
+}
+
+auto Config::quality_search() const -> bool {
+    return m_quality_search;
+}
+
+auto Config::quality_target_ssim() const -> double {
+    return m_quality_target_ssim;
+}
+
+auto Config::quality_min() const -> int {
+    return m_quality_min;
+}
+
+auto Config::quality_max() const -> int {
+    return m_quality_max;
+}
+
+auto Config::quality_crop_size() const -> int {
+    return m_quality_crop_size;
+}
+
+auto Config::quality_crop_count() const -> int {
+    return m_quality_crop_count;
+}
+
+auto Config::pages() const -> bool {
+    return m_pages;
+}
+
+auto Config::pages_dir() const -> std::string const& {
+    return m_pages_dir;
+}
+
+auto Config::templates_dir() const -> std::string const& {
+    return m_templates_dir;
+}
+
+auto Config::serve_port() const -> int {
+    return m_serve_port;
+}
+
+auto Config::serve_chunk_size() const -> int {
+    return m_serve_chunk_size;
+}
+
+auto Config::serve_timeout() const -> int {
+    return m_serve_timeout;
+}
+
+auto Config::duplicate_distance() const -> int {
+    return m_duplicate_distance;
+}
+
+auto Config::skip_duplicates() const -> bool {
+    return m_skip_duplicates;
+}
+
+auto Config::newest_first() const -> bool {
+    return m_newest_first;
+}
+
+auto Config::priority_file() const -> std::string {
+    return m_priority_file;
+}
+
+auto Config::partial_export_interval() const -> int {
+    return m_partial_export_interval;
+}
+
 } // namespace shashin
@@ -1,28 +1,137 @@
 #include <shashin/shashin.h>
+#include <shashin/util/compress.h>
+#include <shashin/util/geo.h>
+#include <shashin/util/hamming.h>
 #include <shashin/util/hash.h>
+#include <shashin/util/http.h>
 #include <shashin/util/image.h>
+#include <shashin/util/jpeg.h>
 #include <shashin/util/parallel.h>
+#include <shashin/util/raw.h>
 #include <shashin/util/string.h>
+#include <shashin/util/template.h>
 #include <shashin/util/url.h>
+#include <shashin/util/xmp.h>
 #include <sstream>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <regex>
 #include <algorithm>
 #include <iomanip>
 #include <tuple>
+#include <map>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <opencv2/highgui/highgui.hpp>
+#include <nlohmann/json.hpp>
 
 namespace shashin {
 
 static std::mutex mtx;
 
-Shashin::Shashin(fs::path const& project_path, std::string const& watermark_text)
+// binds the EXIF columns in the order both UPDATE statements list them, i is advanced past them,
+// ids are the camera, lens and software rows from dictionary_ids
+static auto bind_exif(sqlite3_stmt* stmt, int& i, decltype(util::exif_info(nullptr, 0)) const& info, std::tuple<long long, long long, long long> const& ids) -> void {
+    auto const& [exif, captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, camera_make, camera_model, lens_make, lens_model, copyright, description, software, focal_length, focal_length_35mm, gps_latitude, gps_longitude, gps_altitude]{info};
+    auto const& [camera_id, lens_id, software_id]{ids};
+
+    util::sqlite3_bind_string(stmt, ++i, captured_at); // captured_at
+    sqlite3_bind_double(stmt, ++i, fstop); // fstop
+    sqlite3_bind_double(stmt, ++i, exposure_time); // exposure_time
+    sqlite3_bind_int(stmt, ++i, iso_speed); // iso_speed
+    sqlite3_bind_double(stmt, ++i, exposure_bias); // exposure_bias
+    sqlite3_bind_int(stmt, ++i, flash); // flash
+    sqlite3_bind_int(stmt, ++i, metering_mode); // metering_mode
+    sqlite3_bind_double(stmt, ++i, focal_length); // focal_length
+    sqlite3_bind_int(stmt, ++i, focal_length_35mm); // focal_length_35mm
+    sqlite3_bind_int64(stmt, ++i, camera_id); // camera_id
+    sqlite3_bind_int64(stmt, ++i, lens_id); // lens_id
+    sqlite3_bind_int64(stmt, ++i, software_id); // software_id
+    util::sqlite3_bind_string(stmt, ++i, description); // description
+    util::sqlite3_bind_string(stmt, ++i, copyright); // copyright
+    sqlite3_bind_double(stmt, ++i, gps_latitude); // gps_latitude
+    sqlite3_bind_double(stmt, ++i, gps_longitude); // gps_longitude
+    sqlite3_bind_double(stmt, ++i, gps_altitude); // gps_altitude
+    sqlite3_bind_int(stmt, ++i, exif ? 1 : 2); // exif, 2 once a file turned out to have none
+}
+
+// the EXIF columns of images i as the exporters read them, camera, lens and software come from the dictionaries
+static char const* const exif_select{R"sql(
+            i.exif,
+            i.captured_at,
+            i.fstop,
+            i.exposure_time,
+            i.iso_speed,
+            i.exposure_bias,
+            i.flash,
+            i.metering_mode,
+            i.focal_length,
+            i.focal_length_35mm,
+            coalesce(c.make, ''),
+            coalesce(c.model, ''),
+            coalesce(l.make, ''),
+            coalesce(l.model, ''),
+            coalesce(s.name, ''),
+            i.description,
+            i.copyright,
+            i.gps_latitude,
+            i.gps_longitude)sql"};
+
+static char const* const exif_joins{R"sql(
+        LEFT JOIN cameras c ON c.id = i.camera_id
+        LEFT JOIN lenses l ON l.id = i.lens_id
+        LEFT JOIN software s ON s.id = i.software_id)sql"};
+
+// every export leaves out the images whose tiers are not all there, e.g. failed ones or those process_images has not reached yet,
+// so the exported files agree on which images exist; while process_images runs, the images it rendered for nodes that are not
+// complete yet are held back as well, so a partial export shows such a node as it was before
+static char const* const published_images{R"sql(i.small_width > 0 AND i.medium_width > 0 AND i.large_width > 0 AND i.path NOT IN (SELECT path FROM unfinished_images))sql"};
+
+// reads the columns of exif_select and formats them for the exported files, i is advanced past them;
+// images without EXIF export empty strings
+static auto column_exif_strings(sqlite3_stmt* stmt, int& i) -> std::tuple<std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string> {
+    auto const text{[stmt](int column) -> std::string {
+        return std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, column))};
+    }};
+
+    auto const exif{sqlite3_column_int(stmt, ++i) == 1};
+    auto captured_at{text(++i)};
+    auto fstop{util::format_fstop(sqlite3_column_double(stmt, ++i))};
+    auto exposure_time{util::format_exposure_time(sqlite3_column_double(stmt, ++i))};
+    auto iso_speed{util::format_iso_speed(sqlite3_column_int(stmt, ++i))};
+    auto exposure_bias{util::format_exposure_bias(sqlite3_column_double(stmt, ++i))};
+    auto flash{util::format_flash(sqlite3_column_int(stmt, ++i))};
+    auto metering_mode{util::format_metering_mode(sqlite3_column_int(stmt, ++i))};
+    auto focal_length{util::format_focal_length(sqlite3_column_double(stmt, ++i))};
+    auto focal_length_35mm{util::format_focal_length(sqlite3_column_int(stmt, ++i))};
+    auto camera_make{text(++i)};
+    auto camera_model{text(++i)};
+    auto lens_make{text(++i)};
+    auto lens_model{text(++i)};
+    auto software{text(++i)};
+    auto description{text(++i)};
+    auto copyright{text(++i)};
+    auto const gps_latitude{sqlite3_column_double(stmt, ++i)};
+    auto const gps_longitude{sqlite3_column_double(stmt, ++i)};
+    auto gps{util::format_gps(gps_latitude, gps_longitude)};
+
+    if (!exif) {
+        return {};
+    }
+    return {captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, focal_length, focal_length_35mm, camera_make, camera_model, lens_make, lens_model, software, description, copyright, gps};
+}
+
+Shashin::Shashin(fs::path const& project_path, std::string const& watermark_text, bool in_memory_database)
     : m_config{project_path, watermark_text} {
     create_directories();
-    open_database();
+    remove_stray_files();
+    open_database(in_memory_database);
     exec_query(R"sql(
         CREATE TABLE IF NOT EXISTS nodes (
             id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
@@ -87,10 +196,42 @@ Shashin::Shashin(fs::path const& project_path, std::string const& watermark_text
             updated_at datetime NOT NULL
         );
         CREATE UNIQUE INDEX IF NOT EXISTS images_path_idx ON images(path);
+
+        CREATE TABLE IF NOT EXISTS failures (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            path text NOT NULL,
+            stage varchar NOT NULL,
+            error text NOT NULL DEFAULT '',
+            size integer NOT NULL DEFAULT 0,
+            mtime integer NOT NULL DEFAULT 0,
+            created_at datetime NOT NULL
+        );
+        CREATE UNIQUE INDEX IF NOT EXISTS failures_path_idx ON failures(path);
+    )sql");
+    migrate_database();
+    exec_query(R"sql(
+        CREATE TEMP TABLE IF NOT EXISTS unfinished_images (
+            path text PRIMARY KEY NOT NULL
+        );
     )sql");
 
-    // --------------------------------------------------------------
+    // the manifest takes part, so a run that only rewrote exported files still gets a generation of its own
+    exec_query(R"sql(
+        SELECT max(coalesce((SELECT max(generation) FROM nodes), 0), coalesce((SELECT max(generation) FROM images), 0), coalesce((SELECT max(generation) FROM manifest), 0)) + 1;
+    )sql", [](void* dst, int argc, char** argv, char** column_names) -> int {
+        (void)column_names;
+        if (argc > 0 && argv[0] != nullptr) {
+            *static_cast<long long*>(dst) = std::stoll(argv[0]);
+        }
+        return 0;
+    }, &m_generation);
+}
+
+Shashin::~Shashin() {
+    close_database();
+}
 
+auto Shashin::run() const -> void {
     auto timestamp_end{util::make_timestamp()};
     auto timestamp_start{util::make_timestamp()};
 
@@ -102,628 +243,4222 @@ Shashin::Shashin(fs::path const& project_path, std::string const& watermark_text
 
     sync_nodes();
     sync_images();
-    update_exif();
     process_images();
+    save_database();
+    update_exif();
+    process_deepzoom();
+    save_database();
+    if (util::interrupted()) {
+        print_failures();
+        std::cout << "---------------------------------" << "\n"
+                  << "interrupted, processed images are committed and the next run resumes from there" << "\n";
+        return;
+    }
+    create_sprites();
     create_gallery_files();
+    create_search_index();
+    create_map_tiles();
+    create_pages();
+    remove_stale_sprites();
     dump_list_html();
+    compress_outputs();
+    sweep_manifest();
+    print_failures();
 
     timestamp_end = util::make_timestamp();
     std::cout << "---------------------------------" << "\n"
               << std::setfill(' ') << std::setw(8) << util::time_between<std::chrono::seconds>(timestamp_start, timestamp_end) << " " << "sec" << "  " << "total or" << "\n"
               << std::setfill(' ') << std::setw(8) << util::time_between<std::chrono::minutes>(timestamp_start, timestamp_end) << " " << "min" << "  " << "total" << "\n";
-
 }
 
-Shashin::~Shashin() {
-    close_database();
-}
-
-auto Shashin::open_database() -> void {
-    auto rc{0};
-    rc = sqlite3_open_v2(m_config.database_path().string().c_str(), &m_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Error: " << sqlite3_errmsg(m_db)
-            #ifdef SHASHIN_DEBUG
-                  << " [" << __FILE__ << ":" << __LINE__ << "]"
-            #endif
-                  << "\n";
-        throw fs::filesystem_error("Failed to open database: " + m_config.database_path().string(), std::error_code());
+// matches the words of the query as prefixes against the search table written by the last run
+auto Shashin::search(std::string const& query) const -> void {
+    std::string match;
+    for (auto const& token: util::string_to_tokens(query)) {
+        match += (match.size() > 0 ? " AND " : "") + std::string{"\""} + token + "\"*";
     }
-}
-
-auto Shashin::close_database() -> void {
-    auto rc{0};
-    rc = sqlite3_close(m_db);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+    if (match.size() == 0) {
+        std::cerr << "Error: " << "empty search query"
             #ifdef SHASHIN_DEBUG
                   << " [" << __FILE__ << ":" << __LINE__ << "]"
             #endif
                   << "\n";
+        return;
     }
-}
 
-auto Shashin::exec_query(std::string const& query, int (*callback)(void*, int argc, char**, char**), void* dst) const -> void {
-    auto rc{0};
-    char* sqlite_error_message{nullptr};
-    rc = sqlite3_exec(m_db, query.c_str(), callback, dst, &sqlite_error_message);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Error: " << sqlite3_errmsg(m_db)
-            #ifdef SHASHIN_DEBUG
-                  << " [" << __FILE__ << ":" << __LINE__ << "]"
-            #endif
-                  << "\n";
-    }
-    sqlite3_free(sqlite_error_message);
+    auto count{0};
+    exec_transaction(R"sql(
+        SELECT s.hash, s.path, n.url, n.title
+        FROM search s INNER JOIN nodes n ON n.hash = s.hash
+        WHERE search MATCH ?
+        ORDER BY rank;
+    )sql", [this, &match, &count](sqlite3_stmt* stmt) -> void {
+        util::sqlite3_bind_string(stmt, 1, match); // query
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            std::cout << hash << "  " << url << "  " << (title.size() > 0 ? title : path) << "\n";
+            ++count;
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+    std::cout << std::setfill(' ') << std::setw(8) << count << " " << "node" << "  " << "found" << "\n" << std::flush;
 }
 
-auto Shashin::exec_transaction(char const* const query, std::function<void(sqlite3_stmt* stmt)> func) const -> void {
-    auto rc{0};
-    sqlite3_stmt* stmt{nullptr};
-    sqlite3_mutex_enter(sqlite3_db_mutex(m_db));
-    exec_query("PRAGMA synchronous=OFF");
-    exec_query("PRAGMA count_changes=OFF");
-    exec_query("PRAGMA journal_mode=MEMORY");
-    exec_query("PRAGMA temp_store=MEMORY");
-    exec_query("BEGIN TRANSACTION");
-    rc = sqlite3_prepare_v2(m_db, query, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Error: " << sqlite3_errmsg(m_db)
-            #ifdef SHASHIN_DEBUG
-                  << " [" << __FILE__ << ":" << __LINE__ << "]"
-            #endif
-                  << "\n";
-    } else {
-        func(stmt);
-    }
-    exec_query("COMMIT TRANSACTION");
-    sqlite3_finalize(stmt);
-    sqlite3_mutex_leave(sqlite3_db_mutex(m_db));
+// the deployable files written or removed in a later run than generation, one per line as generation, state, size, hash and
+// path below the project; the state is immutable, mutable or deleted, immutable files keep their content for good and can be cached forever
+auto Shashin::changed_since(long long generation) const -> void {
+    auto count{0};
+    exec_transaction(R"sql(
+        SELECT generation, immutable, deleted, size, hash, path
+        FROM manifest
+        WHERE generation > ?
+        ORDER BY generation, path;
+    )sql", [this, generation, &count](sqlite3_stmt* stmt) -> void {
+        sqlite3_bind_int64(stmt, 1, generation); // generation
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto const row_generation{sqlite3_column_int64(stmt, ++i)};
+            auto const immutable{sqlite3_column_int(stmt, ++i)};
+            auto const deleted{sqlite3_column_int(stmt, ++i)};
+            auto const size{sqlite3_column_int64(stmt, ++i)};
+            auto const hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+            std::cout << row_generation << "\t" << (deleted ? "deleted" : immutable ? "immutable" : "mutable") << "\t" << size << "\t" << hash << "\t" << path << "\n";
+            ++count;
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+    std::cerr << count << " " << "file(s) changed since generation " << generation << ", current generation " << (m_generation - 1) << "\n";
 }
 
-auto Shashin::create_directories() const -> void {
-    std::vector<fs::path> const paths {
-        m_config.shashin_path(),
-        m_config.gallery_path(),
-        m_config.site_path(),
-        m_config.cache_path(),
-        m_config.data_path()
-    };
-    for (auto const& path : paths) {
-        if (!fs::exists(path)) {
-            fs::create_directories(path);
+// clusters of near duplicates by the perceptual hashes of earlier runs, one line per image as cluster, distance to the first
+// image of its cluster and path
+auto Shashin::duplicates() const -> void {
+    auto const timestamp_start{util::make_timestamp()};
+
+    std::vector<std::string> paths;
+    std::vector<std::uint64_t> hashes;
+    exec_transaction(R"sql(
+        SELECT path, phash FROM images WHERE phash IS NOT NULL ORDER BY path;
+    )sql", [this, &paths, &hashes](sqlite3_stmt* stmt) -> void {
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            paths.push_back(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))});
+            hashes.push_back(std::uint64_t(sqlite3_column_int64(stmt, 1)));
         }
-    }
-    for (auto const& path : paths) {
-        if (!fs::exists(path)) {
-            throw fs::filesystem_error("Failed to create directory: " + path.string(), std::error_code());
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    auto const clusters{util::hamming_clusters(hashes, m_config.duplicate_distance())};
+    auto count{0};
+    for (size_t c{0}; c < clusters.size(); ++c) {
+        for (auto const id: clusters[c]) {
+            std::cout << (c + 1) << "\t" << util::hamming_distance(hashes[clusters[c][0]], hashes[id]) << "\t" << paths[id] << "\n";
+            ++count;
         }
     }
+    std::cerr << count << " " << "of " << hashes.size() << " image(s) in " << clusters.size() << " cluster(s) within distance " << m_config.duplicate_distance()
+              << ", " << util::time_between(timestamp_start, util::make_timestamp()) << " ms" << "\n";
 }
 
-auto Shashin::is_gallery(std::string const& name) const -> bool {
-    return std::count(name.begin(), name.end(), *(m_config.gallery_delim().c_str())) > 0;
-}
+// previews the site on 127.0.0.1 before every tier exists: a missing tier is rendered on its first request, the other images
+// of its node come next and the rest is filled in the background, all through process_images into the cache and database
+auto Shashin::serve() const -> void {
+    sync_nodes();
+    sync_images();
+    util::install_interrupt_handler();
 
-auto Shashin::gallery_parts(std::string const&name) const -> std::tuple<std::string, std::string, std::string, std::string, std::string, std::string> {
-    std::string captured_at;
-    std::string title;
-    std::string event;
-    std::string location;
-    std::string city;
-    std::string country;
+    // tier path below the cache to image, the images of each node and the images still missing a tier, in gallery order
+    std::unordered_map<std::string, std::string> tiers;
+    std::unordered_map<std::string, std::vector<std::string>> nodes;
+    std::unordered_map<std::string, std::string> parents;
+    std::vector<std::string> pending;
+    exec_transaction(R"sql(
+        SELECT i.path, i.parent, n.hash, i.small, i.medium, i.large, i.small_width, i.medium_width, i.large_width
+        FROM images i INNER JOIN nodes n ON i.parent = n.path
+        ORDER BY i.parent, i.captured_at;
+    )sql", [this, &tiers, &nodes, &parents, &pending](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto const path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const parent{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto const small_width{sqlite3_column_int(stmt, ++i)};
+            auto const medium_width{sqlite3_column_int(stmt, ++i)};
+            auto const large_width{sqlite3_column_int(stmt, ++i)};
 
-    if (is_gallery(name)) {
-        captured_at = [&name]() -> std::string const {
-            std::smatch match;
-            if (std::regex_match(name, match, std::regex("^[0-9]{6}.*"))) {
-                return "20" + name.substr(0, 2) + "-" + name.substr(2, 2) + "-" + name.substr(4, 2) + " 00:00:00";
+            auto missing{small_width == 0 || medium_width == 0 || large_width == 0};
+            for (auto const& [tier, name]: {std::make_tuple("small", small), std::make_tuple("medium", medium), std::make_tuple("large", large)}) {
+                auto const key{std::string{tier} + "/" + hash + "/" + name + ".jpg"};
+                tiers[key] = path;
+                missing = missing || !fs::exists(fs::path{m_config.cache_path()}.append(key));
             }
-            return std::string("");
-        }();
-
-        std::vector<std::string> tokens{util::str_split(name, m_config.gallery_delim())};
-        auto const finalize_meta_data{[](std::string& input) -> void {
-            util::stackoverflow::trim(input);
-            if (input == "nil" || input == "null") {
-                input = "";
+            nodes[parent].push_back(path);
+            parents[path] = parent;
+            if (missing) {
+                pending.push_back(path);
             }
-        }};
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
 
-        title = [&]() -> std::string const {
-            std::string str;
-            if (tokens.size() > 0) {
-                str = tokens[0];
-            }
-            if (captured_at.size() > 0 && str.size() > 6) {
-                str = str.substr(6);
-            }
-            finalize_meta_data(str);
-            return str;
-        }();
+    // requested images go first, then the other images of their nodes, then the pending ones;
+    // rendered holds every image process_images has seen in this session, whether it succeeded or not
+    std::mutex state_mutex;
+    std::condition_variable state_cv;
+    std::deque<std::string> requested;
+    std::deque<std::string> boosted;
+    std::unordered_set<std::string> boosted_nodes;
+    std::unordered_set<std::string> rendered;
+    std::atomic<bool> stopped{false};
+    auto const stop{[&stopped]() -> bool {
+        return stopped.load() || util::interrupted();
+    }};
 
-        event = [&]() -> std::string const {
-            std::string str;
-            if (tokens.size() > 1) {
-                str = tokens[1];
-            }
-            finalize_meta_data(str);
-            return str;
-        }();
+    auto const cache_prefix{"/" + m_config.cache_dir() + "/"};
+    auto const handler{[this, &tiers, &nodes, &parents, &state_mutex, &state_cv, &requested, &boosted, &boosted_nodes, &rendered, &stop, &cache_prefix](std::string const& target) -> util::HttpResponse {
+        // the decoded target may hold further slashes or dot segments, appending an absolute path would replace the site;
+        // what is left has to stay below the site even after symbolic links are resolved
+        auto const path{target == "/" ? std::string{"/index.html"} : target};
+        auto const relative{fs::path{path.substr(1)}.lexically_normal()};
+        if (relative.empty() || relative.has_root_path() || relative.begin()->empty() || *relative.begin() == "..") {
+            return {403, "text/plain", {}};
+        }
+        std::error_code ec;
+        auto const site_path{fs::weakly_canonical(m_config.site_path(), ec)};
+        auto const file_path{fs::weakly_canonical(fs::path{site_path}.append(relative.string()), ec)};
+        if (ec || std::mismatch(site_path.begin(), site_path.end(), file_path.begin(), file_path.end()).first != site_path.end()) {
+            return {403, "text/plain", {}};
+        }
 
-        location = [&]() -> std::string const {
-            std::string str;
-            if (tokens.size() > 2) {
-                str = tokens[2];
+        if (!fs::exists(file_path) && path.compare(0, cache_prefix.size(), cache_prefix) == 0) {
+            auto const it{tiers.find(path.substr(cache_prefix.size()))};
+            if (it != tiers.end()) {
+                auto const& image{it->second};
+                std::unique_lock<std::mutex> lock{state_mutex};
+                if (rendered.count(image) == 0) {
+                    requested.push_back(image);
+                    if (boosted_nodes.insert(parents.at(image)).second) {
+                        auto const& siblings{nodes.at(parents.at(image))};
+                        boosted.insert(boosted.end(), siblings.begin(), siblings.end());
+                    }
+                    state_cv.notify_all();
+                }
+                auto const ready{state_cv.wait_for(lock, std::chrono::seconds(m_config.serve_timeout()), [&rendered, &image, &stop]() -> bool {
+                    return rendered.count(image) > 0 || stop();
+                })};
+                if (!ready) {
+                    return {504, "text/plain", {}};
+                }
             }
-            finalize_meta_data(str);
-            return str;
-        }();
+        }
 
-        city = [&]() -> std::string const {
-            std::string str;
-            if (tokens.size() > 3) {
-                str = tokens[3];
-            }
-            str = std::regex_replace(str, std::regex(",.*"), "");
-            finalize_meta_data(str);
-            return str;
-        }();
+        if (!fs::is_regular_file(file_path)) {
+            return {404, "text/plain", {}};
+        }
+        auto contents{util::read_files({file_path}, util::IoBackend::blocking)};
+        auto& [data, error]{contents[0]};
+        if (error.size() > 0) {
+            return {500, "text/plain", {error.begin(), error.end()}};
+        }
+        return {200, util::mime_type(path), std::move(data)};
+    }};
 
-        country = [&]() -> std::string const {
-            std::string str;
-            if (tokens.size() > 3) {
-                str = tokens[3];
-            }
-            str = std::regex_replace(str, std::regex(".*?,"), "");
-            finalize_meta_data(str);
-            return str;
-        }();
-    }
+    std::thread server([this, &handler, &stop, &stopped, &state_cv]() {
+        try {
+            util::serve_http(m_config.serve_port(), handler, stop);
+        } catch (std::exception const& e) {
+            std::cerr << "Error: " << e.what()
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+        stopped = true;
+        state_cv.notify_all();
+    });
 
-    return {captured_at, title, event, location, city, country};
-}
+    std::cout << "serving " << m_config.site_path().string() << " on http://127.0.0.1:" << m_config.serve_port() << "/" << "\n"
+              << std::setfill(' ') << std::setw(8) << pending.size() << " " << "img" << "  " << "pending" << "\n" << std::flush;
 
-auto Shashin::sync_nodes() const -> void {
-    long long duration_ms{0};
-    auto timestamp_end{util::make_timestamp()};
-    auto timestamp_start{util::make_timestamp()};
+    size_t next{0};
+    auto announced{pending.empty()};
+    while (!stop()) {
+        std::vector<std::string> chunk;
+        {
+            std::unique_lock<std::mutex> lock{state_mutex};
+            state_cv.wait_for(lock, std::chrono::milliseconds(250), [&requested, &boosted, &next, &pending, &stop]() -> bool {
+                return requested.size() > 0 || boosted.size() > 0 || next < pending.size() || stop();
+            });
+            auto const take{[this, &rendered, &chunk](std::deque<std::string>& queue, size_t limit) -> void {
+                while (queue.size() > 0 && chunk.size() < limit) {
+                    if (rendered.count(queue.front()) == 0 && std::find(chunk.begin(), chunk.end(), queue.front()) == chunk.end()) {
+                        chunk.push_back(queue.front());
+                    }
+                    queue.pop_front();
+                }
+            }};
+            // a request waits for no more than the requests before it
+            take(requested, requested.size());
+            if (chunk.empty()) {
+                take(boosted, size_t(m_config.serve_chunk_size()));
+            }
+            while (chunk.empty() && next < pending.size()) {
+                for (; next < pending.size() && chunk.size() < size_t(m_config.serve_chunk_size()); ++next) {
+                    if (rendered.count(pending[next]) == 0) {
+                        chunk.push_back(pending[next]);
+                    }
+                }
+            }
+        }
+        if (chunk.empty()) {
+            if (!announced) {
+                std::cout << "all tiers rendered" << "\n" << std::flush;
+                announced = true;
+            }
+            continue;
+        }
 
-    auto const nodes{list_directory_recursive(m_config.gallery_path(), [](fs::path const& path) -> bool {
-        return fs::is_directory(path);
-    })};
+        process_images(chunk);
+        {
+            std::lock_guard<std::mutex> lock{state_mutex};
+            rendered.insert(chunk.begin(), chunk.end());
+        }
+        state_cv.notify_all();
+    }
 
-    exec_transaction(R"sql(
-        INSERT INTO nodes (created_at, updated_at, depth, path, name, url, hash, captured_at, title, event, location, city, country)
-        VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?)
-        ON CONFLICT(path) DO UPDATE SET updated_at=?;
-    )sql", [this, &nodes](sqlite3_stmt* stmt) -> void {
-        int i{0};
-        for (auto const& abs_path: nodes) {
-            auto const rel_path{fs::relative(abs_path, m_config.gallery_path())};
-            auto const path{rel_path.string()};
-            auto const name{rel_path.filename().string()};
-            auto const url{util::string_to_url(path)};
-            auto const hash{util::hash_to_hex_string(util::string_to_hash(path))};
-            auto const depth{static_cast<int>(std::count(path.begin(), path.end(), '/'))};
-            auto [captured_at, title, event, location, city, country]{gallery_parts(name)};
+    stopped = true;
+    state_cv.notify_all();
+    server.join();
+    save_database();
+}
 
-            i = 0;
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
-            sqlite3_bind_int(stmt, ++i, depth); // depth
-            util::sqlite3_bind_string(stmt, ++i, path); // path
-            util::sqlite3_bind_string(stmt, ++i, name); // name
-            util::sqlite3_bind_string(stmt, ++i, url); // url
-            util::sqlite3_bind_string(stmt, ++i, hash); // hash
-            util::sqlite3_bind_string(stmt, ++i, captured_at); // captured_at
-            util::sqlite3_bind_string(stmt, ++i, title); // title
-            util::sqlite3_bind_string(stmt, ++i, event); // event
-            util::sqlite3_bind_string(stmt, ++i, location); // location
-            util::sqlite3_bind_string(stmt, ++i, city); // city
-            util::sqlite3_bind_string(stmt, ++i, country); // country
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+// re-reads the EXIF headers of all images without touching any tier
+auto Shashin::exif() const -> void {
+    util::install_interrupt_handler();
+    sync_nodes();
+    sync_images();
+    update_exif(true);
+    print_failures();
+}
 
-            sqlite3_step(stmt);
-            sqlite3_reset(stmt);
+auto Shashin::benchmark() const -> void {
+    std::vector<fs::path> paths;
+    exec_transaction(R"sql(
+        SELECT path FROM images ORDER BY id LIMIT ?;
+    )sql", [this, &paths](sqlite3_stmt* stmt) -> void {
+        sqlite3_bind_int(stmt, 1, m_config.benchmark_size());
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            paths.push_back(fs::path{m_config.gallery_path()}.append(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}));
         }
     });
 
-    exec_query("DELETE FROM nodes WHERE updated_at < '" + m_config.current_time() + "'");
+    std::vector<util::IoBackend> backends{util::IoBackend::blocking};
+    if (util::io_backend_default() == util::IoBackend::uring) {
+        backends.push_back(util::IoBackend::uring);
+    }
 
-    timestamp_end = util::make_timestamp();
-    duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "sync nodes" << "\n" << std::flush;
-}
+    // the same number of workers as process_images, only the backend differs
+    auto const time_parallel{[&paths](int batch_size, std::function<void(std::vector<fs::path> const& batch)> func) -> long long {
+        auto const timestamp_start{util::make_timestamp()};
+        util::process_parallel_dynamic([&paths, &func](int worker_number, int lower_bound, int upper_bound) {
+            (void)worker_number;
+            func(std::vector<fs::path>(paths.begin() + lower_bound, paths.begin() + upper_bound));
+        }, int(paths.size()), batch_size);
+        return util::time_between(timestamp_start, util::make_timestamp());
+    }};
 
-auto Shashin::sync_images() const -> void {
-    long long duration_ms{0};
-    auto timestamp_end{util::make_timestamp()};
-    auto timestamp_start{util::make_timestamp()};
+    std::cout << std::setfill(' ') << std::setw(8) << paths.size() << " " << "img" << "  " << "benchmark" << "\n" << std::flush;
 
-    auto const images{list_directory_recursive(m_config.gallery_path(), [](fs::path const& path) -> bool {
-        return !fs::is_directory(path) && fs::is_regular_file(path)
-            && (path.extension() == ".jpg" || path.extension() == ".jpeg" || path.extension() == ".jpe");
-    })};
+    auto const scratch_path{fs::path{m_config.shashin_path()}.append("benchmark")};
+    std::vector<unsigned char> const tier(256 * 1024, 0x80);
+    for (auto const backend: backends) {
+        auto const name{util::io_backend_name(backend)};
 
-    exec_transaction(R"sql(
-        INSERT INTO images (created_at, updated_at, depth, path, name, parent, small, medium, large)
-        VALUES (?,?,?,?,?,?,?,?,?)
-        ON CONFLICT(path) DO UPDATE SET updated_at=?;
-    )sql", [this, &images](sqlite3_stmt* stmt) -> void {
-        int i{0};
-        for (auto const& abs_path: images) {
-            auto const rel_path{fs::relative(abs_path, m_config.gallery_path())};
-            auto const path{rel_path.string()};
-            auto const name{rel_path.filename().string()};
-            auto const depth{static_cast<int>(std::count(path.begin(), path.end(), '/'))};
-            auto const parent{rel_path.parent_path().string()};
-            auto const small{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_small()))};
-            auto const medium{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_medium()))};
-            auto const large{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_large()))};
+        util::evict_files(paths);
+        auto duration_ms{time_parallel(m_config.image_batch_size(), [backend](std::vector<fs::path> const& batch) -> void {
+            util::read_files(batch, backend);
+        })};
+        std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "read sources (" << name << ")" << "\n" << std::flush;
 
-            i = 0;
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
-            sqlite3_bind_int(stmt, ++i, depth); // depth
-            util::sqlite3_bind_string(stmt, ++i, path); // path
-            util::sqlite3_bind_string(stmt, ++i, name); // name
-            util::sqlite3_bind_string(stmt, ++i, parent); // parent
-            util::sqlite3_bind_string(stmt, ++i, small); // small
-            util::sqlite3_bind_string(stmt, ++i, medium); // medium
-            util::sqlite3_bind_string(stmt, ++i, large); // large
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+        util::evict_files(paths);
+        duration_ms = time_parallel(m_config.exif_batch_size(), [this, backend](std::vector<fs::path> const& batch) -> void {
+            util::read_files(batch, backend, m_config.exif_header_size());
+        });
+        std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "read exif headers (" << name << ")" << "\n" << std::flush;
 
-            sqlite3_step(stmt);
-            sqlite3_reset(stmt);
+        duration_ms = time_parallel(m_config.image_batch_size(), [&scratch_path, &tier, backend](std::vector<fs::path> const& batch) -> void {
+            std::vector<std::tuple<fs::path, std::vector<unsigned char>>> files;
+            for (auto const& path: batch) {
+                files.push_back({fs::path{scratch_path}.append(util::hash_to_hex_string(util::string_to_hash(path.string())) + ".jpg"), tier});
+            }
+            util::write_files_atomic(files, backend);
+        });
+        std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "write tiers (" << name << ")" << "\n" << std::flush;
+
+        fs::remove_all(scratch_path);
+    }
+
+    // the queries the stages run against the database on a scratch copy, once as a file and once in memory including load and write back;
+    // the stages themselves also read and write files, so these time the database only and are labeled after their queries
+    std::vector<std::string> image_paths;
+    exec_transaction(R"sql(
+        SELECT path FROM images;
+    )sql", [&image_paths](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            image_paths.push_back(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))});
         }
     });
 
-    exec_query("DELETE FROM images WHERE updated_at < '" + m_config.current_time() + "'");
+    auto const failed{[](sqlite3* db, int rc) -> bool {
+        if (rc == SQLITE_OK || rc == SQLITE_DONE) {
+            return false;
+        }
+        std::cerr << "Error: " << (db != nullptr ? sqlite3_errmsg(db) : sqlite3_errstr(rc))
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+        return true;
+    }};
+    auto const read_all{[](sqlite3* db, char const* const query) -> int {
+        sqlite3_stmt* stmt{nullptr};
+        auto rc{sqlite3_prepare_v2(db, query, -1, &stmt, nullptr)};
+        while (rc == SQLITE_OK && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {}
+        sqlite3_finalize(stmt);
+        return rc;
+    }};
 
-    timestamp_end = util::make_timestamp();
-    duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "sync images" << "\n" << std::flush;
-}
+    auto const database_path{fs::path{scratch_path}.append(m_config.database_path().filename().string())};
+    for (auto const in_memory: {false, true}) {
+        auto const name{in_memory ? "memory" : "disk"};
+        std::error_code ec;
+        fs::create_directories(scratch_path, ec);
 
-auto Shashin::update_exif() const -> void {
-    long long duration_ms{0};
-    auto timestamp_end{util::make_timestamp()};
-    auto timestamp_start{util::make_timestamp()};
+        sqlite3* db{nullptr};
+        auto const discard{[&db, &scratch_path]() -> void {
+            sqlite3_close(db);
+            std::error_code ec;
+            fs::remove_all(scratch_path, ec);
+        }};
+        auto rc{sqlite3_open_v2(database_path.string().c_str(), &db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr)};
+        if (rc == SQLITE_OK) {
+            sqlite3_mutex_enter(sqlite3_db_mutex(m_db));
+            rc = util::sqlite3_copy(m_db, db);
+            sqlite3_mutex_leave(sqlite3_db_mutex(m_db));
+        }
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db, "PRAGMA synchronous=NORMAL; PRAGMA journal_mode=TRUNCATE; PRAGMA temp_store=MEMORY;", nullptr, nullptr, nullptr);
+        }
+        if (failed(db, rc)) {
+            discard();
+            return;
+        }
 
-    std::vector<std::string> images;
-    std::unordered_map<std::string, std::tuple<bool, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, double, double>> images_with_exif;
+        auto timestamp_start{util::make_timestamp()};
+        if (in_memory) {
+            sqlite3* memory_db{nullptr};
+            rc = sqlite3_open_v2(":memory:", &memory_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
+            if (rc == SQLITE_OK) {
+                rc = util::sqlite3_copy(db, memory_db);
+            }
+            sqlite3_close(db);
+            db = memory_db;
+            if (failed(db, rc)) {
+                discard();
+                return;
+            }
+            std::cout << std::setfill(' ') << std::setw(8) << util::time_between(timestamp_start, util::make_timestamp()) << " " << "ms" << "  " << "load database (" << name << ")" << "\n" << std::flush;
+        }
 
-    exec_transaction(R"sql(
-        SELECT path FROM images WHERE exif is NULL or exif != 1;
-    )sql", [this, &images](sqlite3_stmt* stmt) -> void {
-        auto rc{0};
-        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-            images.push_back(std::string(reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))));
+        timestamp_start = util::make_timestamp();
+        if (failed(db, read_all(db, "SELECT path, size, mtime FROM images;"))) {
+            discard();
+            return;
         }
-        if (rc != SQLITE_DONE) {
-            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+        std::cout << std::setfill(' ') << std::setw(8) << util::time_between(timestamp_start, util::make_timestamp()) << " " << "ms" << "  " << "select image stats, sync images query (" << name << ")" << "\n" << std::flush;
+
+        // the same commit pattern as the writer of process_images, one row update per image and checkpoint_size rows per transaction
+        timestamp_start = util::make_timestamp();
+        sqlite3_stmt* stmt{nullptr};
+        rc = sqlite3_prepare_v2(db, "UPDATE images SET updated_at = updated_at WHERE path = ?;", -1, &stmt, nullptr);
+        for (size_t first{0}; rc == SQLITE_OK && first < image_paths.size(); first += size_t(m_config.checkpoint_size())) {
+            rc = sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+            for (auto i{first}; rc == SQLITE_OK && i < std::min(image_paths.size(), first + size_t(m_config.checkpoint_size())); ++i) {
+                util::sqlite3_bind_string(stmt, 1, image_paths[i]); // path
+                rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : sqlite3_errcode(db);
+                sqlite3_reset(stmt);
+            }
+            if (rc == SQLITE_OK) {
+                rc = sqlite3_exec(db, "COMMIT TRANSACTION", nullptr, nullptr, nullptr);
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (failed(db, rc)) {
+            discard();
+            return;
+        }
+        std::cout << std::setfill(' ') << std::setw(8) << util::time_between(timestamp_start, util::make_timestamp()) << " " << "ms" << "  " << "update image rows, commit images pattern (" << name << ")" << "\n" << std::flush;
+
+        timestamp_start = util::make_timestamp();
+        if (failed(db, read_all(db, "SELECT * FROM images i INNER JOIN nodes n ON i.parent = n.path ORDER BY i.parent, i.captured_at;"))) {
+            discard();
+            return;
+        }
+        std::cout << std::setfill(' ') << std::setw(8) << util::time_between(timestamp_start, util::make_timestamp()) << " " << "ms" << "  " << "select export rows, export images query (" << name << ")" << "\n" << std::flush;
+
+        if (in_memory) {
+            timestamp_start = util::make_timestamp();
+            auto const tmp_path{fs::path{database_path}.concat(".tmp")};
+            sqlite3* disk_db{nullptr};
+            rc = sqlite3_open_v2(tmp_path.string().c_str(), &disk_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
+            if (rc == SQLITE_OK) {
+                rc = util::sqlite3_copy(db, disk_db);
+            }
+            sqlite3_close(disk_db);
+            if (failed(nullptr, rc)) {
+                discard();
+                return;
+            }
+            fs::rename(tmp_path, database_path, ec);
+            std::cout << std::setfill(' ') << std::setw(8) << util::time_between(timestamp_start, util::make_timestamp()) << " " << "ms" << "  " << "save database (" << name << ")" << "\n" << std::flush;
+        }
+
+        sqlite3_close(db);
+        fs::remove_all(scratch_path);
+    }
+}
+
+auto Shashin::open_database(bool in_memory) -> void {
+    auto rc{0};
+    rc = sqlite3_open_v2(m_config.database_path().string().c_str(), &m_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+        throw fs::filesystem_error("Failed to open database: " + m_config.database_path().string(), std::error_code());
+    }
+
+    // in memory the file is only read here and replaced by save_database, so commits cost no fsync on slow storage
+    if (in_memory) {
+        sqlite3* memory_db{nullptr};
+        rc = sqlite3_open_v2(":memory:", &memory_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
+        if (rc == SQLITE_OK) {
+            rc = util::sqlite3_copy(m_db, memory_db);
+        }
+        if (rc != SQLITE_OK) {
+            std::cerr << "Error: " << sqlite3_errstr(rc)
                 #ifdef SHASHIN_DEBUG
                       << " [" << __FILE__ << ":" << __LINE__ << "]"
                 #endif
                       << "\n";
+            sqlite3_close(memory_db);
+            throw fs::filesystem_error("Failed to load database into memory: " + m_config.database_path().string(), std::error_code());
         }
-    });
+        sqlite3_close(m_db);
+        m_db = memory_db;
+        m_in_memory = true;
+    }
 
-    util::process_parallel([this, &images, &images_with_exif](int worker_number, int lower_bound, int upper_bound) {
-        long long duration_ms{0};
-        auto timestamp_end{util::make_timestamp()};
-        auto timestamp_start{util::make_timestamp()};
+    // a rollback journal on disk keeps the database intact if the process dies in the middle of a commit
+    exec_query("PRAGMA synchronous=NORMAL");
+    exec_query("PRAGMA count_changes=OFF");
+    exec_query("PRAGMA journal_mode=TRUNCATE");
+    exec_query("PRAGMA temp_store=MEMORY");
+}
 
-        for (auto i{lower_bound}; i < upper_bound; ++i) {
-            //std::cout << images[size_t(i)] << "\n";
-            images_with_exif[images[size_t(i)]] = util::exif_info(fs::path(m_config.gallery_path()).append(images[size_t(i)]));
-        }
+// the tables above are the initial schema, later changes are appended here and never edited,
+// the number of applied migrations is kept in PRAGMA user_version
+static std::vector<char const*> const migrations{{
+    R"sql(
+        ALTER TABLE images ADD COLUMN blurhash varchar NOT NULL DEFAULT '';
+        ALTER TABLE images ADD COLUMN lqip text NOT NULL DEFAULT '';
+        ALTER TABLE images ADD COLUMN dominant_color varchar NOT NULL DEFAULT '';
+    )sql",
+    R"sql(
+        CREATE TABLE sprites (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            path text NOT NULL,
+            signature varchar NOT NULL,
+            sheets integer NOT NULL DEFAULT 0,
+            created_at datetime NOT NULL
+        );
+        CREATE UNIQUE INDEX sprites_path_idx ON sprites(path);
+    )sql",
+    R"sql(
+        ALTER TABLE nodes ADD COLUMN generation integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN generation integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN size integer NOT NULL DEFAULT -1;
+        ALTER TABLE images ADD COLUMN mtime integer NOT NULL DEFAULT -1;
+        CREATE INDEX nodes_generation_idx ON nodes(generation);
+        CREATE INDEX images_generation_idx ON images(generation);
+    )sql",
+    R"sql(
+        CREATE TABLE cameras (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            make varchar NOT NULL,
+            model varchar NOT NULL
+        );
+        CREATE UNIQUE INDEX cameras_make_model_idx ON cameras(make, model);
 
-        timestamp_end = util::make_timestamp();
-        duration_ms = util::time_between(timestamp_start, timestamp_end);
+        CREATE TABLE lenses (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            make varchar NOT NULL,
+            model varchar NOT NULL
+        );
+        CREATE UNIQUE INDEX lenses_make_model_idx ON lenses(make, model);
 
-#if SHASHIN_DEBUG
-        mtx.lock();
-        std::cout << "worker_number: " << std::setw(1) << worker_number
-                  << "    "
-                  << "lower_bound: " << std::setw(4) << lower_bound
-                  << "    "
-                  << "upper_bound: " << std::setw(4) << upper_bound
-                  << "    "
-                  << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms"
-                  << "\n" << std::flush;
-        mtx.unlock();
-#endif
-    }, int(images.size()));
+        CREATE TABLE software (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            name varchar NOT NULL
+        );
+        CREATE UNIQUE INDEX software_name_idx ON software(name);
 
-    exec_transaction(R"sql(
-        UPDATE images SET
-            captured_at = ?,
-            fstop = ?,
-            exposure_time = ?,
-            iso_speed = ?,
-            exposure_bias = ?,
-            flash = ?,
-            metering_mode = ?,
-            focal_length = ?,
-            focal_length_35mm = ?,
-            camera_make = ?,
-            camera_model = ?,
-            lens_make = ?,
-            lens_model = ?,
-            software = ?,
-            description = ?,
-            copyright = ?,
-            gps = ?,
-            gps_latitude = ?,
-            gps_longitude = ?,
-            gps_altitude = ?,
+        INSERT INTO cameras (make, model) SELECT DISTINCT camera_make, camera_model FROM images WHERE camera_make != '' OR camera_model != '';
+        INSERT INTO lenses (make, model) SELECT DISTINCT lens_make, lens_model FROM images WHERE lens_make != '' OR lens_model != '';
+        INSERT INTO software (name) SELECT DISTINCT software FROM images WHERE software != '';
 
-            exif = ?,
-            updated_at = ?
-        WHERE path = ?;
-    )sql", [this, &images, &images_with_exif](sqlite3_stmt* stmt) -> void {
-        auto i{0};
-        for (auto const& path: images) {
-            auto [exif, captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, camera_make, camera_model, lens_make, lens_model, copyright, description, software, focal_length, focal_length_35mm, gps, gps_latitude, gps_longitude, gps_altitude]{images_with_exif[path]};
+        CREATE TABLE images_new (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            depth integer NOT NULL,
+            path text NOT NULL,
+            name varchar NOT NULL,
+            parent varchar NOT NULL,
+            small varchar NOT NULL,
+            medium varchar NOT NULL,
+            large varchar NOT NULL,
+            exif integer NOT NULL DEFAULT 0,
 
-            i = 0;
-            util::sqlite3_bind_string(stmt, ++i, captured_at); // captured_at
-            util::sqlite3_bind_string(stmt, ++i, fstop); // fstop
-            util::sqlite3_bind_string(stmt, ++i, exposure_time); // exposure_time
-            util::sqlite3_bind_string(stmt, ++i, iso_speed); // iso_speed
-            util::sqlite3_bind_string(stmt, ++i, exposure_bias); // exposure_bias
-            util::sqlite3_bind_string(stmt, ++i, flash); // flash
-            util::sqlite3_bind_string(stmt, ++i, metering_mode); // metering_mode
-            util::sqlite3_bind_string(stmt, ++i, focal_length); // focal_length
-            util::sqlite3_bind_string(stmt, ++i, focal_length_35mm); // focal_length_35mm
-            util::sqlite3_bind_string(stmt, ++i, camera_make); // camera_make
-            util::sqlite3_bind_string(stmt, ++i, camera_model); // camera_model
-            util::sqlite3_bind_string(stmt, ++i, lens_make); // lens_make
-            util::sqlite3_bind_string(stmt, ++i, lens_model); // lens_model
-            util::sqlite3_bind_string(stmt, ++i, software); // software
-            util::sqlite3_bind_string(stmt, ++i, description); // description
-            util::sqlite3_bind_string(stmt, ++i, copyright); // copyright
-            util::sqlite3_bind_string(stmt, ++i, gps); // gps
-            sqlite3_bind_double(stmt, ++i, gps_latitude); // gps_latitude
-            sqlite3_bind_double(stmt, ++i, gps_longitude); // gps_longitude
-            sqlite3_bind_double(stmt, ++i, gps_altitude); // gps_altitude
-            sqlite3_bind_int(stmt, ++i, exif); // exif
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
-            util::sqlite3_bind_string(stmt, ++i, path); // path
+            width integer NOT NULL DEFAULT 0,
+            height integer NOT NULL DEFAULT 0,
+            large_width integer NOT NULL DEFAULT 0,
+            large_height integer NOT NULL DEFAULT 0,
+            medium_width integer NOT NULL DEFAULT 0,
+            medium_height integer NOT NULL DEFAULT 0,
+            small_width integer NOT NULL DEFAULT 0,
+            small_height integer NOT NULL DEFAULT 0,
 
-            sqlite3_step(stmt);
-            sqlite3_reset(stmt);
-        }
-    });
+            captured_at varchar NOT NULL DEFAULT '',
+            fstop real NOT NULL DEFAULT 0,
+            exposure_time real NOT NULL DEFAULT 0,
+            iso_speed integer NOT NULL DEFAULT 0,
+            exposure_bias real NOT NULL DEFAULT 0,
+            flash integer NOT NULL DEFAULT 0,
+            metering_mode integer NOT NULL DEFAULT 0,
+            focal_length real NOT NULL DEFAULT 0,
+            focal_length_35mm integer NOT NULL DEFAULT 0,
+            camera_id integer NOT NULL DEFAULT 0,
+            lens_id integer NOT NULL DEFAULT 0,
+            software_id integer NOT NULL DEFAULT 0,
+            description varchar NOT NULL DEFAULT '',
+            copyright varchar NOT NULL DEFAULT '',
+            gps_latitude real NOT NULL DEFAULT 0,
+            gps_longitude real NOT NULL DEFAULT 0,
+            gps_altitude real NOT NULL DEFAULT 0,
 
-    timestamp_end = util::make_timestamp();
-    duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "update exif" << "\n" << std::flush;
-}
+            blurhash varchar NOT NULL DEFAULT '',
+            lqip text NOT NULL DEFAULT '',
+            dominant_color varchar NOT NULL DEFAULT '',
 
-auto Shashin::dump_list_html() const -> void {
-    long long duration_ms{0};
-    auto timestamp_end{util::make_timestamp()};
-    auto timestamp_start{util::make_timestamp()};
+            generation integer NOT NULL DEFAULT 0,
+            size integer NOT NULL DEFAULT -1,
+            mtime integer NOT NULL DEFAULT -1,
 
-    std::stringstream ss;
+            created_at datetime NOT NULL,
+            updated_at datetime NOT NULL
+        );
 
-    // style
-    ss << "<style>" << "\n";
-    ss << R"css(
-        * {
-            font-size: 12px;
-        }
-        td {
-            border: 1px solid grey;
-            padding: 2px 8px;
-        }
-    )css" << "\n";
-    ss << "</style>" << "\n";
+        INSERT INTO images_new SELECT
+            i.id, i.depth, i.path, i.name, i.parent, i.small, i.medium, i.large, i.exif,
+            i.width, i.height, i.large_width, i.large_height, i.medium_width, i.medium_height, i.small_width, i.small_height,
+            i.captured_at,
+            CAST(i.fstop AS real),
+            CASE WHEN i.exposure_time LIKE '1/%' AND CAST(substr(i.exposure_time, 3) AS real) > 0 THEN 1.0 / CAST(substr(i.exposure_time, 3) AS real) ELSE 0 END,
+            CAST(i.iso_speed AS integer),
+            CAST(i.exposure_bias AS real),
+            CASE i.flash WHEN 'on' THEN 1 ELSE 0 END,
+            CASE i.metering_mode
+                WHEN 'Average' THEN 1
+                WHEN 'Center-weighted average' THEN 2
+                WHEN 'Spot' THEN 3
+                WHEN 'Multi-spot' THEN 4
+                WHEN 'Multi-segment' THEN 5
+                WHEN 'Partial' THEN 6
+                WHEN 'Other' THEN 255
+                ELSE 0
+            END,
+            CAST(i.focal_length AS real),
+            CAST(i.focal_length_35mm AS integer),
+            coalesce(c.id, 0),
+            coalesce(l.id, 0),
+            coalesce(s.id, 0),
+            i.description,
+            i.copyright,
+            CAST(i.gps_latitude AS real),
+            CAST(i.gps_longitude AS real),
+            CAST(i.gps_altitude AS real),
+            i.blurhash, i.lqip, i.dominant_color,
+            i.generation, i.size, i.mtime,
+            i.created_at, i.updated_at
+        FROM images i
+        LEFT JOIN cameras c ON c.make = i.camera_make AND c.model = i.camera_model
+        LEFT JOIN lenses l ON l.make = i.lens_make AND l.model = i.lens_model
+        LEFT JOIN software s ON s.name = i.software;
 
-    // nodes
-    ss << "<table>" << "\n";
-    ss << "<tr>" << "\n"
-       << "<td><b>depth</b></td>" << "\n"
-       << "<td><b>path</b></td>" << "\n"
-       << "<td><b>created_at</b></td>" << "\n"
-       << "<td><b>updated_at</b></td>" << "\n"
-       << "<td><b>name</b></td>" << "\n"
-       << "<td><b>url</b></td>" << "\n"
-       << "<td><b>hash</b></td>" << "\n"
-       << "<td><b>captured_at</b></td>" << "\n"
-       << "<td><b>title</b></td>" << "\n"
-       << "<td><b>event</b></td>" << "\n"
-       << "<td><b>location</b></td>" << "\n"
-       << "<td><b>city</b></td>" << "\n"
-       << "<td><b>country</b></td>" << "\n"
-       << "</tr>" << "\n";
-    exec_transaction(R"sql(
-        SELECT
-            depth,
-            path,
-            created_at,
-            updated_at,
-            name,
-            url,
-            hash,
-            captured_at,
+        DROP TABLE images;
+        ALTER TABLE images_new RENAME TO images;
+        CREATE UNIQUE INDEX images_path_idx ON images(path);
+        CREATE INDEX images_generation_idx ON images(generation);
+    )sql",
+    R"sql(
+        CREATE TABLE exports (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            name varchar NOT NULL,
+            signature varchar NOT NULL,
+            created_at datetime NOT NULL
+        );
+        CREATE UNIQUE INDEX exports_name_idx ON exports(name);
+    )sql",
+    R"sql(
+        CREATE VIRTUAL TABLE search USING fts5(
+            hash UNINDEXED,
+            path UNINDEXED,
             title,
             event,
             location,
             city,
-            country
-        FROM nodes
-        ORDER BY depth, path, captured_at, title;
-    )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
-        auto i{0};
-        auto rc{0};
-        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-            i = -1;
-            auto depth{sqlite3_column_int(stmt, ++i)};
-            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto event{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto location{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto city{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto country{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            country,
+            cameras,
+            lenses
+        );
+    )sql",
+    R"sql(
+        CREATE VIRTUAL TABLE images_geo USING rtree(id, min_latitude, max_latitude, min_longitude, max_longitude);
+        INSERT INTO images_geo SELECT id, gps_latitude, gps_latitude, gps_longitude, gps_longitude FROM images WHERE gps_latitude != 0 OR gps_longitude != 0;
 
-            ss << "<tr>" << "\n"
-               << "<td><nobr>" << depth << "</nobr></td>" << "\n"
-               << "<td><nobr>" << path << "</nobr></td>" << "\n"
-               << "<td><nobr>" << created_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << updated_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << name << "</nobr></td>" << "\n"
-               << "<td><nobr>" << url << "</nobr></td>" << "\n"
-               << "<td><nobr>" << hash << "</nobr></td>" << "\n"
-               << "<td><nobr>" << captured_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << title << "</nobr></td>" << "\n"
-               << "<td><nobr>" << event << "</nobr></td>" << "\n"
-               << "<td><nobr>" << location << "</nobr></td>" << "\n"
-               << "<td><nobr>" << city << "</nobr></td>" << "\n"
-               << "<td><nobr>" << country << "</nobr></td>" << "\n"
-               << "</tr>" << "\n";
-        }
-        if (rc != SQLITE_DONE) {
-            std::cerr << "Error: " << sqlite3_errmsg(m_db)
-                #ifdef SHASHIN_DEBUG
+        CREATE TRIGGER images_geo_insert AFTER INSERT ON images WHEN new.gps_latitude != 0 OR new.gps_longitude != 0 BEGIN
+            INSERT INTO images_geo VALUES (new.id, new.gps_latitude, new.gps_latitude, new.gps_longitude, new.gps_longitude);
+        END;
+        CREATE TRIGGER images_geo_update AFTER UPDATE OF gps_latitude, gps_longitude ON images BEGIN
+            DELETE FROM images_geo WHERE id = old.id;
+            INSERT INTO images_geo SELECT new.id, new.gps_latitude, new.gps_latitude, new.gps_longitude, new.gps_longitude WHERE new.gps_latitude != 0 OR new.gps_longitude != 0;
+        END;
+        CREATE TRIGGER images_geo_delete AFTER DELETE ON images BEGIN
+            DELETE FROM images_geo WHERE id = old.id;
+        END;
+    )sql",
+    R"sql(
+        ALTER TABLE images ADD COLUMN medium_alias integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN large_alias integer NOT NULL DEFAULT 0;
+    )sql",
+    R"sql(
+        ALTER TABLE images ADD COLUMN small_quality integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN small_bytes integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN medium_quality integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN medium_bytes integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN large_quality integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN large_bytes integer NOT NULL DEFAULT 0;
+    )sql",
+    R"sql(
+        CREATE TABLE compressed (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            path varchar NOT NULL,
+            hash varchar NOT NULL,
+            created_at datetime NOT NULL
+        );
+        CREATE UNIQUE INDEX compressed_path_idx ON compressed(path);
+    )sql",
+    R"sql(
+        CREATE TABLE manifest (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            path varchar NOT NULL,
+            size integer NOT NULL,
+            hash varchar NOT NULL,
+            immutable integer NOT NULL DEFAULT 0,
+            generation integer NOT NULL,
+            created_at datetime NOT NULL,
+            updated_at datetime NOT NULL
+        );
+        CREATE UNIQUE INDEX manifest_path_idx ON manifest(path);
+        CREATE INDEX manifest_generation_idx ON manifest(generation);
+    )sql",
+    R"sql(
+        ALTER TABLE images ADD COLUMN xmp integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN xmp_size integer NOT NULL DEFAULT -1;
+        ALTER TABLE images ADD COLUMN xmp_mtime integer NOT NULL DEFAULT -1;
+        ALTER TABLE images ADD COLUMN rating integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN label varchar NOT NULL DEFAULT '';
+        ALTER TABLE images ADD COLUMN pick integer NOT NULL DEFAULT 0;
+        ALTER TABLE images ADD COLUMN caption varchar NOT NULL DEFAULT '';
+        CREATE INDEX images_pick_idx ON images(pick);
+
+        CREATE TABLE keywords (
+            id integer PRIMARY KEY AUTOINCREMENT NOT NULL,
+            name varchar NOT NULL
+        );
+        CREATE UNIQUE INDEX keywords_name_idx ON keywords(name);
+
+        CREATE TABLE image_keywords (
+            image_id integer NOT NULL,
+            keyword_id integer NOT NULL,
+            PRIMARY KEY (image_id, keyword_id)
+        );
+        CREATE INDEX image_keywords_keyword_idx ON image_keywords(keyword_id);
+
+        CREATE TRIGGER image_keywords_delete AFTER DELETE ON images BEGIN
+            DELETE FROM image_keywords WHERE image_id = old.id;
+        END;
+    )sql",
+    R"sql(
+        ALTER TABLE images ADD COLUMN phash integer;
+        ALTER TABLE images ADD COLUMN duplicate_of varchar NOT NULL DEFAULT '';
+    )sql",
+    R"sql(
+        ALTER TABLE manifest ADD COLUMN deleted integer NOT NULL DEFAULT 0;
+    )sql",
+}};
+
+auto Shashin::migrate_database() const -> void {
+    auto version{0};
+    exec_query("PRAGMA user_version", [](void* dst, int argc, char** argv, char** column_names) -> int {
+        (void)column_names;
+        if (argc > 0 && argv[0] != nullptr) {
+            *static_cast<int*>(dst) = std::stoi(argv[0]);
+        }
+        return 0;
+    }, &version);
+
+    for (auto i{size_t(version)}; i < migrations.size(); ++i) {
+        auto const user_version{"PRAGMA user_version = " + std::to_string(i + 1)};
+        exec_query("BEGIN TRANSACTION");
+        for (auto const query : {migrations[i], user_version.c_str(), "COMMIT TRANSACTION"}) {
+            char* sqlite_error_message{nullptr};
+            auto const rc{sqlite3_exec(m_db, query, nullptr, nullptr, &sqlite_error_message)};
+            sqlite3_free(sqlite_error_message);
+            if (rc != SQLITE_OK) {
+                // keep user_version at the last complete migration
+                auto const message{std::string{sqlite3_errmsg(m_db)}};
+                exec_query("ROLLBACK TRANSACTION");
+                throw std::runtime_error("Failed to migrate the database to version " + std::to_string(i + 1) + ": " + message);
+            }
+        }
+    }
+}
+
+auto Shashin::close_database() -> void {
+    save_database();
+
+    auto rc{0};
+    rc = sqlite3_close(m_db);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    }
+}
+
+// the snapshot goes to "<path>.tmp" first and is renamed over the file, so the file is always a complete database
+auto Shashin::save_database() const -> void {
+    if (!m_in_memory) {
+        return;
+    }
+
+    auto const tmp_path{fs::path{m_config.database_path()}.concat(".tmp")};
+    std::error_code ec;
+    fs::remove(tmp_path, ec);
+
+    auto rc{0};
+    sqlite3* disk_db{nullptr};
+    rc = sqlite3_open_v2(tmp_path.string().c_str(), &disk_db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, nullptr);
+    if (rc == SQLITE_OK) {
+        sqlite3_mutex_enter(sqlite3_db_mutex(m_db));
+        rc = util::sqlite3_copy(m_db, disk_db);
+        sqlite3_mutex_leave(sqlite3_db_mutex(m_db));
+    }
+    sqlite3_close(disk_db);
+    if (rc == SQLITE_OK) {
+        fs::rename(tmp_path, m_config.database_path(), ec);
+    }
+    if (rc == SQLITE_OK && !ec) {
+        // the copy is synced by SQLite itself, the rename only once its directory is
+        util::sync_path(m_config.database_path().parent_path());
+    } else {
+        std::error_code remove_ec;
+        fs::remove(tmp_path, remove_ec);
+        std::cerr << "Error: " << "Failed to save database: " << (rc != SQLITE_OK ? sqlite3_errstr(rc) : ec.message())
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    }
+}
+
+auto Shashin::exec_query(std::string const& query, int (*callback)(void*, int argc, char**, char**), void* dst) const -> void {
+    auto rc{0};
+    char* sqlite_error_message{nullptr};
+    rc = sqlite3_exec(m_db, query.c_str(), callback, dst, &sqlite_error_message);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    }
+    sqlite3_free(sqlite_error_message);
+}
+
+auto Shashin::exec_transaction(char const* const query, std::function<void(sqlite3_stmt* stmt)> func) const -> void {
+    auto rc{0};
+    sqlite3_stmt* stmt{nullptr};
+    sqlite3_mutex_enter(sqlite3_db_mutex(m_db));
+    exec_query("BEGIN TRANSACTION");
+    rc = sqlite3_prepare_v2(m_db, query, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    } else {
+        func(stmt);
+    }
+    exec_query("COMMIT TRANSACTION");
+    sqlite3_finalize(stmt);
+    sqlite3_mutex_leave(sqlite3_db_mutex(m_db));
+}
+
+auto Shashin::create_directories() const -> void {
+    std::vector<fs::path> const paths {
+        m_config.shashin_path(),
+        m_config.gallery_path(),
+        m_config.site_path(),
+        m_config.cache_path(),
+        m_config.data_path()
+    };
+    for (auto const& path : paths) {
+        if (!fs::exists(path)) {
+            fs::create_directories(path);
+        }
+    }
+    for (auto const& path : paths) {
+        if (!fs::exists(path)) {
+            throw fs::filesystem_error("Failed to create directory: " + path.string(), std::error_code());
+        }
+    }
+}
+
+// "<path>.tmp" files are only left behind by a run that stopped between writing and renaming them
+auto Shashin::remove_stray_files() const -> void {
+    for (auto const& base : {m_config.shashin_path(), m_config.site_path()}) {
+        auto const paths{list_directory_recursive(base, [](fs::path const& path) -> bool {
+            return fs::is_regular_file(path) && path.extension() == ".tmp";
+        })};
+        for (auto const& path : paths) {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    }
+}
+
+auto Shashin::is_gallery(std::string const& name) const -> bool {
+    return std::count(name.begin(), name.end(), *(m_config.gallery_delim().c_str())) > 0;
+}
+
+auto Shashin::gallery_parts(std::string const&name) const -> std::tuple<std::string, std::string, std::string, std::string, std::string, std::string> {
+    std::string captured_at;
+    std::string title;
+    std::string event;
+    std::string location;
+    std::string city;
+    std::string country;
+
+    if (is_gallery(name)) {
+        captured_at = [&name]() -> std::string const {
+            std::smatch match;
+            if (std::regex_match(name, match, std::regex("^[0-9]{6}.*"))) {
+                return "20" + name.substr(0, 2) + "-" + name.substr(2, 2) + "-" + name.substr(4, 2) + " 00:00:00";
+            }
+            return std::string("");
+        }();
+
+        std::vector<std::string> tokens{util::str_split(name, m_config.gallery_delim())};
+        auto const finalize_meta_data{[](std::string& input) -> void {
+            util::stackoverflow::trim(input);
+            if (input == "nil" || input == "null") {
+                input = "";
+            }
+        }};
+
+        title = [&]() -> std::string const {
+            std::string str;
+            if (tokens.size() > 0) {
+                str = tokens[0];
+            }
+            if (captured_at.size() > 0 && str.size() > 6) {
+                str = str.substr(6);
+            }
+            finalize_meta_data(str);
+            return str;
+        }();
+
+        event = [&]() -> std::string const {
+            std::string str;
+            if (tokens.size() > 1) {
+                str = tokens[1];
+            }
+            finalize_meta_data(str);
+            return str;
+        }();
+
+        location = [&]() -> std::string const {
+            std::string str;
+            if (tokens.size() > 2) {
+                str = tokens[2];
+            }
+            finalize_meta_data(str);
+            return str;
+        }();
+
+        city = [&]() -> std::string const {
+            std::string str;
+            if (tokens.size() > 3) {
+                str = tokens[3];
+            }
+            str = std::regex_replace(str, std::regex(",.*"), "");
+            finalize_meta_data(str);
+            return str;
+        }();
+
+        country = [&]() -> std::string const {
+            std::string str;
+            if (tokens.size() > 3) {
+                str = tokens[3];
+            }
+            str = std::regex_replace(str, std::regex(".*?,"), "");
+            finalize_meta_data(str);
+            return str;
+        }();
+    }
+
+    return {captured_at, title, event, location, city, country};
+}
+
+auto Shashin::load_priorities() const -> std::vector<std::string> {
+    // node paths relative to the gallery, one per line, lines starting with # are comments
+    std::vector<std::string> priorities;
+    auto const priority_path{fs::path{m_config.gallery_path()}.append(m_config.priority_file())};
+    if (!fs::exists(priority_path)) {
+        return priorities;
+    }
+    std::ifstream ifs{priority_path};
+    std::string line;
+    while (std::getline(ifs, line)) {
+        util::stackoverflow::trim(line);
+        while (line.size() > 0 && line.back() == '/') {
+            line.pop_back();
+        }
+        if (line.size() > 0 && line[0] != '#') {
+            priorities.push_back(line);
+        }
+    }
+    return priorities;
+}
+
+auto Shashin::load_failures() const -> std::unordered_map<std::string, std::tuple<long long, long long>> {
+    std::unordered_map<std::string, std::tuple<long long, long long>> failures;
+    exec_transaction(R"sql(
+        SELECT path, size, mtime FROM failures;
+    )sql", [this, &failures](sqlite3_stmt* stmt) -> void {
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            failures[path] = {sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2)};
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+    return failures;
+}
+
+auto Shashin::is_quarantined(std::unordered_map<std::string, std::tuple<long long, long long>> const& failures, std::string const& path) const -> bool {
+    // a failed image stays quarantined until its size or modification time changes
+    auto const it{failures.find(path)};
+    if (it == failures.end()) {
+        return false;
+    }
+    return util::file_stat(fs::path{m_config.gallery_path()}.append(path)) == it->second;
+}
+
+auto Shashin::insert_failures(std::vector<std::tuple<std::string, std::string, std::string>> const& failures) const -> void {
+    if (failures.size() == 0) {
+        return;
+    }
+
+    exec_transaction(R"sql(
+        INSERT INTO failures (created_at, path, stage, error, size, mtime)
+        VALUES (?,?,?,?,?,?)
+        ON CONFLICT(path) DO UPDATE SET created_at=excluded.created_at, stage=excluded.stage, error=excluded.error, size=excluded.size, mtime=excluded.mtime;
+    )sql", [this, &failures](sqlite3_stmt* stmt) -> void {
+        int i{0};
+        for (auto const& [path, stage, error]: failures) {
+            auto const [size, mtime]{util::file_stat(fs::path{m_config.gallery_path()}.append(path))};
+
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+            util::sqlite3_bind_string(stmt, ++i, stage); // stage
+            util::sqlite3_bind_string(stmt, ++i, error); // error
+            sqlite3_bind_int64(stmt, ++i, size); // size
+            sqlite3_bind_int64(stmt, ++i, mtime); // mtime
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+}
+
+auto Shashin::delete_failures(std::vector<std::string> const& paths) const -> void {
+    if (paths.size() == 0) {
+        return;
+    }
+
+    exec_transaction(R"sql(
+        DELETE FROM failures WHERE path = ?;
+    )sql", [&paths](sqlite3_stmt* stmt) -> void {
+        for (auto const& path: paths) {
+            util::sqlite3_bind_string(stmt, 1, path); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+}
+
+auto Shashin::print_failures() const -> void {
+    std::stringstream ss;
+    auto total{0};
+
+    exec_transaction(R"sql(
+        SELECT stage, count(*) FROM failures GROUP BY stage ORDER BY stage;
+    )sql", [&ss, &total](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto stage{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            auto count{sqlite3_column_int(stmt, 1)};
+            ss << std::setfill(' ') << std::setw(8) << count << " " << "img" << "  " << "quarantined at " << stage << "\n";
+            total += count;
+        }
+    });
+
+    exec_transaction(R"sql(
+        SELECT stage, path, error FROM failures WHERE created_at = ? ORDER BY stage, path;
+    )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
+        util::sqlite3_bind_string(stmt, 1, m_config.current_time()); // created_at
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto stage{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 1))}};
+            auto error{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 2))}};
+            ss << "        " << "   " << "  " << "failed now: " << path << " (" << stage << ": " << error << ")" << "\n";
+        }
+    });
+
+    if (total > 0) {
+        std::cout << "---------------------------------" << "\n"
+                  << ss.str() << std::flush;
+    }
+}
+
+// every export is derived from the same rows, so their counts and generations tell whether anything changed;
+// cache_dir is part of it because the exported paths contain it
+auto Shashin::export_signature() const -> std::string {
+    // the sums of the generations and the latest updated_at change with every row that is written, not only with the latest generation;
+    // migrations rewrite rows without either, so the schema version is part of it as well;
+    // the generation stays the same while process_images runs, the number of published images tells partial exports apart
+    // and the number of images with parsed EXIF and sidecars tells them from the update_exif that follows the last of them
+    std::string signature;
+    auto const query{std::string{R"sql(
+        SELECT
+            (SELECT count(*) FROM images),
+            (SELECT count(*) FROM nodes),
+            (SELECT coalesce(max(generation), 0) FROM images),
+            (SELECT coalesce(max(generation), 0) FROM nodes),
+            (SELECT coalesce(sum(generation), 0) FROM images),
+            (SELECT coalesce(sum(generation), 0) FROM nodes),
+            (SELECT coalesce(max(updated_at), '') FROM images),
+            (SELECT coalesce(max(updated_at), '') FROM nodes),
+            (SELECT user_version FROM pragma_user_version),
+            (SELECT count(*) FROM images i WHERE )sql"} + published_images + R"sql(),
+            (SELECT count(*) FROM images WHERE exif != 0),
+            (SELECT count(*) FROM images WHERE xmp != 0);
+    )sql"};
+    exec_transaction(query.c_str(), [this, &signature](sqlite3_stmt* stmt) -> void {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            std::stringstream ss;
+            ss << sqlite3_column_int64(stmt, 0) << ":"
+               << sqlite3_column_int64(stmt, 1) << ":"
+               << sqlite3_column_int64(stmt, 2) << ":"
+               << sqlite3_column_int64(stmt, 3) << ":"
+               << sqlite3_column_int64(stmt, 4) << ":"
+               << sqlite3_column_int64(stmt, 5) << ":"
+               << reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 6)) << ":"
+               << reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 7)) << ":"
+               << sqlite3_column_int64(stmt, 8) << ":"
+               << sqlite3_column_int64(stmt, 9) << ":"
+               << sqlite3_column_int64(stmt, 10) << ":"
+               << sqlite3_column_int64(stmt, 11) << ":"
+               << m_config.cache_dir();
+            signature = ss.str();
+        }
+    });
+    return signature;
+}
+
+auto Shashin::load_export_signatures() const -> std::unordered_map<std::string, std::string> {
+    std::unordered_map<std::string, std::string> signatures;
+    exec_transaction(R"sql(
+        SELECT name, signature FROM exports;
+    )sql", [&signatures](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            signatures[name] = std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 1))};
+        }
+    });
+    return signatures;
+}
+
+auto Shashin::store_export_signatures(std::vector<std::string> const& names, std::string const& signature) const -> void {
+    std::vector<std::tuple<std::string, std::string>> signatures;
+    for (auto const& name: names) {
+        signatures.push_back({name, signature});
+    }
+    store_export_signatures(signatures);
+}
+
+auto Shashin::store_export_signatures(std::vector<std::tuple<std::string, std::string>> const& signatures) const -> void {
+    exec_transaction(R"sql(
+        INSERT INTO exports (created_at, name, signature)
+        VALUES (?,?,?)
+        ON CONFLICT(name) DO UPDATE SET created_at=excluded.created_at, signature=excluded.signature;
+    )sql", [this, &signatures](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& [name, signature]: signatures) {
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+            util::sqlite3_bind_string(stmt, ++i, name); // name
+            util::sqlite3_bind_string(stmt, ++i, signature); // signature
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+}
+
+// paths are kept below the project like those of the compressed table, the uploader maps them onto the site
+auto Shashin::manifest_entry(fs::path const& path, std::vector<unsigned char> const& data, bool immutable) const -> std::tuple<std::string, long long, std::string, bool> {
+    return {
+        path.lexically_relative(m_config.project_path()).generic_string(),
+        (long long)(data.size()),
+        util::hash_to_hex_string(util::string_to_hash(std::string{data.begin(), data.end()})),
+        immutable,
+    };
+}
+
+// for files written without their content at hand, e.g. links, the files are read back
+auto Shashin::manifest_entries(std::vector<fs::path> const& paths, bool immutable) const -> std::vector<std::tuple<std::string, long long, std::string, bool>> {
+    std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+    auto const contents{util::read_files(paths, m_config.io_backend())};
+    for (size_t k{0}; k < paths.size(); ++k) {
+        auto const& [data, error]{contents[k]};
+        if (error.size() > 0) {
+            std::cerr << "Error: " << error
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+            continue;
+        }
+        entries.push_back(manifest_entry(paths[k], data, immutable));
+    }
+    return entries;
+}
+
+// a file rewritten with the same content keeps its generation, so changed-since only lists what has to be uploaded;
+// a file whose content changed under its name was cached with the old one, so it is mutable from then on
+auto Shashin::store_manifest(std::vector<std::tuple<std::string, long long, std::string, bool>> const& entries) const -> void {
+    exec_transaction(R"sql(
+        INSERT INTO manifest (created_at, updated_at, generation, path, size, hash, immutable)
+        VALUES (?,?,?,?,?,?,?)
+        ON CONFLICT(path) DO UPDATE SET updated_at=excluded.updated_at, generation=excluded.generation, size=excluded.size, hash=excluded.hash, immutable=0, deleted=0
+        WHERE manifest.hash != excluded.hash OR manifest.size != excluded.size OR manifest.deleted != 0;
+    )sql", [this, &entries](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& [path, size, hash, immutable]: entries) {
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+            sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+            sqlite3_bind_int64(stmt, ++i, size); // size
+            util::sqlite3_bind_string(stmt, ++i, hash); // hash
+            sqlite3_bind_int(stmt, ++i, immutable ? 1 : 0); // immutable
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+}
+
+// files that are gone since they were recorded get a tombstone, so the uploader removes them as well
+auto Shashin::sweep_manifest() const -> void {
+    std::vector<std::string> paths;
+    exec_transaction(R"sql(
+        SELECT path FROM manifest WHERE deleted = 0;
+    )sql", [&paths](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            paths.push_back(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))});
+        }
+    });
+
+    std::vector<std::string> removed;
+    for (auto const& path: paths) {
+        std::error_code ec;
+        if (!fs::exists(fs::path{m_config.project_path()}.append(path), ec) && !ec) {
+            removed.push_back(path);
+        }
+    }
+
+    exec_transaction(R"sql(
+        UPDATE manifest SET updated_at = ?, generation = ?, size = 0, hash = '', immutable = 0, deleted = 1 WHERE path = ?;
+    )sql", [this, &removed](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& path: removed) {
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+            sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+    std::cout << std::setfill(' ') << std::setw(8) << removed.size() << " " << "file" << "  " << "removed from the manifest" << "\n" << std::flush;
+}
+
+auto Shashin::sync_nodes() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    auto const nodes{list_directory_recursive(m_config.gallery_path(), [](fs::path const& path) -> bool {
+        return fs::is_directory(path);
+    })};
+
+    // only the difference to the known nodes is written, a run without changes leaves the table untouched
+    std::unordered_set<std::string> known;
+    exec_transaction(R"sql(
+        SELECT path FROM nodes;
+    )sql", [&known](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            known.insert(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))});
+        }
+    });
+
+    std::vector<std::string> inserted;
+    for (auto const& abs_path: nodes) {
+        auto const path{fs::relative(abs_path, m_config.gallery_path()).string()};
+        if (known.erase(path) == 0) {
+            inserted.push_back(path);
+        }
+    }
+
+    if (inserted.size() > 0) {
+        exec_transaction(R"sql(
+            INSERT INTO nodes (created_at, updated_at, generation, depth, path, name, url, hash, captured_at, title, event, location, city, country)
+            VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?);
+        )sql", [this, &inserted](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& path: inserted) {
+                auto const name{fs::path{path}.filename().string()};
+                auto const url{util::string_to_url(path)};
+                auto const hash{util::hash_to_hex_string(util::string_to_hash(path))};
+                auto const depth{static_cast<int>(std::count(path.begin(), path.end(), '/'))};
+                auto [captured_at, title, event, location, city, country]{gallery_parts(name)};
+
+                i = 0;
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                sqlite3_bind_int(stmt, ++i, depth); // depth
+                util::sqlite3_bind_string(stmt, ++i, path); // path
+                util::sqlite3_bind_string(stmt, ++i, name); // name
+                util::sqlite3_bind_string(stmt, ++i, url); // url
+                util::sqlite3_bind_string(stmt, ++i, hash); // hash
+                util::sqlite3_bind_string(stmt, ++i, captured_at); // captured_at
+                util::sqlite3_bind_string(stmt, ++i, title); // title
+                util::sqlite3_bind_string(stmt, ++i, event); // event
+                util::sqlite3_bind_string(stmt, ++i, location); // location
+                util::sqlite3_bind_string(stmt, ++i, city); // city
+                util::sqlite3_bind_string(stmt, ++i, country); // country
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    // whatever is left in known was not found on disk anymore
+    if (known.size() > 0) {
+        exec_transaction(R"sql(
+            DELETE FROM nodes WHERE path = ?;
+        )sql", [&known](sqlite3_stmt* stmt) -> void {
+            for (auto const& path: known) {
+                util::sqlite3_bind_string(stmt, 1, path); // path
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "sync nodes" << "\n" << std::flush;
+}
+
+auto Shashin::sync_images() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    // XMP sidecars are found by the same scan
+    auto const files{list_directory_recursive(m_config.gallery_path(), [](fs::path const& path) -> bool {
+        return !fs::is_directory(path) && fs::is_regular_file(path)
+            && (path.extension() == ".jpg" || path.extension() == ".jpeg" || path.extension() == ".jpe" || path.extension() == ".xmp" || util::is_raw(path));
+    })};
+    std::vector<fs::path> images;
+    std::unordered_set<std::string> xmps;
+    std::unordered_set<std::string> jpeg_stems;
+    for (auto const& path: files) {
+        if (path.extension() == ".xmp") {
+            xmps.insert(path.string());
+        } else if (!util::is_raw(path)) {
+            jpeg_stems.insert(fs::path{path}.replace_extension().string());
+        }
+    }
+    // a RAW file is only published through its embedded preview if it was shot without a JPEG next to it
+    for (auto const& path: files) {
+        if (path.extension() != ".xmp" && (!util::is_raw(path) || jpeg_stems.count(fs::path{path}.replace_extension().string()) == 0)) {
+            images.push_back(path);
+        }
+    }
+
+    // size and modification time decide whether a known image or sidecar changed, so unchanged ones cause no write at all
+    std::unordered_map<std::string, std::tuple<long long, long long>> known;
+    std::unordered_map<std::string, std::tuple<long long, long long>> known_xmps;
+    exec_transaction(R"sql(
+        SELECT path, size, mtime, xmp_size, xmp_mtime FROM images;
+    )sql", [&known, &known_xmps](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            known[path] = {sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2)};
+            known_xmps[path] = {sqlite3_column_int64(stmt, 3), sqlite3_column_int64(stmt, 4)};
+        }
+    });
+
+    std::vector<std::tuple<std::string, long long, long long>> inserted;
+    std::vector<std::tuple<std::string, long long, long long>> modified;
+    std::vector<std::tuple<std::string, long long, long long>> recorded;
+    std::vector<std::tuple<std::string, long long, long long>> sidecars;
+    for (auto const& abs_path: images) {
+        auto const path{fs::relative(abs_path, m_config.gallery_path()).string()};
+        auto const [size, mtime]{util::file_stat(abs_path)};
+
+        // the name darktable gives a sidecar first, then the one of Lightroom, -1 without one
+        std::tuple<long long, long long> xmp_stat{-1, -1};
+        for (auto const& xmp_path: {fs::path{abs_path}.concat(".xmp"), fs::path{abs_path}.replace_extension(".xmp")}) {
+            if (xmps.count(xmp_path.string()) > 0) {
+                xmp_stat = util::file_stat(xmp_path);
+                break;
+            }
+        }
+        auto const xmp_it{known_xmps.find(path)};
+        if ((xmp_it == known_xmps.end() && std::get<0>(xmp_stat) != -1) || (xmp_it != known_xmps.end() && xmp_it->second != xmp_stat)) {
+            sidecars.push_back({path, std::get<0>(xmp_stat), std::get<1>(xmp_stat)});
+        }
+
+        auto const it{known.find(path)};
+        if (it == known.end()) {
+            inserted.push_back({path, size, mtime});
+            continue;
+        }
+        // rows from before size and mtime were stored only get them recorded
+        if (std::get<0>(it->second) == -1) {
+            recorded.push_back({path, size, mtime});
+        } else if (it->second != std::make_tuple(size, mtime)) {
+            modified.push_back({path, size, mtime});
+        }
+        known.erase(it);
+    }
+
+    if (inserted.size() > 0) {
+        exec_transaction(R"sql(
+            INSERT INTO images (created_at, updated_at, generation, depth, path, name, parent, small, medium, large, size, mtime)
+            VALUES (?,?,?,?,?,?,?,?,?,?,?,?);
+        )sql", [this, &inserted](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& [path, size, mtime]: inserted) {
+                auto const rel_path{fs::path{path}};
+                auto const name{rel_path.filename().string()};
+                auto const depth{static_cast<int>(std::count(path.begin(), path.end(), '/'))};
+                auto const parent{rel_path.parent_path().string()};
+                auto const small{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_small()))};
+                auto const medium{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_medium()))};
+                auto const large{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_large()))};
+
+                i = 0;
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                sqlite3_bind_int(stmt, ++i, depth); // depth
+                util::sqlite3_bind_string(stmt, ++i, path); // path
+                util::sqlite3_bind_string(stmt, ++i, name); // name
+                util::sqlite3_bind_string(stmt, ++i, parent); // parent
+                util::sqlite3_bind_string(stmt, ++i, small); // small
+                util::sqlite3_bind_string(stmt, ++i, medium); // medium
+                util::sqlite3_bind_string(stmt, ++i, large); // large
+                sqlite3_bind_int64(stmt, ++i, size); // size
+                sqlite3_bind_int64(stmt, ++i, mtime); // mtime
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    if (recorded.size() > 0) {
+        exec_transaction(R"sql(
+            UPDATE images SET size = ?, mtime = ? WHERE path = ?;
+        )sql", [&recorded](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& [path, size, mtime]: recorded) {
+                i = 0;
+                sqlite3_bind_int64(stmt, ++i, size); // size
+                sqlite3_bind_int64(stmt, ++i, mtime); // mtime
+                util::sqlite3_bind_string(stmt, ++i, path); // path
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    // a new, changed or removed sidecar is parsed again by update_exif
+    if (sidecars.size() > 0) {
+        exec_transaction(R"sql(
+            UPDATE images SET xmp = 0, xmp_size = ?, xmp_mtime = ? WHERE path = ?;
+        )sql", [&sidecars](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& [path, size, mtime]: sidecars) {
+                i = 0;
+                sqlite3_bind_int64(stmt, ++i, size); // xmp_size
+                sqlite3_bind_int64(stmt, ++i, mtime); // xmp_mtime
+                util::sqlite3_bind_string(stmt, ++i, path); // path
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    // a changed source invalidates its EXIF, tiers and placeholders, the later stages then redo them
+    if (modified.size() > 0) {
+        exec_transaction(R"sql(
+            UPDATE images SET
+                size = ?,
+                mtime = ?,
+                exif = 0,
+                width = 0,
+                height = 0,
+                large_width = 0,
+                large_height = 0,
+                medium_width = 0,
+                medium_height = 0,
+                small_width = 0,
+                small_height = 0,
+                blurhash = '',
+                lqip = '',
+                dominant_color = '',
+                phash = NULL,
+                duplicate_of = '',
+
+                generation = ?,
+                updated_at = ?
+            WHERE path = ?;
+        )sql", [this, &modified](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& [path, size, mtime]: modified) {
+                i = 0;
+                sqlite3_bind_int64(stmt, ++i, size); // size
+                sqlite3_bind_int64(stmt, ++i, mtime); // mtime
+                sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                util::sqlite3_bind_string(stmt, ++i, path); // path
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+
+                auto const parent{util::hash_to_hex_string(util::string_to_hash(fs::path{path}.parent_path().string()))};
+                auto const large{util::hash_to_hex_string(util::string_to_hash(path + m_config.salt_large()))};
+                std::error_code ec;
+                fs::remove(fs::path{m_config.cache_path()}.append("deepzoom").append(parent).append(large + ".dzi"), ec);
+            }
+        });
+    }
+
+    if (known.size() > 0) {
+        exec_transaction(R"sql(
+            DELETE FROM images WHERE path = ?;
+        )sql", [&known](sqlite3_stmt* stmt) -> void {
+            for (auto const& [path, stat]: known) {
+                util::sqlite3_bind_string(stmt, 1, path); // path
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+        exec_query("DELETE FROM failures WHERE path NOT IN (SELECT path FROM images)");
+    }
+
+    // near duplicates hold links to the tiers of a changed or removed image as they were, they get medium and large tier of their own again
+    std::vector<std::string> originals;
+    for (auto const& [path, size, mtime]: modified) {
+        originals.push_back(path);
+    }
+    for (auto const& [path, stat]: known) {
+        originals.push_back(path);
+    }
+    if (originals.size() > 0) {
+        exec_transaction(R"sql(
+            UPDATE images SET
+                large_width = 0,
+                large_height = 0,
+                medium_width = 0,
+                medium_height = 0,
+                duplicate_of = '',
+
+                generation = ?,
+                updated_at = ?
+            WHERE duplicate_of = ?;
+        )sql", [this, &originals](sqlite3_stmt* stmt) -> void {
+            int i{0};
+            for (auto const& path: originals) {
+                i = 0;
+                sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                util::sqlite3_bind_string(stmt, ++i, path); // duplicate_of
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        });
+    }
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "sync images" << "\n" << std::flush;
+}
+
+auto Shashin::dictionary_ids(std::vector<decltype(util::exif_info(nullptr, 0))> const& infos, std::vector<size_t> const& indices) const -> std::vector<std::tuple<long long, long long, long long>> {
+    using key_t = std::tuple<std::string, std::string>;
+    std::map<key_t, long long> cameras;
+    std::map<key_t, long long> lenses;
+    std::map<key_t, long long> software;
+    for (auto const index: indices) {
+        auto const& [exif, captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, camera_make, camera_model, lens_make, lens_model, copyright, description, software_name, focal_length, focal_length_35mm, gps_latitude, gps_longitude, gps_altitude]{infos[index]};
+        if (camera_make.size() > 0 || camera_model.size() > 0) {
+            cameras[{camera_make, camera_model}] = 0;
+        }
+        if (lens_make.size() > 0 || lens_model.size() > 0) {
+            lenses[{lens_make, lens_model}] = 0;
+        }
+        if (software_name.size() > 0) {
+            software[{software_name, ""}] = 0;
+        }
+    }
+
+    // new values are inserted first, then the ids of all values of the batch are looked up, columns is 1 for software
+    auto const resolve{[this](std::map<key_t, long long>& ids, char const* const insert, char const* const select, int columns) -> void {
+        if (ids.size() == 0) {
+            return;
+        }
+        for (auto const query: {insert, select}) {
+            exec_transaction(query, [this, &ids, query, select, columns](sqlite3_stmt* stmt) -> void {
+                for (auto& [key, id]: ids) {
+                    util::sqlite3_bind_string(stmt, 1, std::get<0>(key)); // make, name
+                    if (columns > 1) {
+                        util::sqlite3_bind_string(stmt, 2, std::get<1>(key)); // model
+                    }
+
+                    auto const rc{sqlite3_step(stmt)};
+                    if (query == select && rc == SQLITE_ROW) {
+                        id = sqlite3_column_int64(stmt, 0);
+                    } else if (rc != SQLITE_DONE) {
+                        std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                            #ifdef SHASHIN_DEBUG
+                                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+                            #endif
+                                  << "\n";
+                    }
+                    sqlite3_reset(stmt);
+                }
+            });
+        }
+    }};
+    resolve(cameras, "INSERT OR IGNORE INTO cameras (make, model) VALUES (?, ?);", "SELECT id FROM cameras WHERE make = ? AND model = ?;", 2);
+    resolve(lenses, "INSERT OR IGNORE INTO lenses (make, model) VALUES (?, ?);", "SELECT id FROM lenses WHERE make = ? AND model = ?;", 2);
+    resolve(software, "INSERT OR IGNORE INTO software (name) VALUES (?);", "SELECT id FROM software WHERE name = ?;", 1);
+
+    // 0 stands for a missing value
+    auto const find{[](std::map<key_t, long long> const& ids, key_t const& key) -> long long {
+        auto const it{ids.find(key)};
+        return it != ids.end() ? it->second : 0;
+    }};
+    std::vector<std::tuple<long long, long long, long long>> result;
+    result.reserve(indices.size());
+    for (auto const index: indices) {
+        auto const& info{infos[index]};
+        result.push_back({
+            find(cameras, {std::get<8>(info), std::get<9>(info)}),
+            find(lenses, {std::get<10>(info), std::get<11>(info)}),
+            find(software, {std::get<14>(info), ""})
+        });
+    }
+    return result;
+}
+
+auto Shashin::update_exif(bool all) const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    std::vector<std::string> images;
+    std::vector<char> needs_exif;
+    std::vector<char> needs_xmp;
+    std::vector<decltype(util::exif_info(nullptr, 0))> images_with_exif;
+    std::vector<decltype(util::xmp_info(nullptr, 0))> images_with_xmp;
+    std::vector<char> parsed;
+    std::vector<char> xmp_parsed;
+    std::vector<char> xmp_found;
+    std::vector<std::tuple<std::string, std::string, std::string>> failed;
+    auto const failures{load_failures()};
+
+    // a sidecar is parsed again on its own when only it changed, the EXIF of the image stays
+    exec_transaction(R"sql(
+        SELECT path, (?1 OR exif IS NULL OR exif = 0), (?1 OR xmp = 0) FROM images WHERE ?1 OR exif IS NULL OR exif = 0 OR xmp = 0;
+    )sql", [this, &images, &needs_exif, &needs_xmp, all](sqlite3_stmt* stmt) -> void {
+        sqlite3_bind_int(stmt, 1, all ? 1 : 0);
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            images.push_back(std::string(reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))));
+            needs_exif.push_back(char(sqlite3_column_int(stmt, 1)));
+            needs_xmp.push_back(char(sqlite3_column_int(stmt, 2)));
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    // results are stored by index, workers never touch the same element
+    images_with_exif.resize(images.size());
+    images_with_xmp.resize(images.size());
+    parsed.resize(images.size(), 0);
+    xmp_parsed.resize(images.size(), 0);
+    xmp_found.resize(images.size(), 0);
+
+    util::process_parallel([this, &images, &needs_exif, &needs_xmp, &images_with_exif, &images_with_xmp, &parsed, &xmp_parsed, &xmp_found, &failed, &failures](int worker_number, int lower_bound, int upper_bound) {
+        long long duration_ms{0};
+        auto timestamp_end{util::make_timestamp()};
+        auto timestamp_start{util::make_timestamp()};
+
+        for (auto batch_bound{lower_bound}; batch_bound < upper_bound; batch_bound += m_config.exif_batch_size()) {
+            if (util::interrupted()) {
+                break;
+            }
+            std::vector<size_t> indices;
+            std::vector<fs::path> paths;
+            std::vector<size_t> xmp_indices;
+            std::vector<fs::path> xmp_paths;
+            for (auto i{batch_bound}; i < std::min(upper_bound, batch_bound + m_config.exif_batch_size()); ++i) {
+                //std::cout << images[size_t(i)] << "\n";
+                if (is_quarantined(failures, images[size_t(i)])) {
+                    continue;
+                }
+                auto const path{fs::path(m_config.gallery_path()).append(images[size_t(i)])};
+                if (needs_xmp[size_t(i)]) {
+                    auto xmp_path{util::xmp_sidecar_path(path)};
+                    if (xmp_path.empty()) {
+                        // without a sidecar the defaults are stored, so a removed one clears its values
+                        xmp_parsed[size_t(i)] = 1;
+                    } else {
+                        xmp_indices.push_back(size_t(i));
+                        xmp_paths.push_back(std::move(xmp_path));
+                    }
+                }
+                if (needs_exif[size_t(i)]) {
+                    indices.push_back(size_t(i));
+                    paths.push_back(path);
+                }
+            }
+
+            // sidecars are small, they are read whole
+            auto sidecars{util::read_files(xmp_paths, m_config.io_backend())};
+            for (size_t k{0}; k < xmp_indices.size(); ++k) {
+                auto const& [buffer, error]{sidecars[k]};
+                if (error.size() > 0) {
+                    mtx.lock();
+                    std::cerr << "Error: " << error
+                        #ifdef SHASHIN_DEBUG
+                              << " [" << __FILE__ << ":" << __LINE__ << "]"
+                        #endif
+                              << "\n";
+                    failed.push_back({images[xmp_indices[k]], "xmp", error});
+                    mtx.unlock();
+                    continue;
+                }
+                images_with_xmp[xmp_indices[k]] = util::xmp_info(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+                xmp_parsed[xmp_indices[k]] = 1;
+                xmp_found[xmp_indices[k]] = 1;
+            }
+
+            // only the head of a JPEG is read, the EXIF segment has to be at its start; the EXIF and GPS IFD of a RAW file
+            // can be anywhere in it, so its IFDs are walked and only they are read
+            std::vector<fs::path> jpeg_paths;
+            for (auto const& path: paths) {
+                if (!util::is_raw(path)) {
+                    jpeg_paths.push_back(path);
+                }
+            }
+            auto heads{util::read_files(jpeg_paths, m_config.io_backend(), m_config.exif_header_size())};
+            std::vector<std::tuple<std::vector<unsigned char>, std::string>> headers;
+            for (size_t k{0}, j{0}; k < paths.size(); ++k) {
+                headers.push_back(util::is_raw(paths[k]) ? util::raw_exif(paths[k]) : std::move(heads[j++]));
+            }
+            for (size_t k{0}; k < indices.size(); ++k) {
+                auto& [buffer, error]{headers[k]};
+                auto const& path{images[indices[k]]};
+                if (error.size() > 0) {
+                    mtx.lock();
+                    std::cerr << "Error: " << error
+                        #ifdef SHASHIN_DEBUG
+                              << " [" << __FILE__ << ":" << __LINE__ << "]"
+                        #endif
+                              << "\n";
+                    failed.push_back({path, "exif", error});
+                    mtx.unlock();
+                    continue;
+                }
+
+                // easyexif rejects data that does not end with an EOI marker, so a cut off head gets one
+                if (!util::is_raw(paths[k]) && buffer.size() == m_config.exif_header_size()) {
+                    buffer.push_back(0xFF);
+                    buffer.push_back(0xD9);
+                }
+                images_with_exif[indices[k]] = util::exif_info(buffer.data(), buffer.size());
+                parsed[indices[k]] = 1;
+            }
+        }
+
+        timestamp_end = util::make_timestamp();
+        duration_ms = util::time_between(timestamp_start, timestamp_end);
+
+#if SHASHIN_DEBUG
+        mtx.lock();
+        std::cout << "worker_number: " << std::setw(1) << worker_number
+                  << "    "
+                  << "lower_bound: " << std::setw(4) << lower_bound
+                  << "    "
+                  << "upper_bound: " << std::setw(4) << upper_bound
+                  << "    "
+                  << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms"
+                  << "\n" << std::flush;
+        mtx.unlock();
+#endif
+    }, int(images.size()));
+
+    std::vector<size_t> indices;
+    for (size_t index{0}; index < images.size(); ++index) {
+        if (parsed[index]) {
+            indices.push_back(index);
+        }
+    }
+    auto const ids{dictionary_ids(images_with_exif, indices)};
+
+    exec_transaction(R"sql(
+        UPDATE images SET
+            captured_at = ?,
+            fstop = ?,
+            exposure_time = ?,
+            iso_speed = ?,
+            exposure_bias = ?,
+            flash = ?,
+            metering_mode = ?,
+            focal_length = ?,
+            focal_length_35mm = ?,
+            camera_id = ?,
+            lens_id = ?,
+            software_id = ?,
+            description = ?,
+            copyright = ?,
+            gps_latitude = ?,
+            gps_longitude = ?,
+            gps_altitude = ?,
+
+            exif = ?,
+
+            generation = ?,
+            updated_at = ?
+        WHERE path = ?;
+    )sql", [this, &images, &images_with_exif, &indices, &ids](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (size_t k{0}; k < indices.size(); ++k) {
+            auto const index{indices[k]};
+            auto const& path{images[index]};
+
+            i = 0;
+            bind_exif(stmt, i, images_with_exif[index], ids[k]);
+            sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+
+    std::vector<std::tuple<std::string, bool, decltype(util::xmp_info(nullptr, 0))>> sidecars;
+    for (size_t index{0}; index < images.size(); ++index) {
+        if (xmp_parsed[index]) {
+            sidecars.push_back({images[index], xmp_found[index] != 0, std::move(images_with_xmp[index])});
+        }
+    }
+    store_sidecars(sidecars);
+
+    insert_failures(failed);
+    delete_failures([&images, &needs_exif, &needs_xmp, &parsed, &xmp_parsed, &failures]() -> std::vector<std::string> {
+        std::vector<std::string> recovered;
+        for (size_t index{0}; index < images.size(); ++index) {
+            if ((!needs_exif[index] || parsed[index]) && (!needs_xmp[index] || xmp_parsed[index]) && failures.count(images[index]) > 0) {
+                recovered.push_back(images[index]);
+            }
+        }
+        return recovered;
+    }());
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "update exif" << "\n" << std::flush;
+}
+
+auto Shashin::store_sidecars(std::vector<std::tuple<std::string, bool, std::tuple<int, std::string, int, std::string, std::vector<std::string>>>> const& sidecars) const -> void {
+    if (sidecars.empty()) {
+        return;
+    }
+
+    exec_transaction(R"sql(
+        UPDATE images SET
+            rating = ?,
+            label = ?,
+            pick = ?,
+            caption = ?,
+
+            xmp = ?,
+
+            generation = ?,
+            updated_at = ?
+        WHERE path = ?;
+    )sql", [this, &sidecars](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& [path, found, info]: sidecars) {
+            auto const& [rating, label, pick, caption, keywords]{info};
+
+            i = 0;
+            sqlite3_bind_int(stmt, ++i, rating); // rating
+            util::sqlite3_bind_string(stmt, ++i, label); // label
+            sqlite3_bind_int(stmt, ++i, pick); // pick
+            util::sqlite3_bind_string(stmt, ++i, caption); // caption
+            sqlite3_bind_int(stmt, ++i, found ? 1 : 2); // xmp
+            sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+
+    exec_transaction(R"sql(
+        INSERT OR IGNORE INTO keywords (name) VALUES (?);
+    )sql", [&sidecars](sqlite3_stmt* stmt) -> void {
+        for (auto const& sidecar: sidecars) {
+            for (auto const& keyword: std::get<4>(std::get<2>(sidecar))) {
+                util::sqlite3_bind_string(stmt, 1, keyword); // name
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        }
+    });
+
+    // the keywords of an image are replaced as a whole, the sidecar is the only source
+    exec_transaction(R"sql(
+        DELETE FROM image_keywords WHERE image_id = (SELECT id FROM images WHERE path = ?);
+    )sql", [&sidecars](sqlite3_stmt* stmt) -> void {
+        for (auto const& sidecar: sidecars) {
+            util::sqlite3_bind_string(stmt, 1, std::get<0>(sidecar)); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+
+    exec_transaction(R"sql(
+        INSERT OR IGNORE INTO image_keywords (image_id, keyword_id)
+        SELECT i.id, k.id FROM images i, keywords k WHERE i.path = ? AND k.name = ?;
+    )sql", [&sidecars](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& sidecar: sidecars) {
+            for (auto const& keyword: std::get<4>(std::get<2>(sidecar))) {
+                i = 0;
+                util::sqlite3_bind_string(stmt, ++i, std::get<0>(sidecar)); // path
+                util::sqlite3_bind_string(stmt, ++i, keyword); // name
+
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        }
+    });
+
+    auto const found{std::count_if(sidecars.begin(), sidecars.end(), [](auto const& sidecar) -> bool {
+        return std::get<1>(sidecar);
+    })};
+    std::cout << std::setfill(' ') << std::setw(8) << found << " " << "xmp" << "  " << "sidecars read" << "\n" << std::flush;
+}
+
+// built-in templates by name, <templates_dir>/<name>.html in the project replaces one
+static std::unordered_map<std::string, char const*> const templates{{
+    {"list", R"html(<style>
+    * {
+        font-size: 12px;
+    }
+    td {
+        border: 1px solid grey;
+        padding: 2px 8px;
+    }
+</style>
+<table>
+<tr>
+<td><b>depth</b></td>
+<td><b>path</b></td>
+<td><b>created_at</b></td>
+<td><b>updated_at</b></td>
+<td><b>name</b></td>
+<td><b>url</b></td>
+<td><b>hash</b></td>
+<td><b>captured_at</b></td>
+<td><b>title</b></td>
+<td><b>event</b></td>
+<td><b>location</b></td>
+<td><b>city</b></td>
+<td><b>country</b></td>
+</tr>
+{{#nodes}}
+<tr>
+<td><nobr>{{depth}}</nobr></td>
+<td><nobr>{{path}}</nobr></td>
+<td><nobr>{{created_at}}</nobr></td>
+<td><nobr>{{updated_at}}</nobr></td>
+<td><nobr>{{name}}</nobr></td>
+<td><nobr>{{url}}</nobr></td>
+<td><nobr>{{hash}}</nobr></td>
+<td><nobr>{{captured_at}}</nobr></td>
+<td><nobr>{{title}}</nobr></td>
+<td><nobr>{{event}}</nobr></td>
+<td><nobr>{{location}}</nobr></td>
+<td><nobr>{{city}}</nobr></td>
+<td><nobr>{{country}}</nobr></td>
+</tr>
+{{/nodes}}
+</table>
+<table>
+<tr>
+<td><b>path</b></td>
+<td><b>hash</b></td>
+<td><b>small</b></td>
+<td><b>medium</b></td>
+<td><b>large</b></td>
+<td><b>created_at</b></td>
+<td><b>updated_at</b></td>
+<td><b>captured_at</b></td>
+<td><b>fstop</b></td>
+<td><b>exposure_time</b></td>
+<td><b>iso_speed</b></td>
+<td><b>exposure_bias</b></td>
+<td><b>flash</b></td>
+<td><b>metering_mode</b></td>
+<td><b>focal_length</b></td>
+<td><b>focal_length_35mm</b></td>
+<td><b>camera_make</b></td>
+<td><b>camera_model</b></td>
+<td><b>lens_make</b></td>
+<td><b>lens_model</b></td>
+<td><b>software</b></td>
+<td><b>description</b></td>
+<td><b>copyright</b></td>
+<td><b>gps</b></td>
+</tr>
+{{#images}}
+<tr>
+<td><nobr>{{path}}</nobr></td>
+<td><nobr>{{hash}}</nobr></td>
+<td><nobr><a href="{{small_path}}">{{small}}</a></nobr></td>
+<td><nobr><a href="{{medium_path}}">{{medium}}</a></nobr></td>
+<td><nobr><a href="{{large_path}}">{{large}}</a></nobr></td>
+<td><nobr>{{created_at}}</nobr></td>
+<td><nobr>{{updated_at}}</nobr></td>
+<td><nobr>{{captured_at}}</nobr></td>
+<td><nobr>{{fstop}}</nobr></td>
+<td><nobr>{{exposure_time}}</nobr></td>
+<td><nobr>{{iso_speed}}</nobr></td>
+<td><nobr>{{exposure_bias}}</nobr></td>
+<td><nobr>{{flash}}</nobr></td>
+<td><nobr>{{metering_mode}}</nobr></td>
+<td><nobr>{{focal_length}}</nobr></td>
+<td><nobr>{{focal_length_35mm}}</nobr></td>
+<td><nobr>{{camera_make}}</nobr></td>
+<td><nobr>{{camera_model}}</nobr></td>
+<td><nobr>{{lens_make}}</nobr></td>
+<td><nobr>{{lens_model}}</nobr></td>
+<td><nobr>{{software}}</nobr></td>
+<td><nobr>{{description}}</nobr></td>
+<td><nobr>{{copyright}}</nobr></td>
+<td><nobr>{{gps}}</nobr></td>
+</tr>
+{{/images}}
+</table>
+)html"},
+    {"gallery", R"html(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<meta name="viewport" content="width=device-width, initial-scale=1">
+<title>{{title}}{{^title}}{{name}}{{/title}}</title>
+<style>
+    body { font-family: sans-serif; margin: 16px; }
+    .images { display: flex; flex-wrap: wrap; gap: 4px; }
+    .images img { display: block; }
+</style>
+</head>
+<body>
+{{#parent}}<p><a href="{{page}}">{{title}}{{^title}}{{name}}{{/title}}</a></p>{{/parent}}
+<h1>{{title}}{{^title}}{{name}}{{/title}}</h1>
+<p>{{event}} {{location}} {{city}} {{country}} {{captured_at}}</p>
+<ul>
+{{#children}}
+<li><a href="{{page}}">{{title}}{{^title}}{{name}}{{/title}}</a></li>
+{{/children}}
+</ul>
+<div class="images">
+{{#images}}
+<a href="{{page}}"><img src="{{small_url}}" width="{{small_width}}" height="{{small_height}}" alt="{{name}}" loading="lazy" style="background-color: {{dominant_color}}"></a>
+{{/images}}
+</div>
+</body>
+</html>
+)html"},
+    {"image", R"html(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<meta name="viewport" content="width=device-width, initial-scale=1">
+<title>{{image.name}} - {{node.title}}{{^node.title}}{{node.name}}{{/node.title}}</title>
+<style>
+    body { font-family: sans-serif; margin: 16px; }
+    img { max-width: 100%; height: auto; }
+</style>
+</head>
+<body>
+<p>
+<a href="{{node.page}}">{{node.title}}{{^node.title}}{{node.name}}{{/node.title}}</a>
+{{#prev}}<a href="{{page}}" rel="prev">previous</a>{{/prev}}
+{{#next}}<a href="{{page}}" rel="next">next</a>{{/next}}
+</p>
+{{#image}}
+<img src="{{medium_url}}" srcset="{{medium_url}} {{medium_width}}w, {{large_url}} {{large_width}}w" sizes="100vw" width="{{medium_width}}" height="{{medium_height}}" alt="{{name}}" style="background-color: {{dominant_color}}">
+<p>{{description}}</p>
+<p>{{captured_at}} {{camera_make}} {{camera_model}} {{lens_model}} {{focal_length}} {{fstop}} {{exposure_time}} {{iso_speed}}</p>
+<p>{{copyright}}</p>
+{{/image}}
+</body>
+</html>
+)html"},
+}};
+
+// the template and a signature of its source, so pages are rendered again once it is edited
+auto Shashin::load_template(std::string const& name) const -> std::tuple<util::Template, std::string> {
+    std::string source;
+    auto const path{fs::path{m_config.project_path()}.append(m_config.templates_dir()).append(name + ".html")};
+    if (fs::exists(path)) {
+        std::ifstream ifs{path, std::ios::binary};
+        source.assign(std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{});
+    } else {
+        source = templates.at(name);
+    }
+    return {util::Template{source}, util::hash_to_hex_string(util::string_to_hash(source))};
+}
+
+auto Shashin::dump_list_html() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    auto context{nlohmann::json::object()};
+
+    // nodes
+    context["nodes"] = nlohmann::json::array();
+    exec_transaction(R"sql(
+        SELECT
+            depth,
+            path,
+            created_at,
+            updated_at,
+            name,
+            url,
+            hash,
+            captured_at,
+            title,
+            event,
+            location,
+            city,
+            country
+        FROM nodes
+        ORDER BY depth, path, captured_at, title;
+    )sql", [this, &context](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto depth{sqlite3_column_int(stmt, ++i)};
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto event{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto location{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto city{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto country{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+            context["nodes"].push_back({
+                {"depth", depth},
+                {"path", path},
+                {"created_at", created_at},
+                {"updated_at", updated_at},
+                {"name", name},
+                {"url", url},
+                {"hash", hash},
+                {"captured_at", captured_at},
+                {"title", title},
+                {"event", event},
+                {"location", location},
+                {"city", city},
+                {"country", country},
+            });
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    // images
+    context["images"] = nlohmann::json::array();
+    auto const query{std::string{R"sql(
+        SELECT
+            i.path,
+            n.hash,
+            i.small,
+            i.medium,
+            i.large,
+            i.created_at,
+            i.updated_at,)sql"} + exif_select + R"sql(
+        FROM images i INNER JOIN nodes n ON i.parent = n.path)sql" + exif_joins + R"sql(
+        ORDER BY i.parent, i.captured_at;
+    )sql"};
+    exec_transaction(query.c_str(), [this, &context](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        auto const extension{".jpg"};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto [captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, focal_length, focal_length_35mm, camera_make, camera_model, lens_make, lens_model, software, description, copyright, gps]{column_exif_strings(stmt, i)};
+
+            auto const dst_path_small{fs::path{m_config.cache_path()}.append("small").append(hash).append(small + extension)};
+            auto const dst_path_medium{fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension)};
+            auto const dst_path_large{fs::path{m_config.cache_path()}.append("large").append(hash).append(large + extension)};
+
+            fstop = fstop.size() > 0 ? "f/" + fstop : fstop;
+            exposure_bias = exposure_bias.size() > 0 ? exposure_bias + " EV" : exposure_bias;
+            focal_length = focal_length.size() > 0 ? focal_length + " mm" : focal_length;
+            focal_length_35mm = focal_length_35mm.size() > 0 ? focal_length_35mm + " mm" : focal_length_35mm;
+
+            context["images"].push_back({
+                {"path", path},
+                {"hash", hash},
+                {"small", small},
+                {"medium", medium},
+                {"large", large},
+                {"small_path", dst_path_small.string()},
+                {"medium_path", dst_path_medium.string()},
+                {"large_path", dst_path_large.string()},
+                {"created_at", created_at},
+                {"updated_at", updated_at},
+                {"captured_at", captured_at},
+                {"fstop", fstop},
+                {"exposure_time", exposure_time},
+                {"iso_speed", iso_speed},
+                {"exposure_bias", exposure_bias},
+                {"flash", flash},
+                {"metering_mode", metering_mode},
+                {"focal_length", focal_length},
+                {"focal_length_35mm", focal_length_35mm},
+                {"camera_make", camera_make},
+                {"camera_model", camera_model},
+                {"lens_make", lens_make},
+                {"lens_model", lens_model},
+                {"software", software},
+                {"description", description},
+                {"copyright", copyright},
+                {"gps", gps},
+            });
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    try {
+        auto const [list_template, template_signature]{load_template("list")};
+        (void)template_signature;
+        util::dump_to_file(fs::path{m_config.shashin_path()}.append("list.html"), list_template.render(context));
+    } catch (std::exception const& e) {
+        std::cerr << "Error: " << e.what()
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    }
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "dump list html" << "\n" << std::flush;
+}
+
+// RAW files are read as their embedded JPEG preview, so everything after the read sees a JPEG
+auto Shashin::read_sources(std::vector<fs::path> const& paths) const -> std::vector<std::tuple<std::vector<unsigned char>, std::string>> {
+    std::vector<std::tuple<fs::path, std::size_t, std::size_t>> ranges;
+    std::vector<int> orientations(paths.size(), 0);
+    std::vector<std::string> errors(paths.size());
+    for (size_t k{0}; k < paths.size(); ++k) {
+        if (!util::is_raw(paths[k])) {
+            ranges.push_back({paths[k], 0, 0});
+            continue;
+        }
+        auto const [offset, length, orientation, error]{util::raw_preview(paths[k])};
+        ranges.push_back({paths[k], offset, length});
+        orientations[k] = orientation;
+        errors[k] = error;
+    }
+
+    auto sources{util::read_file_ranges(ranges, m_config.io_backend())};
+    for (size_t k{0}; k < paths.size(); ++k) {
+        auto& [buffer, error]{sources[k]};
+        if (errors[k].size() > 0) {
+            std::vector<unsigned char>().swap(buffer);
+            error = errors[k];
+        } else if (error.empty() && orientations[k] > 0) {
+            util::orient_preview(buffer, orientations[k]);
+        }
+    }
+    return sources;
+}
+
+// all images, or only those of paths, e.g. the ones serve needs next
+auto Shashin::process_images(std::vector<std::string> const& paths) const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, int, int, int, int, int, int, int, int>> images;
+    std::vector<char> needs_exif;
+    std::vector<std::tuple<std::string, std::string, std::string>> placeholders;
+    // medium and large tier: 0 encoded, 1 the source bytes without metadata, 2 the same file as the tier below,
+    // 3 the same file as the tier of the image it duplicates
+    std::vector<std::tuple<int, int>> aliases;
+    // JPEG quality and bytes of the small, medium and large tier
+    std::vector<std::tuple<int, long long, int, long long, int, long long>> encodings;
+    // perceptual hash if there is one yet and the path of the image whose tiers are linked
+    std::vector<std::tuple<bool, std::uint64_t>> phashes;
+    std::vector<std::string> duplicates;
+
+    // nodes named in the priority file come first, together with the nodes below them
+    auto const priorities{load_priorities()};
+    std::string query;
+    if (priorities.size() > 0) {
+        query += "WITH priorities (rank, path) AS (VALUES (?, ?)";
+        for (size_t k{1}; k < priorities.size(); ++k) {
+            query += ",(?, ?)";
+        }
+        query += ")\n";
+    }
+    query += R"sql(
+        SELECT
+            i.path,
+            n.hash,
+            i.small,
+            i.medium,
+            i.large,
+            i.width,
+            i.height,
+            i.large_width,
+            i.large_height,
+            i.medium_width,
+            i.medium_height,
+            i.small_width,
+            i.small_height,
+            i.exif,
+            i.blurhash,
+            i.lqip,
+            i.dominant_color,
+            i.medium_alias,
+            i.large_alias,
+            i.small_quality,
+            i.small_bytes,
+            i.medium_quality,
+            i.medium_bytes,
+            i.large_quality,
+            i.large_bytes,
+            i.phash,
+            i.duplicate_of
+        FROM images i INNER JOIN nodes n ON i.parent = n.path
+    )sql";
+    if (paths.size() > 0) {
+        query += "WHERE i.path IN (?";
+        for (size_t k{1}; k < paths.size(); ++k) {
+            query += ",?";
+        }
+        query += ")\n";
+    }
+    query += "ORDER BY ";
+    if (priorities.size() > 0) {
+        query += "coalesce((SELECT min(p.rank) FROM priorities p WHERE i.parent = p.path OR substr(i.parent, 1, length(p.path) + 1) = p.path || '/'), "
+            + std::to_string(priorities.size()) + "), ";
+    }
+    // the nodes of the latest run are the new events, which should go live before the backlog
+    if (m_config.newest_first()) {
+        query += "n.created_at DESC, n.captured_at DESC, ";
+    }
+    query += "i.parent, i.captured_at;";
+    exec_transaction(query.c_str(), [this, &paths, &priorities, &images, &needs_exif, &placeholders, &aliases, &encodings, &phashes, &duplicates](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (size_t k{0}; k < priorities.size(); ++k) {
+            sqlite3_bind_int(stmt, ++i, int(k)); // rank
+            util::sqlite3_bind_string(stmt, ++i, priorities[k]); // path
+        }
+        for (auto const& path: paths) {
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+        }
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto width{sqlite3_column_int(stmt, ++i)};
+            auto height{sqlite3_column_int(stmt, ++i)};
+            auto large_width{sqlite3_column_int(stmt, ++i)};
+            auto large_height{sqlite3_column_int(stmt, ++i)};
+            auto medium_width{sqlite3_column_int(stmt, ++i)};
+            auto medium_height{sqlite3_column_int(stmt, ++i)};
+            auto small_width{sqlite3_column_int(stmt, ++i)};
+            auto small_height{sqlite3_column_int(stmt, ++i)};
+            images.push_back({path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height});
+            needs_exif.push_back(sqlite3_column_int(stmt, ++i) == 0);
+            auto blurhash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto lqip{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto dominant_color{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            placeholders.push_back({blurhash, lqip, dominant_color});
+            auto medium_alias{sqlite3_column_int(stmt, ++i)};
+            auto large_alias{sqlite3_column_int(stmt, ++i)};
+            aliases.push_back({medium_alias, large_alias});
+            auto small_quality{sqlite3_column_int(stmt, ++i)};
+            auto small_bytes{sqlite3_column_int64(stmt, ++i)};
+            auto medium_quality{sqlite3_column_int(stmt, ++i)};
+            auto medium_bytes{sqlite3_column_int64(stmt, ++i)};
+            auto large_quality{sqlite3_column_int(stmt, ++i)};
+            auto large_bytes{sqlite3_column_int64(stmt, ++i)};
+            encodings.push_back({small_quality, small_bytes, medium_quality, medium_bytes, large_quality, large_bytes});
+            auto const hashed{sqlite3_column_type(stmt, ++i) != SQLITE_NULL};
+            phashes.push_back({hashed, std::uint64_t(sqlite3_column_int64(stmt, i))});
+            duplicates.push_back(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))});
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    util::install_interrupt_handler();
+    auto const failures{load_failures()};
+
+    // new images get their EXIF parsed from the buffer that is decoded anyway, so each file is read only once
+    std::vector<decltype(util::exif_info(nullptr, 0))> exifs(images.size());
+    std::vector<char> exif_parsed(images.size(), 0);
+
+    // a node is complete once each of its images was processed or skipped, then a full run exports the nodes completed so far;
+    // a node whose images were all done before this run does not count
+    std::unordered_map<std::string, int> remaining;
+    for (auto const& image: images) {
+        ++remaining[std::get<1>(image)];
+    }
+    auto const partial_export{paths.empty() && m_config.partial_export_interval() > 0};
+
+    // workers hand finished images over to a single writer which commits them in batches,
+    // so an interrupted run loses at most one batch and the next run continues from there;
+    // skipped images are handed over unprocessed, a non-empty stage marks an image that failed there together with the error
+    util::Queue<std::tuple<size_t, bool, std::string, std::string>> finished;
+    std::thread writer([this, &images, &finished, &failures, &exifs, &exif_parsed, &placeholders, &aliases, &encodings, &phashes, &duplicates, &remaining, partial_export]() {
+        std::vector<size_t> batch;
+        std::vector<size_t> batch_with_exif;
+        std::vector<std::tuple<std::string, std::string, std::string>> failed;
+        auto checkpoint{util::make_timestamp()};
+        auto snapshot{util::make_timestamp()};
+        auto exported{util::make_timestamp()};
+        auto completed{false};
+        // images processed by this run, by node hash
+        std::unordered_map<std::string, std::vector<std::string>> processed_images;
+
+        auto const commit{[this, &images, &batch, &batch_with_exif, &failed, &failures, &exifs, &placeholders, &aliases, &encodings, &phashes, &duplicates, &checkpoint]() -> void {
+            // EXIF and sizes of an image go into the same row update
+            if (batch_with_exif.size() > 0) {
+                auto const ids{dictionary_ids(exifs, batch_with_exif)};
+                exec_transaction(R"sql(
+                    UPDATE images SET
+                        captured_at = ?,
+                        fstop = ?,
+                        exposure_time = ?,
+                        iso_speed = ?,
+                        exposure_bias = ?,
+                        flash = ?,
+                        metering_mode = ?,
+                        focal_length = ?,
+                        focal_length_35mm = ?,
+                        camera_id = ?,
+                        lens_id = ?,
+                        software_id = ?,
+                        description = ?,
+                        copyright = ?,
+                        gps_latitude = ?,
+                        gps_longitude = ?,
+                        gps_altitude = ?,
+                        exif = ?,
+
+                        width = ?,
+                        height = ?,
+                        large_width = ?,
+                        large_height = ?,
+                        medium_width = ?,
+                        medium_height = ?,
+                        small_width = ?,
+                        small_height = ?,
+
+                        blurhash = ?,
+                        lqip = ?,
+                        dominant_color = ?,
+
+                        medium_alias = ?,
+                        large_alias = ?,
+                        small_quality = ?,
+                        small_bytes = ?,
+                        medium_quality = ?,
+                        medium_bytes = ?,
+                        large_quality = ?,
+                        large_bytes = ?,
+                        phash = ?,
+                        duplicate_of = ?,
+
+                        generation = ?,
+                        updated_at = ?
+                    WHERE path = ?;
+                )sql", [this, &images, &batch_with_exif, &exifs, &ids, &placeholders, &aliases, &encodings, &phashes, &duplicates](sqlite3_stmt* stmt) -> void {
+                    auto i{0};
+                    for (size_t k{0}; k < batch_with_exif.size(); ++k) {
+                        auto const index{batch_with_exif[k]};
+                        auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{images[index]};
+
+                        i = 0;
+                        bind_exif(stmt, i, exifs[index], ids[k]);
+                        util::sqlite3_bind_int_or_null(stmt, ++i, width); // width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, height); // height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, large_width); // large_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, large_height); // large_height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, medium_width); // medium_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, medium_height); // medium_height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, small_width); // small_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, small_height); // small_height
+
+                        auto const& [blurhash, lqip, dominant_color]{placeholders[index]};
+                        util::sqlite3_bind_string(stmt, ++i, blurhash); // blurhash
+                        util::sqlite3_bind_string(stmt, ++i, lqip); // lqip
+                        util::sqlite3_bind_string(stmt, ++i, dominant_color); // dominant_color
+
+                        auto const& [medium_alias, large_alias]{aliases[index]};
+                        sqlite3_bind_int(stmt, ++i, medium_alias); // medium_alias
+                        sqlite3_bind_int(stmt, ++i, large_alias); // large_alias
+                        auto const& [small_quality, small_bytes, medium_quality, medium_bytes, large_quality, large_bytes]{encodings[index]};
+                        sqlite3_bind_int(stmt, ++i, small_quality); // small_quality
+                        sqlite3_bind_int64(stmt, ++i, small_bytes); // small_bytes
+                        sqlite3_bind_int(stmt, ++i, medium_quality); // medium_quality
+                        sqlite3_bind_int64(stmt, ++i, medium_bytes); // medium_bytes
+                        sqlite3_bind_int(stmt, ++i, large_quality); // large_quality
+                        sqlite3_bind_int64(stmt, ++i, large_bytes); // large_bytes
+                        auto const& [hashed, phash]{phashes[index]};
+                        if (hashed) {
+                            sqlite3_bind_int64(stmt, ++i, (long long)(phash)); // phash
+                        } else {
+                            sqlite3_bind_null(stmt, ++i); // phash
+                        }
+                        util::sqlite3_bind_string(stmt, ++i, duplicates[index]); // duplicate_of
+
+                        sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                        util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                        util::sqlite3_bind_string(stmt, ++i, path); // path
+
+                        sqlite3_step(stmt);
+                        sqlite3_reset(stmt);
+                    }
+                });
+            }
+            if (batch.size() > 0) {
+                exec_transaction(R"sql(
+                    UPDATE images SET
+                        width = ?,
+                        height = ?,
+                        large_width = ?,
+                        large_height = ?,
+                        medium_width = ?,
+                        medium_height = ?,
+                        small_width = ?,
+                        small_height = ?,
+
+                        blurhash = ?,
+                        lqip = ?,
+                        dominant_color = ?,
+
+                        medium_alias = ?,
+                        large_alias = ?,
+                        small_quality = ?,
+                        small_bytes = ?,
+                        medium_quality = ?,
+                        medium_bytes = ?,
+                        large_quality = ?,
+                        large_bytes = ?,
+                        phash = ?,
+                        duplicate_of = ?,
+
+                        generation = ?,
+                        updated_at = ?
+                    WHERE path = ?;
+                )sql", [this, &images, &batch, &placeholders, &aliases, &encodings, &phashes, &duplicates](sqlite3_stmt* stmt) -> void {
+                    auto i{0};
+                    for (auto const index: batch) {
+                        auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{images[index]};
+
+                        i = 0;
+                        util::sqlite3_bind_int_or_null(stmt, ++i, width); // width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, height); // height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, large_width); // large_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, large_height); // large_height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, medium_width); // medium_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, medium_height); // medium_height
+                        util::sqlite3_bind_int_or_null(stmt, ++i, small_width); // small_width
+                        util::sqlite3_bind_int_or_null(stmt, ++i, small_height); // small_height
+
+                        auto const& [blurhash, lqip, dominant_color]{placeholders[index]};
+                        util::sqlite3_bind_string(stmt, ++i, blurhash); // blurhash
+                        util::sqlite3_bind_string(stmt, ++i, lqip); // lqip
+                        util::sqlite3_bind_string(stmt, ++i, dominant_color); // dominant_color
+
+                        auto const& [medium_alias, large_alias]{aliases[index]};
+                        sqlite3_bind_int(stmt, ++i, medium_alias); // medium_alias
+                        sqlite3_bind_int(stmt, ++i, large_alias); // large_alias
+                        auto const& [small_quality, small_bytes, medium_quality, medium_bytes, large_quality, large_bytes]{encodings[index]};
+                        sqlite3_bind_int(stmt, ++i, small_quality); // small_quality
+                        sqlite3_bind_int64(stmt, ++i, small_bytes); // small_bytes
+                        sqlite3_bind_int(stmt, ++i, medium_quality); // medium_quality
+                        sqlite3_bind_int64(stmt, ++i, medium_bytes); // medium_bytes
+                        sqlite3_bind_int(stmt, ++i, large_quality); // large_quality
+                        sqlite3_bind_int64(stmt, ++i, large_bytes); // large_bytes
+                        auto const& [hashed, phash]{phashes[index]};
+                        if (hashed) {
+                            sqlite3_bind_int64(stmt, ++i, (long long)(phash)); // phash
+                        } else {
+                            sqlite3_bind_null(stmt, ++i); // phash
+                        }
+                        util::sqlite3_bind_string(stmt, ++i, duplicates[index]); // duplicate_of
+
+                        sqlite3_bind_int64(stmt, ++i, m_generation); // generation
+                        util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
+                        util::sqlite3_bind_string(stmt, ++i, path); // path
+
+                        sqlite3_step(stmt);
+                        sqlite3_reset(stmt);
+                    }
+                });
+
+            }
+
+            std::vector<std::string> recovered;
+            for (auto const& indices: {batch, batch_with_exif}) {
+                for (auto const index: indices) {
+                    if (failures.count(std::get<0>(images[index])) > 0) {
+                        recovered.push_back(std::get<0>(images[index]));
+                    }
+                }
+            }
+            delete_failures(recovered);
+            insert_failures(failed);
+            batch.clear();
+            batch_with_exif.clear();
+            failed.clear();
+            checkpoint = util::make_timestamp();
+        }};
+
+        std::tuple<size_t, bool, std::string, std::string> result;
+        while (finished.pop(result)) {
+            auto const& [index, processed, stage, error]{result};
+            if (processed && stage.size() > 0) {
+                failed.push_back({std::get<0>(images[index]), stage, error});
+            } else if (processed && exif_parsed[index]) {
+                batch_with_exif.push_back(index);
+            } else if (processed) {
+                batch.push_back(index);
+            }
+            auto const& node{std::get<1>(images[index])};
+            if (processed) {
+                processed_images[node].push_back(std::get<0>(images[index]));
+            }
+            if (--remaining[node] == 0 && processed_images.count(node) > 0) {
+                completed = true;
+            }
+            if (int(batch.size() + batch_with_exif.size() + failed.size()) >= m_config.checkpoint_size()
+                || util::time_between<std::chrono::seconds>(checkpoint, util::make_timestamp()) >= m_config.checkpoint_interval()) {
+                commit();
+            }
+
+            // the exports rewrite everything, so completed nodes are published together at most once per interval;
+            // the writer is the only one using the database while the workers run
+            if (partial_export && completed && util::time_between<std::chrono::seconds>(exported, util::make_timestamp()) >= m_config.partial_export_interval()) {
+                commit();
+                exec_query("DELETE FROM unfinished_images;");
+                exec_transaction(R"sql(
+                    INSERT INTO unfinished_images (path) VALUES (?);
+                )sql", [&processed_images, &remaining](sqlite3_stmt* stmt) -> void {
+                    for (auto const& [node, paths]: processed_images) {
+                        if (remaining.at(node) == 0) {
+                            continue;
+                        }
+                        for (auto const& path: paths) {
+                            util::sqlite3_bind_string(stmt, 1, path); // path
+
+                            sqlite3_step(stmt);
+                            sqlite3_reset(stmt);
+                        }
+                    }
+                });
+                create_gallery_files();
+                create_pages();
+                compress_outputs();
+                exported = util::make_timestamp();
+                completed = false;
+            }
+            if (m_in_memory && util::time_between<std::chrono::seconds>(snapshot, util::make_timestamp()) >= m_config.snapshot_interval()) {
+                save_database();
+                snapshot = util::make_timestamp();
+            }
+        }
+        commit();
+    });
+
+    // each worker reads a batch of sources at once, so with io_uring several reads per worker are in flight;
+    // encoded tiers of the batch are written together in the same way
+    std::atomic<int> percent{0};
+    // tier file names are salted hashes of the source path, a tier written under a new name is immutable;
+    // one rendered again for a changed source replaces the pixels under the same name and is recorded as mutable
+    std::vector<std::tuple<std::string, long long, std::string, bool>> manifest;
+
+    // images whose medium and large tier are done, by perceptual hash; an image is added once its own tiers are written,
+    // so near duplicates can link to them
+    util::HammingIndex duplicate_index{m_config.duplicate_distance()};
+    std::vector<size_t> duplicate_owners;
+    std::mutex duplicate_mtx;
+    auto const is_original{[&images, &phashes, &duplicates](size_t index) -> bool {
+        auto const& image{images[index]};
+        return std::get<0>(phashes[index]) && duplicates[index].empty()
+            && std::get<7>(image) > 0 && std::get<8>(image) > 0 && std::get<9>(image) > 0 && std::get<10>(image) > 0;
+    }};
+    if (m_config.skip_duplicates()) {
+        for (size_t index{0}; index < images.size(); ++index) {
+            if (is_original(index)) {
+                duplicate_index.insert(std::get<1>(phashes[index]));
+                duplicate_owners.push_back(index);
+            }
+        }
+    }
+
+    util::process_parallel_dynamic([this, &paths, &images, &finished, &failures, &percent, &needs_exif, &exifs, &exif_parsed, &placeholders, &aliases, &encodings, &phashes, &duplicates, &duplicate_index, &duplicate_owners, &duplicate_mtx, &is_original, &manifest](int worker_number, int lower_bound, int upper_bound) {
+        (void)worker_number;
+        auto const extension{".jpg"};
+        auto encoder{util::make_encoder(m_config.encoder_backend())};
+        auto const encode{[this, &encoder](cv::Mat const& mat, util::EncoderSettings settings) -> std::tuple<std::vector<unsigned char>, int> {
+            if (m_config.quality_search()) {
+                return util::encode_jpeg_targeted(*encoder, mat, settings, m_config.quality_target_ssim(), m_config.quality_min(), m_config.quality_max(), m_config.quality_crop_size(), m_config.quality_crop_count());
+            }
+            settings.quality = m_config.jpeg_quality();
+            return {encoder->encode(mat, settings), settings.quality};
+        }};
+
+        std::vector<std::tuple<size_t, bool, bool, bool, bool>> pending;
+        std::vector<fs::path> src_paths;
+        for (auto index{lower_bound}; index < upper_bound; ++index) {
+            if (util::interrupted()) {
+                return;
+            }
+
+            auto temp{int(double(index) / double(images.size()) * 100) % 101};
+            auto current{percent.load()};
+            while (temp > current && !percent.compare_exchange_weak(current, temp)) {}
+            if (temp > current && paths.empty()) {
+                mtx.lock();
+                std::cout << "        " << "   " << "  " << std::setfill(' ') << std::setw(3) << temp << " " << "%" << "\n" << std::flush;
+                mtx.unlock();
+            }
+
+            auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{images[size_t(index)]};
+
+            auto const dst_path_small{fs::path{m_config.cache_path()}.append("small").append(hash).append(small + extension)};
+            auto const dst_path_medium{fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension)};
+            auto const dst_path_large{fs::path{m_config.cache_path()}.append("large").append(hash).append(large + extension)};
+
+            // a tier counts as done only once its file exists and its size is committed
+            auto const missing_small{!fs::exists(dst_path_small) || small_width == 0 || small_height == 0};
+            auto const missing_medium{!fs::exists(dst_path_medium) || medium_width == 0 || medium_height == 0};
+            auto const missing_large{!fs::exists(dst_path_large) || large_width == 0 || large_height == 0};
+            auto const missing_placeholders{std::get<0>(placeholders[size_t(index)]).empty() || !std::get<0>(phashes[size_t(index)])};
+            if ((!missing_small && !missing_medium && !missing_large && !missing_placeholders) || is_quarantined(failures, path)) {
+                finished.push({size_t(index), false, "", ""});
+                continue;
+            }
+            // placeholders alone only need the small tier, not the source
+            pending.push_back({size_t(index), missing_small, missing_medium, missing_large, missing_placeholders});
+            if (!missing_small && !missing_medium && !missing_large) {
+                src_paths.push_back(dst_path_small);
+            } else {
+                src_paths.push_back(fs::path{m_config.gallery_path()}.append(path));
+            }
+        }
+
+        auto sources{read_sources(src_paths)};
+
+        std::vector<std::tuple<fs::path, std::vector<unsigned char>>> outputs;
+        std::vector<size_t> owners;
+        std::vector<std::tuple<fs::path, fs::path>> links;
+        std::vector<size_t> link_owners;
+        std::vector<std::string> stages(pending.size());
+        std::vector<std::string> errors(pending.size());
+        for (size_t k{0}; k < pending.size(); ++k) {
+            auto const [index, missing_small, missing_medium, missing_large, missing_placeholders]{pending[k]};
+            auto& image{images[index]};
+            auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{image};
+
+            auto& stage{stages[k]};
+            stage = "read";
+            try {
+                auto& [buffer, error]{sources[k]};
+                if (error.size() > 0) {
+                    throw std::runtime_error(error);
+                }
+
+                if (!missing_small && !missing_medium && !missing_large) {
+                    stage = "placeholders";
+                    auto const small_mat{util::decode_image(buffer)};
+                    placeholders[index] = util::placeholders(small_mat);
+                    phashes[index] = {true, util::perceptual_hash(small_mat)};
+                    continue;
+                }
+
+                // the EXIF of a RAW file is in its TIFF structure and not in the preview, update_exif reads it from there
+                if (needs_exif[index] && !util::is_raw(path)) {
+                    stage = "exif";
+                    exifs[index] = util::exif_info(buffer.data(), buffer.size());
+                    exif_parsed[index] = 1;
+                }
+
+                stage = "decode";
+                cv::Mat src_mat;
+                cv::Size src_size;
+                // huge panoramas are decoded straight to the large tier, the other tiers are derived from it
+                if (auto const jpeg_size{util::jpeg_size(buffer)}; (long long)(jpeg_size.width) * jpeg_size.height > m_config.streaming_threshold()) {
+                    std::tie(src_mat, src_size) = util::decode_jpeg_downscaled(buffer, m_config.large_size());
+                }
+                if (src_mat.empty()) {
+                    src_mat = util::decode_image(buffer);
+                    src_size = src_mat.size();
+                }
+                std::get<5>(image) = src_size.width;
+                std::get<6>(image) = src_size.height;
+
+                // sources that fit a tier are never enlarged; without a watermark a JPEG within the quality range is even served as it is
+                auto const long_edge{std::max(src_size.width, src_size.height)};
+                std::vector<unsigned char> passthrough;
+                if (m_config.watermark_text().empty() && long_edge <= m_config.large_size()) {
+                    auto const quality{util::jpeg_quality(buffer)};
+                    if (quality >= m_config.passthrough_min_quality() && quality <= m_config.passthrough_max_quality()) {
+                        passthrough = util::jpeg_passthrough(buffer);
+                    }
+                }
+                std::vector<unsigned char>().swap(buffer);
+                auto& [medium_alias, large_alias]{aliases[index]};
+                auto& [small_quality, small_bytes, medium_quality, medium_bytes, large_quality, large_bytes]{encodings[index]};
+
+                cv::Mat small_mat;
+                if (missing_small) {
+                    stage = "small";
+                    small_mat = util::crop(src_mat, m_config.small_width(), m_config.small_height());
+                    auto [bytes, quality]{encode(small_mat, m_config.small_encoder_settings())};
+                    small_quality = quality;
+                    small_bytes = (long long)(bytes.size());
+                    outputs.push_back({fs::path{m_config.cache_path()}.append("small").append(hash).append(small + extension), std::move(bytes)});
+                    owners.push_back(k);
+                    std::get<11>(image) = small_mat.size().width;
+                    std::get<12>(image) = small_mat.size().height;
+                }
+                if (missing_small || missing_placeholders) {
+                    stage = "placeholders";
+                    if (small_mat.empty()) {
+                        small_mat = util::crop(src_mat, m_config.small_width(), m_config.small_height());
+                    }
+                    placeholders[index] = util::placeholders(small_mat);
+                    phashes[index] = {true, util::perceptual_hash(small_mat)};
+                }
+
+                // a near duplicate of an image whose tiers are done links to them instead of encoding its own
+                auto duplicate{false};
+                if (m_config.skip_duplicates() && (missing_medium || missing_large)) {
+                    stage = "duplicate";
+                    std::lock_guard<std::mutex> lock{duplicate_mtx};
+                    auto const ids{duplicate_index.find(std::get<1>(phashes[index]))};
+                    if (ids.size() > 0) {
+                        auto const& original{images[duplicate_owners[ids[0]]]};
+                        auto const& original_encodings{encodings[duplicate_owners[ids[0]]]};
+                        if (missing_medium) {
+                            links.push_back({fs::path{m_config.cache_path()}.append("medium").append(std::get<1>(original)).append(std::get<3>(original) + extension), fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension)});
+                            link_owners.push_back(k);
+                            medium_alias = 3;
+                            medium_quality = std::get<2>(original_encodings);
+                            medium_bytes = std::get<3>(original_encodings);
+                            std::get<9>(image) = std::get<9>(original);
+                            std::get<10>(image) = std::get<10>(original);
+                        }
+                        if (missing_large) {
+                            links.push_back({fs::path{m_config.cache_path()}.append("large").append(std::get<1>(original)).append(std::get<4>(original) + extension), fs::path{m_config.cache_path()}.append("large").append(hash).append(large + extension)});
+                            link_owners.push_back(k);
+                            large_alias = 3;
+                            large_quality = std::get<4>(original_encodings);
+                            large_bytes = std::get<5>(original_encodings);
+                            std::get<7>(image) = std::get<7>(original);
+                            std::get<8>(image) = std::get<8>(original);
+                        }
+                        duplicates[index] = std::get<0>(original);
+                        duplicate = true;
+                    }
+                }
+                if (!duplicate && (missing_medium || missing_large)) {
+                    duplicates[index].clear();
+                }
+                if (missing_medium && !duplicate) {
+                    stage = "medium";
+                    auto const dst_path{fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension)};
+                    if (long_edge <= m_config.medium_size() && passthrough.size() > 0) {
+                        medium_quality = util::jpeg_quality(passthrough);
+                        medium_bytes = (long long)(passthrough.size());
+                        outputs.push_back({dst_path, passthrough});
+                        medium_alias = 1;
+                        std::get<9>(image) = src_size.width;
+                        std::get<10>(image) = src_size.height;
+                    } else {
+                        auto const dst_mat{util::resize(src_mat, m_config.medium_size(), m_config.watermark_text(), 24, 16, 4)};
+                        auto [bytes, quality]{encode(dst_mat, m_config.medium_encoder_settings())};
+                        medium_quality = quality;
+                        medium_bytes = (long long)(bytes.size());
+                        outputs.push_back({dst_path, std::move(bytes)});
+                        medium_alias = 0;
+                        std::get<9>(image) = dst_mat.size().width;
+                        std::get<10>(image) = dst_mat.size().height;
+                    }
+                    owners.push_back(k);
+                }
+                if (missing_large && !duplicate) {
+                    stage = "large";
+                    auto const dst_path{fs::path{m_config.cache_path()}.append("large").append(hash).append(large + extension)};
+                    if (long_edge <= m_config.medium_size()) {
+                        // the large tier would show the same pixels as the medium one, it becomes a link to it once that is written
+                        links.push_back({fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension), dst_path});
+                        link_owners.push_back(k);
+                        large_alias = 2;
+                        large_quality = medium_quality;
+                        large_bytes = medium_bytes;
+                        std::get<7>(image) = std::get<9>(image);
+                        std::get<8>(image) = std::get<10>(image);
+                    } else if (passthrough.size() > 0) {
+                        large_quality = util::jpeg_quality(passthrough);
+                        large_bytes = (long long)(passthrough.size());
+                        outputs.push_back({dst_path, std::move(passthrough)});
+                        owners.push_back(k);
+                        large_alias = 1;
+                        std::get<7>(image) = src_size.width;
+                        std::get<8>(image) = src_size.height;
+                    } else {
+                        auto const dst_mat{util::resize(src_mat, m_config.large_size(), m_config.watermark_text(), 36, 32, 6)};
+                        auto [bytes, quality]{encode(dst_mat, m_config.large_encoder_settings())};
+                        large_quality = quality;
+                        large_bytes = (long long)(bytes.size());
+                        outputs.push_back({dst_path, std::move(bytes)});
+                        owners.push_back(k);
+                        large_alias = 0;
+                        std::get<7>(image) = dst_mat.size().width;
+                        std::get<8>(image) = dst_mat.size().height;
+                    }
+                }
+            } catch (std::exception const& e) {
+                errors[k] = e.what();
+            }
+        }
+
+        std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+        std::vector<char> existed(outputs.size());
+        for (size_t j{0}; j < outputs.size(); ++j) {
+            existed[j] = fs::exists(std::get<0>(outputs[j]));
+        }
+        auto const write_errors{util::write_files_atomic(outputs, m_config.io_backend())};
+        for (size_t j{0}; j < outputs.size(); ++j) {
+            if (write_errors[j].size() > 0) {
+                if (errors[owners[j]].empty()) {
+                    stages[owners[j]] = "write";
+                    errors[owners[j]] = write_errors[j];
+                }
+            } else {
+                entries.push_back(manifest_entry(std::get<0>(outputs[j]), std::get<1>(outputs[j]), !existed[j]));
+            }
+        }
+        std::vector<fs::path> linked;
+        std::vector<fs::path> relinked;
+        for (size_t j{0}; j < links.size(); ++j) {
+            if (errors[link_owners[j]].size() > 0) {
+                continue;
+            }
+            try {
+                auto const replaced{fs::exists(std::get<1>(links[j]))};
+                util::link_file_atomic(std::get<0>(links[j]), std::get<1>(links[j]));
+                (replaced ? relinked : linked).push_back(std::get<1>(links[j]));
+            } catch (std::exception const& e) {
+                stages[link_owners[j]] = "write";
+                errors[link_owners[j]] = e.what();
+            }
+        }
+        for (auto& entry: manifest_entries(linked, true)) {
+            entries.push_back(std::move(entry));
+        }
+        for (auto& entry: manifest_entries(relinked, false)) {
+            entries.push_back(std::move(entry));
+        }
+        mtx.lock();
+        std::move(entries.begin(), entries.end(), std::back_inserter(manifest));
+        mtx.unlock();
+
+        if (m_config.skip_duplicates()) {
+            std::lock_guard<std::mutex> lock{duplicate_mtx};
+            for (size_t k{0}; k < pending.size(); ++k) {
+                auto const index{std::get<0>(pending[k])};
+                if (errors[k].empty() && is_original(index)) {
+                    duplicate_index.insert(std::get<1>(phashes[index]));
+                    duplicate_owners.push_back(index);
+                }
+            }
+        }
+
+        for (size_t k{0}; k < pending.size(); ++k) {
+            auto const index{std::get<0>(pending[k])};
+            if (errors[k].size() > 0) {
+                mtx.lock();
+                std::cerr << "Error: " << errors[k] << " (" << src_paths[k].string() << ")"
+                    #ifdef SHASHIN_DEBUG
+                          << " [" << __FILE__ << ":" << __LINE__ << "]"
+                    #endif
+                          << "\n";
+                mtx.unlock();
+                finished.push({index, true, stages[k], errors[k]});
+            } else {
+                finished.push({index, true, "", ""});
+            }
+        }
+    }, int(images.size()), m_config.image_batch_size());
+
+    finished.close();
+    writer.join();
+    exec_query("DELETE FROM unfinished_images;");
+
+    store_manifest(manifest);
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << manifest.size() << " " << "file" << "  " << "tiers written" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "process images" << "\n" << std::flush;
+}
+
+auto Shashin::process_deepzoom() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    std::vector<std::tuple<std::string, std::string, std::string, std::string, int, int>> images;
+
+    exec_transaction(R"sql(
+        SELECT
+            i.path,
+            i.parent,
+            n.hash,
+            i.large,
+            i.width,
+            i.height
+        FROM images i INNER JOIN nodes n ON i.parent = n.path
+        ORDER BY i.parent, i.captured_at;
+    )sql", [this, &images](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto parent{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto width{sqlite3_column_int(stmt, ++i)};
+            auto height{sqlite3_column_int(stmt, ++i)};
+            images.push_back({path, parent, hash, large, width, height});
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    // a gallery opts in with a marker file, which either is empty or names the images that get a pyramid
+    std::unordered_map<std::string, std::tuple<bool, std::vector<std::string>>> markers;
+    auto const opted_in{[this, &markers](std::string const& parent, std::string const& path) -> bool {
+        if (markers.count(parent) == 0) {
+            auto const marker_path{fs::path{m_config.gallery_path()}.append(parent).append(m_config.deepzoom_file())};
+            std::vector<std::string> names;
+            if (fs::exists(marker_path)) {
+                std::ifstream ifs{marker_path};
+                std::string line;
+                while (std::getline(ifs, line)) {
+                    util::stackoverflow::trim(line);
+                    if (line.size() > 0) {
+                        names.push_back(line);
+                    }
+                }
+            }
+            markers[parent] = {fs::exists(marker_path), names};
+        }
+        auto const& [enabled, names]{markers[parent]};
+        return enabled && (names.empty() || std::find(names.begin(), names.end(), fs::path{path}.filename().string()) != names.end());
+    }};
+
+    auto const failures{load_failures()};
+    auto const tile_size{m_config.deepzoom_tile_size()};
+    auto const overlap{m_config.deepzoom_overlap()};
+
+    // encoders keep state between tiles, every worker owns one for all levels of all images
+    std::vector<std::unique_ptr<util::Encoder>> encoders(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto& encoder: encoders) {
+        encoder = util::make_encoder(m_config.encoder_backend());
+    }
+
+    std::stringstream ss;
+    ss << "\"" << "hash" << "\"" << ","
+       << "\"" << "large" << "\"" << ","
+       << "\"" << "width" << "\"" << ","
+       << "\"" << "height" << "\"" << "\n";
+
+    auto count{0};
+    for (auto const& [path, parent, hash, large, width, height]: images) {
+        if (util::interrupted()) {
+            break;
+        }
+        if (!opted_in(parent, path)) {
+            continue;
+        }
+
+        // the manifest is written last, so it only exists for complete pyramids
+        auto const dst_path{fs::path{m_config.cache_path()}.append("deepzoom").append(hash)};
+        auto const manifest_path{fs::path{dst_path}.append(large + ".dzi")};
+        auto const tiles_path{fs::path{dst_path}.append(large + "_files")};
+        if (fs::exists(manifest_path)) {
+            ss << "\"" << hash << "\"" << ","
+               << "\"" << large << "\"" << ","
+               << "\"" << width << "\"" << ","
+               << "\"" << height << "\"" << "\n";
+            continue;
+        }
+        if (is_quarantined(failures, path)) {
+            continue;
+        }
+
+        auto const src_path{fs::path{m_config.gallery_path()}.append(path)};
+        std::string stage{"read"};
+        try {
+            auto sources{read_sources({src_path})};
+            auto& [buffer, error]{sources[0]};
+            if (error.size() > 0) {
+                throw std::runtime_error(error);
+            }
+
+            stage = "deepzoom";
+            cv::Mat level_mat{util::decode_image(buffer)};
+            std::vector<unsigned char>().swap(buffer);
+            auto const size{level_mat.size()};
+            // a pyramid built again for a changed source reuses the names of its tiles
+            auto const immutable{!fs::exists(tiles_path)};
+            fs::remove_all(tiles_path);
+            std::vector<std::tuple<std::string, long long, std::string, bool>> manifest;
+
+            // level n is the full resolution and every level below is half of the one above, down to a single pixel
+            auto level{int(std::ceil(std::log2(double(std::max(size.width, size.height)))))};
+            for (; level >= 0 && !util::interrupted(); --level) {
+                auto const level_size{level_mat.size()};
+                auto const cols{(level_size.width + tile_size - 1) / tile_size};
+                auto const rows{(level_size.height + tile_size - 1) / tile_size};
+                auto const level_path{fs::path{tiles_path}.append(std::to_string(level))};
+
+                std::vector<std::string> errors(size_t(cols * rows));
+                util::process_parallel_dynamic([this, &encoders, &level_mat, &level_size, &level_path, &errors, &manifest, cols, tile_size, overlap, immutable](int worker_number, int lower_bound, int upper_bound) {
+                    auto& encoder{*encoders[size_t(worker_number)]};
+                    std::vector<std::tuple<fs::path, std::vector<unsigned char>>> tiles;
+                    std::vector<int> owners;
+                    for (auto index{lower_bound}; index < upper_bound; ++index) {
+                        auto const col{index % cols};
+                        auto const row{index / cols};
+                        try {
+                            auto const tile_mat{level_mat(util::tile_rect(level_size, tile_size, overlap, col, row))};
+                            tiles.push_back({fs::path{level_path}.append(std::to_string(col) + "_" + std::to_string(row) + ".jpg"), encoder.encode(tile_mat, m_config.deepzoom_encoder_settings())});
+                            owners.push_back(index);
+                        } catch (std::exception const& e) {
+                            errors[size_t(index)] = e.what();
+                        }
+                    }
+                    auto const write_errors{util::write_files_atomic(tiles, m_config.io_backend())};
+                    std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+                    for (size_t j{0}; j < tiles.size(); ++j) {
+                        if (write_errors[j].size() > 0) {
+                            errors[size_t(owners[j])] = write_errors[j];
+                        } else {
+                            entries.push_back(manifest_entry(std::get<0>(tiles[j]), std::get<1>(tiles[j]), immutable));
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock{mtx};
+                    std::move(entries.begin(), entries.end(), std::back_inserter(manifest));
+                }, cols * rows, m_config.deepzoom_batch_size(), int(encoders.size()));
+
+                for (auto const& e: errors) {
+                    if (e.size() > 0) {
+                        throw std::runtime_error(e);
+                    }
+                }
+
+                if (level > 0) {
+                    level_mat = util::deepzoom_next_level(level_mat);
+                }
+            }
+            if (level >= 0) {
+                break;
+            }
+
+            auto const dzi{util::deepzoom_manifest(size, tile_size, overlap)};
+            util::dump_to_file(manifest_path, dzi);
+            manifest.push_back(manifest_entry(manifest_path, std::vector<unsigned char>{dzi.begin(), dzi.end()}, immutable));
+            store_manifest(manifest);
+            if (failures.count(path) > 0) {
+                delete_failures({path});
+            }
+            ss << "\"" << hash << "\"" << ","
+               << "\"" << large << "\"" << ","
+               << "\"" << size.width << "\"" << ","
+               << "\"" << size.height << "\"" << "\n";
+            ++count;
+        } catch (std::exception const& e) {
+            std::cerr << "Error: " << e.what() << " (" << src_path.string() << ")"
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+            insert_failures({{path, stage, e.what()}});
+        }
+    }
+
+    if (!util::interrupted()) {
+        util::dump_to_file(fs::path{m_config.data_path()}.append("deepzoom.csv"), ss.str());
+    }
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << count << " " << "img" << "  " << "deep zoom pyramids" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "process deep zoom" << "\n" << std::flush;
+}
+
+auto Shashin::create_sprites() const -> void {
+    if (!m_config.sprites()) {
+        return;
+    }
+
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    // small tiers in gallery order, unpublished images are left out of the sheets
+    std::vector<std::tuple<std::string, std::string, std::vector<std::string>, std::vector<long long>>> nodes;
+    auto const query{std::string{R"sql(
+        SELECT
+            n.path,
+            n.hash,
+            i.small,
+            i.generation
+        FROM images i INNER JOIN nodes n ON i.parent = n.path
+        WHERE )sql"} + published_images + R"sql(
+        ORDER BY i.parent, i.captured_at, i.path;
+    )sql"};
+    exec_transaction(query.c_str(), [this, &nodes](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto generation{sqlite3_column_int64(stmt, ++i)};
+            if (nodes.empty() || std::get<0>(nodes.back()) != path) {
+                nodes.push_back({path, hash, {}, {}});
+            }
+            std::get<2>(nodes.back()).push_back(small);
+            std::get<3>(nodes.back()).push_back(generation);
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+
+    std::unordered_map<std::string, std::string> signatures;
+    exec_transaction(R"sql(
+        SELECT path, signature FROM sprites;
+    )sql", [&signatures](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            signatures[path] = std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 1))};
+        }
+    });
+
+    // the signature covers the sheet layout and the ordered small tiers with their generation, so only nodes whose images changed are rebuilt;
+    // it is part of the sheet names, so browsers never see a stale sheet under a known name
+    auto const tile_size{cv::Size(m_config.small_width(), m_config.small_height())};
+    auto const tiles_per_sheet{m_config.sprite_columns() * m_config.sprite_rows()};
+    std::vector<std::string> current(nodes.size());
+    std::vector<size_t> changed;
+    for (size_t k{0}; k < nodes.size(); ++k) {
+        std::stringstream ss;
+        ss << m_config.sprite_columns() << "x" << m_config.sprite_rows() << "x" << tile_size.width << "x" << tile_size.height;
+        for (size_t i{0}; i < std::get<2>(nodes[k]).size(); ++i) {
+            ss << ";" << std::get<2>(nodes[k])[i] << "@" << std::get<3>(nodes[k])[i];
+        }
+        current[k] = util::hash_to_hex_string(util::string_to_hash(ss.str()));
+        auto const it{signatures.find(std::get<0>(nodes[k]))};
+        if (it == signatures.end() || it->second != current[k]) {
+            changed.push_back(k);
+        }
+    }
+
+    // sheet names carry the signature, so a sheet never changes under its name
+    std::vector<std::string> errors(changed.size());
+    std::vector<std::tuple<std::string, long long, std::string, bool>> manifest;
+    util::process_parallel_dynamic([this, &nodes, &current, &changed, &errors, &manifest, &tile_size, tiles_per_sheet](int worker_number, int lower_bound, int upper_bound) {
+        (void)worker_number;
+        auto const extension{".jpg"};
+        for (auto c{lower_bound}; c < upper_bound; ++c) {
+            if (util::interrupted()) {
+                return;
+            }
+
+            auto const& [path, hash, smalls, generations]{nodes[changed[size_t(c)]]};
+            auto const& signature{current[changed[size_t(c)]]};
+            auto const dst_path{fs::path{m_config.cache_path()}.append("sprites").append(hash)};
+            try {
+                std::vector<std::tuple<fs::path, std::vector<unsigned char>>> sheets;
+                for (size_t first{0}; first < smalls.size(); first += size_t(tiles_per_sheet)) {
+                    std::vector<fs::path> src_paths;
+                    for (auto i{first}; i < std::min(smalls.size(), first + size_t(tiles_per_sheet)); ++i) {
+                        src_paths.push_back(fs::path{m_config.cache_path()}.append("small").append(hash).append(smalls[i] + extension));
+                    }
+                    std::vector<cv::Mat> tiles;
+                    for (auto& [buffer, error]: util::read_files(src_paths, m_config.io_backend())) {
+                        if (error.size() > 0) {
+                            throw std::runtime_error(error);
+                        }
+                        tiles.push_back(util::decode_image(buffer));
+                    }
+                    auto const sheet_mat{util::sprite_sheet(tiles, m_config.sprite_columns(), tile_size)};
+                    sheets.push_back({fs::path{dst_path}.append(signature + "-" + std::to_string(first / size_t(tiles_per_sheet)) + extension), util::encode_jpeg(sheet_mat)});
+                }
+                for (auto const& error: util::write_files_atomic(sheets, m_config.io_backend())) {
+                    if (error.size() > 0) {
+                        throw std::runtime_error(error);
+                    }
+                }
+                std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+                for (auto const& [sheet_path, data]: sheets) {
+                    entries.push_back(manifest_entry(sheet_path, data, true));
+                }
+                std::lock_guard<std::mutex> lock{mtx};
+                std::move(entries.begin(), entries.end(), std::back_inserter(manifest));
+            } catch (std::exception const& e) {
+                errors[size_t(c)] = e.what();
+                std::lock_guard<std::mutex> lock{mtx};
+                std::cerr << "Error: " << e.what() << " (" << path << ")"
+                    #ifdef SHASHIN_DEBUG
+                          << " [" << __FILE__ << ":" << __LINE__ << "]"
+                    #endif
+                          << "\n";
+            }
+        }
+    }, int(changed.size()));
+    store_manifest(manifest);
+
+    auto count{0};
+    exec_transaction(R"sql(
+        INSERT INTO sprites (created_at, path, signature, sheets)
+        VALUES (?,?,?,?)
+        ON CONFLICT(path) DO UPDATE SET created_at=excluded.created_at, signature=excluded.signature, sheets=excluded.sheets;
+    )sql", [this, &nodes, &current, &changed, &errors, &signatures, &count, tiles_per_sheet](sqlite3_stmt* stmt) -> void {
+        int i{0};
+        for (size_t c{0}; c < changed.size(); ++c) {
+            if (errors[c].size() > 0 || util::interrupted()) {
+                continue;
+            }
+            auto const& [path, hash, smalls, generations]{nodes[changed[c]]};
+            auto const sheets{(int(smalls.size()) + tiles_per_sheet - 1) / tiles_per_sheet};
+
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+            util::sqlite3_bind_string(stmt, ++i, current[changed[c]]); // signature
+            sqlite3_bind_int(stmt, ++i, sheets); // sheets
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            signatures[path] = current[changed[c]];
+            ++count;
+        }
+    });
+
+    // nodes that are gone or have no small tier left, their sheets are removed by remove_stale_sprites
+    std::unordered_set<std::string> node_paths;
+    for (auto const& node: nodes) {
+        node_paths.insert(std::get<0>(node));
+    }
+    std::vector<std::string> removed;
+    for (auto const& [path, signature]: signatures) {
+        if (node_paths.count(path) == 0) {
+            removed.push_back(path);
+        }
+    }
+    exec_transaction(R"sql(
+        DELETE FROM sprites WHERE path = ?;
+    )sql", [&removed](sqlite3_stmt* stmt) -> void {
+        for (auto const& path: removed) {
+            util::sqlite3_bind_string(stmt, 1, path); // path
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+
+    std::stringstream ss;
+    ss << "\"" << "node_hash" << "\"" << ","
+       << "\"" << "small_hash" << "\"" << ","
+       << "\"" << "sprite_index" << "\"" << ","
+       << "\"" << "sprite_path" << "\"" << ","
+       << "\"" << "x" << "\"" << ","
+       << "\"" << "y" << "\"" << ","
+       << "\"" << "width" << "\"" << ","
+       << "\"" << "height" << "\"" << "\n";
+    for (size_t k{0}; k < nodes.size(); ++k) {
+        auto const& [path, hash, smalls, generations]{nodes[k]};
+        auto const it{signatures.find(path)};
+        if (it == signatures.end() || it->second != current[k]) {
+            continue;
+        }
+        for (size_t i{0}; i < smalls.size(); ++i) {
+            auto const sheet{int(i) / tiles_per_sheet};
+            auto const cell{int(i) % tiles_per_sheet};
+            auto const sprite_path{"/" + fs::path{m_config.cache_dir()}.append("sprites").append(hash).append(current[k] + "-" + std::to_string(sheet) + ".jpg").string()};
+            ss << "\"" << hash << "\"" << ","
+               << "\"" << smalls[i] << "\"" << ","
+               << "\"" << sheet << "\"" << ","
+               << "\"" << sprite_path << "\"" << ","
+               << "\"" << cell % m_config.sprite_columns() * tile_size.width << "\"" << ","
+               << "\"" << cell / m_config.sprite_columns() * tile_size.height << "\"" << ","
+               << "\"" << tile_size.width << "\"" << ","
+               << "\"" << tile_size.height << "\"" << "\n";
+        }
+    }
+    util::dump_to_file(fs::path{m_config.data_path()}.append("sprites.csv"), ss.str());
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << count << " " << "node" << "  " << "sprite sheets rebuilt" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create sprites" << "\n" << std::flush;
+}
+
+// the deployed pages reference the sheets they were rendered with, so sheets of earlier signatures and of removed nodes
+// are only deleted once create_pages has rendered the pages against the current ones
+auto Shashin::remove_stale_sprites() const -> void {
+    if (!m_config.sprites()) {
+        return;
+    }
+
+    std::unordered_map<std::string, std::string> signatures;
+    exec_transaction(R"sql(
+        SELECT path, signature FROM sprites;
+    )sql", [&signatures](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            auto hash{util::hash_to_hex_string(util::string_to_hash(path))};
+            signatures[hash] = std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 1))};
+        }
+    });
+
+    std::error_code ec;
+    for (auto const& dir: fs::directory_iterator{fs::path{m_config.cache_path()}.append("sprites"), ec}) {
+        auto const it{signatures.find(dir.path().filename().string())};
+        if (it == signatures.end()) {
+            fs::remove_all(dir.path(), ec);
+            continue;
+        }
+        for (auto const& entry: fs::directory_iterator{dir.path(), ec}) {
+            if (entry.path().filename().string().rfind(it->second + "-", 0) != 0) {
+                fs::remove(entry.path(), ec);
+            }
+        }
+    }
+}
+
+auto Shashin::create_gallery_files() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    // nodes
+    {
+        std::stringstream ss;
+        ss << "\"" << "hash" << "\"" << ","
+           << "\"" << "path" << "\"" << ","
+           << "\"" << "depth" << "\"" << ","
+           << "\"" << "name" << "\"" << ","
+           << "\"" << "url" << "\"" << ","
+           << "\"" << "captured_at" << "\"" << ","
+           << "\"" << "title" << "\"" << ","
+           << "\"" << "event" << "\"" << ","
+           << "\"" << "location" << "\"" << ","
+           << "\"" << "city" << "\"" << ","
+           << "\"" << "country" << "\"" << "\n";
+        exec_transaction(R"sql(
+            SELECT
+                depth,
+                path,
+                created_at,
+                updated_at,
+                name,
+                url,
+                hash,
+                captured_at,
+                title,
+                event,
+                location,
+                city,
+                country
+            FROM nodes
+            ORDER BY depth, path, captured_at, title;
+        )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
+            auto i{0};
+            auto rc{0};
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                i = -1;
+                auto depth{sqlite3_column_int(stmt, ++i)};
+                auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto event{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto location{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto city{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto country{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+                ss << "\"" << hash << "\"" << ","
+                   << "\"" << path << "\"" << ","
+                   << "\"" << depth << "\"" << ","
+                   << "\"" << name << "\"" << ","
+                   << "\"" << url << "\"" << ","
+                   << "\"" << captured_at << "\"" << ","
+                   << "\"" << title << "\"" << ","
+                   << "\"" << event << "\"" << ","
+                   << "\"" << location << "\"" << ","
+                   << "\"" << city << "\"" << ","
+                   << "\"" << country << "\"" << "\n";
+            }
+            if (rc != SQLITE_DONE) {
+                std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                    #ifdef SHASHIN_DEBUG
+                          << " [" << __FILE__ << ":" << __LINE__ << "]"
+                    #endif
+                          << "\n";
+            }
+        });
+        util::dump_to_file(fs::path{m_config.data_path()}.append("nodes.csv"), ss.str());
+    }
+
+    // images
+    {
+        std::stringstream ss;
+        ss << "\"" << "node_hash" << "\"" << ","
+           << "\"" << "small_hash" << "\"" << ","
+           << "\"" << "medium_hash" << "\"" << ","
+           << "\"" << "large_hash" << "\"" << ","
+           << "\"" << "small_path" << "\"" << ","
+           << "\"" << "medium_path" << "\"" << ","
+           << "\"" << "large_path" << "\"" << ","
+           << "\"" << "width" << "\"" << ","
+           << "\"" << "height" << "\"" << ","
+           << "\"" << "large_width" << "\"" << ","
+           << "\"" << "large_height" << "\"" << ","
+           << "\"" << "medium_width" << "\"" << ","
+           << "\"" << "medium_height" << "\"" << ","
+           << "\"" << "small_width" << "\"" << ","
+           << "\"" << "small_height" << "\"" << ","
+           << "\"" << "captured_at" << "\"" << ","
+           << "\"" << "fstop" << "\"" << ","
+           << "\"" << "exposure_time" << "\"" << ","
+           << "\"" << "iso_speed" << "\"" << ","
+           << "\"" << "exposure_bias" << "\"" << ","
+           << "\"" << "flash" << "\"" << ","
+           << "\"" << "metering_mode" << "\"" << ","
+           << "\"" << "focal_length" << "\"" << ","
+           << "\"" << "focal_length_35mm" << "\"" << ","
+           << "\"" << "camera_make" << "\"" << ","
+           << "\"" << "camera_model" << "\"" << ","
+           << "\"" << "lens_make" << "\"" << ","
+           << "\"" << "lens_model" << "\"" << ","
+           << "\"" << "software" << "\"" << ","
+           << "\"" << "description" << "\"" << ","
+           << "\"" << "copyright" << "\"" << ","
+           << "\"" << "gps" << "\"" << ","
+           << "\"" << "blurhash" << "\"" << ","
+           << "\"" << "lqip" << "\"" << ","
+           << "\"" << "dominant_color" << "\"" << ","
+           << "\"" << "rating" << "\"" << ","
+           << "\"" << "label" << "\"" << ","
+           << "\"" << "pick" << "\"" << ","
+           << "\"" << "caption" << "\"" << ","
+           << "\"" << "keywords" << "\"" << "\n";
+        auto const query{std::string{R"sql(
+            SELECT
+                i.path,
+                n.hash,
+                i.small,
+                i.medium,
+                i.large,
+                i.width,
+                i.height,
+                i.large_width,
+                i.large_height,
+                i.medium_width,
+                i.medium_height,
+                i.small_width,
+                i.small_height,
+                i.created_at,
+                i.updated_at,)sql"} + exif_select + R"sql(,
+                i.blurhash,
+                i.lqip,
+                i.dominant_color,
+                i.rating,
+                i.label,
+                i.pick,
+                i.caption,
+                (SELECT ifnull(group_concat(name, ';'), '') FROM (SELECT k.name FROM image_keywords ik INNER JOIN keywords k ON ik.keyword_id = k.id WHERE ik.image_id = i.id ORDER BY k.name))
+            FROM images i INNER JOIN nodes n ON i.parent = n.path)sql" + exif_joins + R"sql(
+            WHERE )sql" + published_images + R"sql(
+            ORDER BY i.parent, i.captured_at;
+        )sql"};
+        exec_transaction(query.c_str(), [this, &ss](sqlite3_stmt* stmt) -> void {
+            auto i{0};
+            auto rc{0};
+            auto const extension{".jpg"};
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                i = -1;
+                auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto width{sqlite3_column_int(stmt, ++i)};
+                auto height{sqlite3_column_int(stmt, ++i)};
+                auto large_width{sqlite3_column_int(stmt, ++i)};
+                auto large_height{sqlite3_column_int(stmt, ++i)};
+                auto medium_width{sqlite3_column_int(stmt, ++i)};
+                auto medium_height{sqlite3_column_int(stmt, ++i)};
+                auto small_width{sqlite3_column_int(stmt, ++i)};
+                auto small_height{sqlite3_column_int(stmt, ++i)};
+                auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto [captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, focal_length, focal_length_35mm, camera_make, camera_model, lens_make, lens_model, software, description, copyright, gps]{column_exif_strings(stmt, i)};
+                auto blurhash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto lqip{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto dominant_color{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto rating{sqlite3_column_int(stmt, ++i)};
+                auto label{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto pick{sqlite3_column_int(stmt, ++i)};
+                auto caption{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                auto keywords{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+                auto const dst_path_small{"/" + fs::path{m_config.cache_dir()}.append("small").append(hash).append(small + extension).string()};
+                auto const dst_path_medium{"/" + fs::path{m_config.cache_dir()}.append("medium").append(hash).append(medium + extension).string()};
+                auto const dst_path_large{"/" + fs::path{m_config.cache_dir()}.append("large").append(hash).append(large + extension).string()};
+
+                gps = std::regex_replace(gps, std::regex(R"raw(°)raw"), "&deg;");
+                gps = std::regex_replace(gps, std::regex(R"raw(")raw"), "&quot;");
+                gps = std::regex_replace(gps, std::regex(R"raw(')raw"), "&apos;");
+                label = std::regex_replace(label, std::regex(R"raw(")raw"), "&quot;");
+                caption = std::regex_replace(caption, std::regex(R"raw(")raw"), "&quot;");
+                keywords = std::regex_replace(keywords, std::regex(R"raw(")raw"), "&quot;");
+
+                ss << "\"" << hash << "\"" << ","
+                   << "\"" << small<< "\"" << ","
+                   << "\"" << medium << "\"" << ","
+                   << "\"" << large << "\"" << ","
+                   << "\"" << dst_path_small << "\"" << ","
+                   << "\"" << dst_path_medium << "\"" << ","
+                   << "\"" << dst_path_large << "\"" << ","
+                   << "\"" << width << "\"" << ","
+                   << "\"" << height << "\"" << ","
+                   << "\"" << large_width << "\"" << ","
+                   << "\"" << large_height << "\"" << ","
+                   << "\"" << medium_width << "\"" << ","
+                   << "\"" << medium_height << "\"" << ","
+                   << "\"" << small_width << "\"" << ","
+                   << "\"" << small_height << "\"" << ","
+                   << "\"" << captured_at << "\"" << ","
+                   << "\"" << fstop << "\"" << ","
+                   << "\"" << exposure_time << "\"" << ","
+                   << "\"" << iso_speed << "\"" << ","
+                   << "\"" << exposure_bias << "\"" << ","
+                   << "\"" << flash << "\"" << ","
+                   << "\"" << metering_mode << "\"" << ","
+                   << "\"" << focal_length << "\"" << ","
+                   << "\"" << focal_length_35mm << "\"" << ","
+                   << "\"" << camera_make << "\"" << ","
+                   << "\"" << camera_model << "\"" << ","
+                   << "\"" << lens_make << "\"" << ","
+                   << "\"" << lens_model << "\"" << ","
+                   << "\"" << software << "\"" << ","
+                   << "\"" << description << "\"" << ","
+                   << "\"" << copyright << "\"" << ","
+                   << "\"" << gps << "\"" << ","
+                   << "\"" << blurhash << "\"" << ","
+                   << "\"" << lqip << "\"" << ","
+                   << "\"" << dominant_color << "\"" << ","
+                   << "\"" << rating << "\"" << ","
+                   << "\"" << label << "\"" << ","
+                   << "\"" << pick << "\"" << ","
+                   << "\"" << caption << "\"" << ","
+                   << "\"" << keywords << "\"" << "\n";
+            }
+            if (rc != SQLITE_DONE) {
+                std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                    #ifdef SHASHIN_DEBUG
+                          << " [" << __FILE__ << ":" << __LINE__ << "]"
+                    #endif
+                          << "\n";
+            }
+        });
+        util::dump_to_file(fs::path{m_config.data_path()}.append("images.csv"), ss.str());
+    }
+
+    create_aggregate_files();
+
+    // the data files keep their names across runs, so unlike the tiers they must be revalidated by the web tier
+    auto const data_paths{list_directory_recursive(m_config.data_path(), [](fs::path const& path) -> bool {
+        return fs::is_regular_file(path) && (path.extension() == ".csv" || path.extension() == ".json");
+    })};
+    store_manifest(manifest_entries(data_paths, false));
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create gallery files" << "\n" << std::flush;
+}
+
+// name of the data files, the facet value of an image and the order of the summary file
+static std::vector<std::tuple<char const*, char const*, char const*>> const facets{{
+    {"cameras", "coalesce(c.model, '')", "total DESC, facet"},
+    {"lenses", "coalesce(l.model, '')", "total DESC, facet"},
+    {"years", "substr(i.captured_at, 1, 4)", "facet DESC"},
+    {"countries", "n.country", "total DESC, facet"},
+    {"cities", "n.city", "total DESC, facet"},
+}};
+
+auto Shashin::create_aggregate_files() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    auto const signature{export_signature()};
+    auto const signatures{load_export_signatures()};
+
+    std::vector<std::string> rebuilt;
+    for (auto const& [name, value, order]: facets) {
+        auto const summary_path{fs::path{m_config.data_path()}.append(std::string{name} + ".csv")};
+        auto const members_path{fs::path{m_config.data_path()}.append(std::string{name} + "_images.csv")};
+        auto const it{signatures.find(name)};
+        if (it != signatures.end() && it->second == signature && fs::exists(summary_path) && fs::exists(members_path)) {
+            continue;
+        }
+
+        // the bare columns of an aggregate query with a single max() come from the row holding the maximum,
+        // so the cover is the latest image of each value
+        {
+            std::stringstream ss;
+            ss << "\"" << "name" << "\"" << ","
+               << "\"" << "count" << "\"" << ","
+               << "\"" << "captured_at" << "\"" << ","
+               << "\"" << "node_hash" << "\"" << ","
+               << "\"" << "small_hash" << "\"" << ","
+               << "\"" << "small_path" << "\"" << "\n";
+            auto const query{std::string{R"sql(
+                SELECT
+                    )sql"} + value + R"sql( AS facet,
+                    count(*) AS total,
+                    max(i.captured_at),
+                    n.hash,
+                    i.small
+                FROM images i INNER JOIN nodes n ON i.parent = n.path)sql" + exif_joins + R"sql(
+                WHERE facet != '' AND )sql" + published_images + R"sql(
+                GROUP BY facet
+                ORDER BY )sql" + order + ";"};
+            exec_transaction(query.c_str(), [this, &ss](sqlite3_stmt* stmt) -> void {
+                auto i{0};
+                auto rc{0};
+                auto const extension{".jpg"};
+                while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                    i = -1;
+                    auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                    auto count{sqlite3_column_int(stmt, ++i)};
+                    auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                    auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                    auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+                    auto const dst_path_small{"/" + fs::path{m_config.cache_dir()}.append("small").append(hash).append(small + extension).string()};
+
+                    ss << "\"" << name << "\"" << ","
+                       << "\"" << count << "\"" << ","
+                       << "\"" << captured_at << "\"" << ","
+                       << "\"" << hash << "\"" << ","
+                       << "\"" << small << "\"" << ","
+                       << "\"" << dst_path_small << "\"" << "\n";
+                }
+                if (rc != SQLITE_DONE) {
+                    std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                        #ifdef SHASHIN_DEBUG
+                              << " [" << __FILE__ << ":" << __LINE__ << "]"
+                        #endif
+                              << "\n";
+                }
+            });
+            util::dump_to_file(summary_path, ss.str());
+        }
+
+        // members are grouped by value and ordered like the galleries, newest first, small_hash is the key into images.csv
+        {
+            std::stringstream ss;
+            ss << "\"" << "name" << "\"" << ","
+               << "\"" << "node_hash" << "\"" << ","
+               << "\"" << "small_hash" << "\"" << "\n";
+            auto const query{std::string{R"sql(
+                SELECT
+                    )sql"} + value + R"sql( AS facet,
+                    n.hash,
+                    i.small
+                FROM images i INNER JOIN nodes n ON i.parent = n.path)sql" + exif_joins + R"sql(
+                WHERE facet != '' AND )sql" + published_images + R"sql(
+                ORDER BY facet, i.captured_at DESC, i.path;
+            )sql"};
+            exec_transaction(query.c_str(), [this, &ss](sqlite3_stmt* stmt) -> void {
+                auto i{0};
+                auto rc{0};
+                while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                    i = -1;
+                    auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                    auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+                    auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+                    ss << "\"" << name << "\"" << ","
+                       << "\"" << hash << "\"" << ","
+                       << "\"" << small << "\"" << "\n";
+                }
+                if (rc != SQLITE_DONE) {
+                    std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                        #ifdef SHASHIN_DEBUG
+                              << " [" << __FILE__ << ":" << __LINE__ << "]"
+                        #endif
+                              << "\n";
+                }
+            });
+            util::dump_to_file(members_path, ss.str());
+        }
+        rebuilt.push_back(name);
+    }
+
+    store_export_signatures(rebuilt, signature);
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << rebuilt.size() << " " << "facet" << "  " << "aggregates rebuilt" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create aggregate files" << "\n" << std::flush;
+}
+
+// one document per node, its columns hold the tokens of string_to_tokens so the browser and the CLI match the same words
+auto Shashin::create_search_index() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    auto const search_path{fs::path{m_config.cache_path()}.append(m_config.search_dir())};
+    auto const index_path{fs::path{search_path}.append("index.json")};
+    auto const signature{export_signature()};
+    auto const signatures{load_export_signatures()};
+    auto const it{signatures.find("search")};
+    if (it != signatures.end() && it->second == signature && fs::exists(index_path)) {
+        timestamp_end = util::make_timestamp();
+        duration_ms = util::time_between(timestamp_start, timestamp_end);
+        std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create search index (unchanged)" << "\n" << std::flush;
+        return;
+    }
+
+    auto const join{[](std::vector<std::string> const& tokens) -> std::string {
+        std::string str;
+        for (auto const& token: tokens) {
+            str += (str.size() > 0 ? " " : "") + token;
+        }
+        return str;
+    }};
+
+    // hash, path, url, title and the tokens of title, event, location, city, country, cameras and lenses
+    std::vector<std::tuple<std::string, std::string, std::string, std::string, std::vector<std::vector<std::string>>>> documents;
+    auto const query{std::string{R"sql(
+        SELECT
+            n.hash,
+            n.path,
+            n.url,
+            n.title,
+            n.event,
+            n.location,
+            n.city,
+            n.country,
+            coalesce(group_concat(DISTINCT c.make || ' ' || c.model), ''),
+            coalesce(group_concat(DISTINCT l.make || ' ' || l.model), '')
+        FROM nodes n
+        LEFT JOIN images i ON i.parent = n.path AND )sql"} + published_images + R"sql(
+        LEFT JOIN cameras c ON c.id = i.camera_id
+        LEFT JOIN lenses l ON l.id = i.lens_id
+        GROUP BY n.id
+        ORDER BY n.depth, n.path;
+    )sql"};
+    exec_transaction(query.c_str(), [this, &documents](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            std::vector<std::vector<std::string>> columns{util::string_to_tokens(title)};
+            while (i + 1 < sqlite3_column_count(stmt)) {
+                columns.push_back(util::string_to_tokens(std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}));
+            }
+            documents.push_back({hash, path, url, title, columns});
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
                       << " [" << __FILE__ << ":" << __LINE__ << "]"
                 #endif
                       << "\n";
         }
     });
-    ss << "</table>" << "\n";
 
-    // images
-    ss << "<table>" << "\n";
-    ss << "<tr>" << "\n"
-       << "<td><b>path</b></td>" << "\n"
-       << "<td><b>hash</b></td>" << "\n"
-       << "<td><b>small</b></td>" << "\n"
-       << "<td><b>medium</b></td>" << "\n"
-       << "<td><b>large</b></td>" << "\n"
-       << "<td><b>created_at</b></td>" << "\n"
-       << "<td><b>updated_at</b></td>" << "\n"
-       << "<td><b>captured_at</b></td>" << "\n"
-       << "<td><b>fstop</b></td>" << "\n"
-       << "<td><b>exposure_time</b></td>" << "\n"
-       << "<td><b>iso_speed</b></td>" << "\n"
-       << "<td><b>exposure_bias</b></td>" << "\n"
-       << "<td><b>flash</b></td>" << "\n"
-       << "<td><b>metering_mode</b></td>" << "\n"
-       << "<td><b>focal_length</b></td>" << "\n"
-       << "<td><b>focal_length_35mm</b></td>" << "\n"
-       << "<td><b>camera_make</b></td>" << "\n"
-       << "<td><b>camera_model</b></td>" << "\n"
-       << "<td><b>lens_make</b></td>" << "\n"
-       << "<td><b>lens_model</b></td>" << "\n"
-       << "<td><b>software</b></td>" << "\n"
-       << "<td><b>description</b></td>" << "\n"
-       << "<td><b>copyright</b></td>" << "\n"
-       << "<td><b>gps</b></td>" << "\n"
-       << "</tr>" << "\n";
+    exec_query("DELETE FROM search;");
     exec_transaction(R"sql(
+        INSERT INTO search (hash, path, title, event, location, city, country, cameras, lenses)
+        VALUES (?,?,?,?,?,?,?,?,?);
+    )sql", [&documents, &join](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& [hash, path, url, title, columns]: documents) {
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, hash); // hash
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+            for (auto const& tokens: columns) {
+                util::sqlite3_bind_string(stmt, ++i, join(tokens)); // title, event, location, city, country, cameras, lenses
+            }
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+
+    // postings are the ascending document numbers of a token, stored as differences to keep the shards small;
+    // a token goes into the shard of its first bytes, or "_" when those are not plain ASCII
+    std::map<std::string, std::map<std::string, std::vector<int>>> shards;
+    for (size_t d{0}; d < documents.size(); ++d) {
+        std::set<std::string> tokens;
+        for (auto const& column: std::get<4>(documents[d])) {
+            tokens.insert(column.begin(), column.end());
+        }
+        for (auto const& token: tokens) {
+            auto prefix{token.substr(0, size_t(m_config.search_prefix_length()))};
+            if (std::any_of(prefix.begin(), prefix.end(), [](char ch) { return static_cast<unsigned char>(ch) >= 0x80; })) {
+                prefix = "_";
+            }
+            shards[prefix][token].push_back(int(d));
+        }
+    }
+
+    fs::create_directories(search_path);
+    auto index{nlohmann::json::object()};
+    index["prefix_length"] = m_config.search_prefix_length();
+    index["shards"] = nlohmann::json::array();
+    index["documents"] = nlohmann::json::array();
+    for (auto const& [hash, path, url, title, columns]: documents) {
+        index["documents"].push_back({hash, url, title});
+    }
+    std::set<std::string> files{"index.json"};
+    for (auto const& [prefix, postings]: shards) {
+        auto shard{nlohmann::json::object()};
+        for (auto const& [token, ids]: postings) {
+            auto deltas{nlohmann::json::array()};
+            auto previous{0};
+            for (auto const d: ids) {
+                deltas.push_back(d - previous);
+                previous = d;
+            }
+            shard[token] = deltas;
+        }
+        index["shards"].push_back(prefix);
+        files.insert(prefix + ".json");
+        util::dump_to_file(fs::path{search_path}.append(prefix + ".json"), shard.dump());
+    }
+    util::dump_to_file(index_path, index.dump());
+
+    // shards of prefixes that no longer occur would be stale
+    for (auto const& entry: fs::directory_iterator(search_path)) {
+        if (entry.is_regular_file() && files.count(entry.path().filename().string()) == 0) {
+            fs::remove(entry.path());
+        }
+    }
+    std::vector<fs::path> shard_paths;
+    for (auto const& file: files) {
+        shard_paths.push_back(fs::path{search_path}.append(file));
+    }
+    store_manifest(manifest_entries(shard_paths, false));
+
+    store_export_signatures({"search"}, signature);
+
+    timestamp_end = util::make_timestamp();
+    duration_ms = util::time_between(timestamp_start, timestamp_end);
+    std::cout << std::setfill(' ') << std::setw(8) << documents.size() << " " << "node" << "  " << "documents indexed" << "\n"
+              << std::setfill(' ') << std::setw(8) << shards.size() << " " << "file" << "  " << "search shards" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create search index" << "\n" << std::flush;
+}
+
+// markers are clustered on a grid of map_cluster_size pixels, a cell contains exactly the four cells below it one zoom level deeper,
+// so every level is merged from the next deeper one; the tiles of a level hold the clusters whose cells lie in them
+auto Shashin::create_map_tiles() const -> void {
+    long long duration_ms{0};
+    auto timestamp_end{util::make_timestamp()};
+    auto timestamp_start{util::make_timestamp()};
+
+    auto const map_path{fs::path{m_config.cache_path()}.append(m_config.map_dir())};
+    auto const signature{export_signature()};
+    auto const signatures{load_export_signatures()};
+    auto const it{signatures.find("map")};
+    if (it != signatures.end() && it->second == signature && fs::exists(fs::path{map_path}.append("index.json"))) {
+        timestamp_end = util::make_timestamp();
+        duration_ms = util::time_between(timestamp_start, timestamp_end);
+        std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create map tiles (unchanged)" << "\n" << std::flush;
+        return;
+    }
+
+    // the R*Tree selects the located images, its 32 bit bounds are not precise enough for the markers themselves;
+    // a cluster is the sum of latitudes, sum of longitudes, count and the latest image as captured_at, node_hash, small_hash
+    using cluster_t = std::tuple<double, double, long long, std::string, std::string, std::string>;
+    using level_t = std::map<std::tuple<long long, long long>, cluster_t>;
+    auto const max_zoom{m_config.map_max_zoom()};
+    auto const cluster_size{double(m_config.map_cluster_size())};
+    std::vector<level_t> levels(size_t(max_zoom + 1));
+
+    long long count{0};
+    auto const query{std::string{R"sql(
         SELECT
-            i.path,
-            n.hash,
-            i.small,
-            i.medium,
-            i.large,
-            i.created_at,
-            i.updated_at,
+            i.gps_latitude,
+            i.gps_longitude,
             i.captured_at,
-            i.fstop,
-            i.exposure_time,
-            i.iso_speed,
-            i.exposure_bias,
-            i.flash,
-            i.metering_mode,
-            i.focal_length,
-            i.focal_length_35mm,
-            i.camera_make,
-            i.camera_model,
-            i.lens_make,
-            i.lens_model,
-            i.software,
-            i.description,
-            i.copyright,
-            i.gps
-        FROM images i INNER JOIN nodes n ON i.parent = n.path
-        ORDER BY i.parent, i.captured_at;
-    )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
+            n.hash,
+            i.small
+        FROM images_geo g
+        INNER JOIN images i ON i.id = g.id
+        INNER JOIN nodes n ON i.parent = n.path
+        WHERE )sql"} + published_images + R"sql(;
+    )sql"};
+    exec_transaction(query.c_str(), [this, &levels, &count, max_zoom, cluster_size](sqlite3_stmt* stmt) -> void {
         auto i{0};
         auto rc{0};
-        auto const extension{".jpg"};
+        auto& level{levels[size_t(max_zoom)]};
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
             i = -1;
-            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto latitude{sqlite3_column_double(stmt, ++i)};
+            auto longitude{sqlite3_column_double(stmt, ++i)};
+            auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto fstop{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto exposure_time{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto iso_speed{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto exposure_bias{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto flash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto metering_mode{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto focal_length{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto focal_length_35mm{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto camera_make{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto camera_model{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto lens_make{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto lens_model{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto software{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto description{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto copyright{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto gps{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-
-            auto const dst_path_small{fs::path{m_config.cache_path()}.append(hash).append(small + extension)};
-            auto const dst_path_medium{fs::path{m_config.cache_path()}.append(hash).append(medium + extension)};
-            auto const dst_path_large{fs::path{m_config.cache_path()}.append(hash).append(large + extension)};
-
-            fstop = fstop.size() > 0 ? "f/" + fstop : fstop;
-            exposure_bias = exposure_bias.size() > 0 ? exposure_bias + " EV" : exposure_bias;
-            focal_length = focal_length.size() > 0 ? focal_length + " mm" : focal_length;
-            focal_length_35mm = focal_length_35mm.size() > 0 ? focal_length_35mm + " mm" : focal_length_35mm;
 
-            ss << "<tr>" << "\n"
-               << "<td><nobr>" << path << "</nobr></td>" << "\n"
-               << "<td><nobr>" << hash << "</nobr></td>" << "\n"
-               << "<td><nobr><a href=\"" << dst_path_small.string() << "\">" << small << "</a></nobr></td>" << "\n"
-               << "<td><nobr><a href=\"" << dst_path_medium.string() << "\">" << medium << "</a></nobr></td>" << "\n"
-               << "<td><nobr><a href=\"" << dst_path_large.string() << "\">" << large << "</a></nobr></td>" << "\n"
-               << "<td><nobr>" << created_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << updated_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << captured_at << "</nobr></td>" << "\n"
-               << "<td><nobr>" << fstop << "</nobr></td>" << "\n"
-               << "<td><nobr>" << exposure_time << "</nobr></td>" << "\n"
-               << "<td><nobr>" << iso_speed << "</nobr></td>" << "\n"
-               << "<td><nobr>" << exposure_bias << "</nobr></td>" << "\n"
-               << "<td><nobr>" << flash << "</nobr></td>" << "\n"
-               << "<td><nobr>" << metering_mode << "</nobr></td>" << "\n"
-               << "<td><nobr>" << focal_length << "</nobr></td>" << "\n"
-               << "<td><nobr>" << focal_length_35mm << "</nobr></td>" << "\n"
-               << "<td><nobr>" << camera_make << "</nobr></td>" << "\n"
-               << "<td><nobr>" << camera_model << "</nobr></td>" << "\n"
-               << "<td><nobr>" << lens_make << "</nobr></td>" << "\n"
-               << "<td><nobr>" << lens_model << "</nobr></td>" << "\n"
-               << "<td><nobr>" << software << "</nobr></td>" << "\n"
-               << "<td><nobr>" << description << "</nobr></td>" << "\n"
-               << "<td><nobr>" << copyright << "</nobr></td>" << "\n"
-               << "<td><nobr>" << gps << "</nobr></td>" << "\n"
-               << "</tr>" << "\n";
+            auto const [x, y]{util::lat_lon_to_pixel(latitude, longitude, max_zoom, m_config.map_tile_size())};
+            auto const key{std::make_tuple(static_cast<long long>(x / cluster_size), static_cast<long long>(y / cluster_size))};
+            auto& [sum_latitude, sum_longitude, members, latest, node_hash, small_hash]{level[key]};
+            sum_latitude += latitude;
+            sum_longitude += longitude;
+            ++members;
+            if (members == 1 || captured_at > latest) {
+                latest = captured_at;
+                node_hash = hash;
+                small_hash = small;
+            }
+            ++count;
         }
         if (rc != SQLITE_DONE) {
             std::cerr << "Error: " << sqlite3_errmsg(m_db)
@@ -733,60 +4468,248 @@ auto Shashin::dump_list_html() const -> void {
                       << "\n";
         }
     });
-    ss << "</table>" << "\n";
 
-    std::ofstream ofs{fs::path{m_config.shashin_path()}.append("list.html")};
-    ofs << ss.str();
-    ofs.close();
+    for (auto zoom{max_zoom}; zoom > 0; --zoom) {
+        auto& parent_level{levels[size_t(zoom - 1)]};
+        for (auto const& [key, cluster]: levels[size_t(zoom)]) {
+            auto const& [sum_latitude, sum_longitude, members, latest, node_hash, small_hash]{cluster};
+            auto& parent{parent_level[{std::get<0>(key) / 2, std::get<1>(key) / 2}]};
+            auto const merged_members{std::get<2>(parent) + members};
+            if (std::get<2>(parent) == 0 || latest > std::get<3>(parent)) {
+                parent = {std::get<0>(parent), std::get<1>(parent), 0, latest, node_hash, small_hash};
+            }
+            std::get<0>(parent) += sum_latitude;
+            std::get<1>(parent) += sum_longitude;
+            std::get<2>(parent) = merged_members;
+        }
+    }
+
+    // the tiles are written next to the current ones and swapped in at the end, so the site never sees a half written level
+    auto const tmp_path{fs::path{m_config.cache_path()}.append(m_config.map_dir() + ".tmp")};
+    fs::remove_all(tmp_path);
+    auto const cells_per_tile{m_config.map_tile_size() / m_config.map_cluster_size()};
+    long long tiles{0};
+    for (auto zoom{0}; zoom <= max_zoom; ++zoom) {
+        std::map<std::tuple<long long, long long>, nlohmann::json> tile_markers;
+        for (auto const& [key, cluster]: levels[size_t(zoom)]) {
+            auto const& [sum_latitude, sum_longitude, members, latest, node_hash, small_hash]{cluster};
+            auto const latitude{std::round(sum_latitude / double(members) * 1e5) / 1e5};
+            auto const longitude{std::round(sum_longitude / double(members) * 1e5) / 1e5};
+            auto& markers{tile_markers[{std::get<0>(key) / cells_per_tile, std::get<1>(key) / cells_per_tile}]};
+            markers.push_back({latitude, longitude, members, node_hash, small_hash});
+        }
+        for (auto const& [tile, markers]: tile_markers) {
+            auto const dir{fs::path{tmp_path}.append(std::to_string(zoom)).append(std::to_string(std::get<0>(tile)))};
+            fs::create_directories(dir);
+            util::dump_to_file(fs::path{dir}.append(std::to_string(std::get<1>(tile)) + ".json"), markers.dump());
+            ++tiles;
+        }
+    }
+
+    auto index{nlohmann::json::object()};
+    index["max_zoom"] = max_zoom;
+    index["tile_size"] = m_config.map_tile_size();
+    index["cluster_size"] = m_config.map_cluster_size();
+    index["markers"] = count;
+    fs::create_directories(tmp_path);
+    util::dump_to_file(fs::path{tmp_path}.append("index.json"), index.dump());
+
+    // the current tiles are moved aside instead of deleted first, so there is no point at which the site has no map directory
+    // other than between the two renames; a map missing after a crash there is rebuilt by the next run
+    auto const old_path{fs::path{m_config.cache_path()}.append(m_config.map_dir() + ".old")};
+    fs::remove_all(old_path);
+    if (fs::exists(map_path)) {
+        fs::rename(map_path, old_path);
+    }
+    fs::rename(tmp_path, map_path);
+    util::sync_path(m_config.cache_path());
+    fs::remove_all(old_path);
+    store_manifest(manifest_entries(list_directory_recursive(map_path, [](fs::path const& path) -> bool { return fs::is_regular_file(path); }), false));
+
+    store_export_signatures({"map"}, signature);
 
     timestamp_end = util::make_timestamp();
     duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "dump list html" << "\n" << std::flush;
+    std::cout << std::setfill(' ') << std::setw(8) << count << " " << "img" << "  " << "map markers" << "\n"
+              << std::setfill(' ') << std::setw(8) << tiles << " " << "file" << "  " << "map tiles" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create map tiles" << "\n" << std::flush;
 }
 
-auto Shashin::process_images() const -> void {
+// gallery and image pages from the same rows as the gallery files, rendered in parallel per node;
+// a node is only rendered again when the signature of its context and the templates changed
+auto Shashin::create_pages() const -> void {
+    if (!m_config.pages()) {
+        return;
+    }
+
     long long duration_ms{0};
     auto timestamp_end{util::make_timestamp()};
     auto timestamp_start{util::make_timestamp()};
 
-    std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string, int, int, int, int, int, int, int, int>> images;
+    std::vector<std::tuple<util::Template, std::string>> compiled;
+    try {
+        compiled.push_back(load_template("gallery"));
+        compiled.push_back(load_template("image"));
+    } catch (std::exception const& e) {
+        std::cerr << "Error: " << e.what()
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+        return;
+    }
+    auto const& gallery_template{std::get<0>(compiled[0])};
+    auto const& image_template{std::get<0>(compiled[1])};
+    auto const templates_signature{std::get<1>(compiled[0]) + std::get<1>(compiled[1])};
 
+    auto const pages_path{fs::path{m_config.site_path()}.append(m_config.pages_dir())};
+    auto const page_url{[this](std::string const& url) -> std::string {
+        return "/" + m_config.pages_dir() + "/" + url + "/";
+    }};
+    auto const tier_url{[this](char const* const tier, std::string const& hash, std::string const& name) -> std::string {
+        return "/" + m_config.cache_dir() + "/" + tier + "/" + hash + "/" + name + ".jpg";
+    }};
+
+    // nodes in the order of their paths, parents before children
+    std::vector<nlohmann::json> nodes;
+    std::unordered_map<std::string, size_t> node_indices;
     exec_transaction(R"sql(
+        SELECT path, name, url, hash, captured_at, title, event, location, city, country
+        FROM nodes
+        ORDER BY depth, path;
+    )sql", [this, &nodes, &node_indices, &page_url](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        auto rc{0};
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            i = -1;
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto event{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto location{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto city{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto country{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+
+            node_indices[path] = nodes.size();
+            nodes.push_back({
+                {"path", path},
+                {"name", name},
+                {"url", url},
+                {"hash", hash},
+                {"page", page_url(url)},
+                {"captured_at", captured_at},
+                {"title", title},
+                {"event", event},
+                {"location", location},
+                {"city", city},
+                {"country", country},
+                {"children", nlohmann::json::array()},
+                {"images", nlohmann::json::array()},
+            });
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error: " << sqlite3_errmsg(m_db)
+                #ifdef SHASHIN_DEBUG
+                      << " [" << __FILE__ << ":" << __LINE__ << "]"
+                #endif
+                      << "\n";
+        }
+    });
+    for (auto& node: nodes) {
+        auto const it{node_indices.find(fs::path{node["path"].get<std::string>()}.parent_path().generic_string())};
+        if (it != node_indices.end()) {
+            auto& parent{nodes[it->second]};
+            node["parent"] = {{"page", parent["page"]}, {"name", parent["name"]}, {"title", parent["title"]}};
+            parent["children"].push_back({{"page", node["page"]}, {"name", node["name"]}, {"title", node["title"]}});
+        }
+    }
+
+    auto const query{std::string{R"sql(
         SELECT
-            i.path,
+            i.parent,
+            i.name,
             n.hash,
             i.small,
             i.medium,
             i.large,
-            i.width,
-            i.height,
-            i.large_width,
-            i.large_height,
+            i.small_width,
+            i.small_height,
             i.medium_width,
             i.medium_height,
-            i.small_width,
-            i.small_height
-        FROM images i INNER JOIN nodes n ON i.parent = n.path
+            i.large_width,
+            i.large_height,
+            i.dominant_color,)sql"} + exif_select + R"sql(
+        FROM images i INNER JOIN nodes n ON i.parent = n.path)sql" + exif_joins + R"sql(
+        WHERE )sql" + published_images + R"sql(
         ORDER BY i.parent, i.captured_at;
-    )sql", [this, &images](sqlite3_stmt* stmt) -> void {
+    )sql"};
+    // image pages share the directory with index.html and names like IMG_1.jpg and IMG_1.jpe or "a b.jpg" and a-b.jpg slug the same,
+    // so the slug gets the start of the small tier name, a salted hash of the image path, and all of it in the unlikely case that is taken
+    std::unordered_map<std::string, std::unordered_set<std::string>> page_names;
+    exec_transaction(query.c_str(), [this, &nodes, &node_indices, &tier_url, &page_names](sqlite3_stmt* stmt) -> void {
         auto i{0};
         auto rc{0};
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
             i = -1;
-            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto parent{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
             auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-            auto width{sqlite3_column_int(stmt, ++i)};
-            auto height{sqlite3_column_int(stmt, ++i)};
-            auto large_width{sqlite3_column_int(stmt, ++i)};
-            auto large_height{sqlite3_column_int(stmt, ++i)};
-            auto medium_width{sqlite3_column_int(stmt, ++i)};
-            auto medium_height{sqlite3_column_int(stmt, ++i)};
             auto small_width{sqlite3_column_int(stmt, ++i)};
             auto small_height{sqlite3_column_int(stmt, ++i)};
-            images.push_back({path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height});
+            auto medium_width{sqlite3_column_int(stmt, ++i)};
+            auto medium_height{sqlite3_column_int(stmt, ++i)};
+            auto large_width{sqlite3_column_int(stmt, ++i)};
+            auto large_height{sqlite3_column_int(stmt, ++i)};
+            auto dominant_color{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+            auto [captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, focal_length, focal_length_35mm, camera_make, camera_model, lens_make, lens_model, software, description, copyright, gps]{column_exif_strings(stmt, i)};
+
+            auto const it{node_indices.find(parent)};
+            if (it == node_indices.end()) {
+                continue;
+            }
+            auto const slug{util::string_to_url(fs::path{name}.stem().string())};
+            auto page{slug + "-" + small.substr(0, 8) + ".html"};
+            if (!page_names[parent].insert(page).second) {
+                page = slug + "-" + small + ".html";
+                page_names[parent].insert(page);
+            }
+            nodes[it->second]["images"].push_back({
+                {"name", name},
+                {"page", page},
+                {"small_url", tier_url("small", hash, small)},
+                {"medium_url", tier_url("medium", hash, medium)},
+                {"large_url", tier_url("large", hash, large)},
+                {"small_width", small_width},
+                {"small_height", small_height},
+                {"medium_width", medium_width},
+                {"medium_height", medium_height},
+                {"large_width", large_width},
+                {"large_height", large_height},
+                {"dominant_color", dominant_color},
+                {"captured_at", captured_at},
+                {"fstop", fstop.size() > 0 ? "f/" + fstop : fstop},
+                {"exposure_time", exposure_time},
+                {"iso_speed", iso_speed},
+                {"exposure_bias", exposure_bias.size() > 0 ? exposure_bias + " EV" : exposure_bias},
+                {"flash", flash},
+                {"metering_mode", metering_mode},
+                {"focal_length", focal_length.size() > 0 ? focal_length + " mm" : focal_length},
+                {"focal_length_35mm", focal_length_35mm.size() > 0 ? focal_length_35mm + " mm" : focal_length_35mm},
+                {"camera_make", camera_make},
+                {"camera_model", camera_model},
+                {"lens_make", lens_make},
+                {"lens_model", lens_model},
+                {"software", software},
+                {"description", description},
+                {"copyright", copyright},
+                {"gps", gps},
+            });
         }
         if (rc != SQLITE_DONE) {
             std::cerr << "Error: " << sqlite3_errmsg(m_db)
@@ -797,91 +4720,114 @@ auto Shashin::process_images() const -> void {
         }
     });
 
-    util::process_parallel([this, &images](int worker_number, int lower_bound, int upper_bound) {
-        (void)worker_number;
-        auto const extension{".jpg"};
-        auto percent{0};
-        for (auto i{lower_bound}; i < upper_bound; ++i) {
-            if (worker_number == 0) {
-                auto temp{int(double(i) / double(upper_bound) * 100) % 101};
-                if (temp > percent) {
-                    percent = temp;
-                    std::cout << "        " << "   " << "  " << std::setfill(' ') << std::setw(3) << percent << " " << "%" << "\n" << std::flush;
-                }
-            }
+    // the context of a node holds everything its pages show, so its signature tells whether they changed
+    auto const signatures{load_export_signatures()};
+    std::vector<std::tuple<std::string, std::string>> stored;
+    std::vector<size_t> changed;
+    std::unordered_set<std::string> names;
+    for (size_t k{0}; k < nodes.size(); ++k) {
+        auto const name{"page:" + nodes[k]["url"].get<std::string>()};
+        auto const signature{util::hash_to_hex_string(util::string_to_hash(nodes[k].dump() + templates_signature))};
+        auto const it{signatures.find(name)};
+        names.insert(name);
+        if (it != signatures.end() && it->second == signature && fs::exists(fs::path{pages_path}.append(nodes[k]["url"].get<std::string>()).append("index.html"))) {
+            continue;
+        }
+        changed.push_back(k);
+        stored.push_back({name, signature});
+    }
 
-            auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{images[size_t(i)]};
+    std::vector<std::tuple<std::string, long long, std::string, bool>> manifest;
+    std::vector<char> failed(changed.size(), 0);
+    util::process_parallel_dynamic([this, &nodes, &changed, &failed, &manifest, &pages_path, &gallery_template, &image_template](int worker_number, int lower_bound, int upper_bound) {
+        (void)worker_number;
+        for (auto c{lower_bound}; c < upper_bound; ++c) {
+            auto const& node{nodes[changed[size_t(c)]]};
+            auto const dir{fs::path{pages_path}.append(node["url"].get<std::string>())};
+            std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+            try {
+                fs::create_directories(dir);
+                std::vector<std::tuple<fs::path, std::string>> pages;
+                pages.push_back({fs::path{dir}.append("index.html"), gallery_template.render(node)});
 
-            auto const src_path{fs::path{m_config.gallery_path()}.append(path)};
-            auto const dst_path_small{fs::path{m_config.cache_path()}.append("small").append(hash).append(small + extension)};
-            auto const dst_path_medium{fs::path{m_config.cache_path()}.append("medium").append(hash).append(medium + extension)};
-            auto const dst_path_large{fs::path{m_config.cache_path()}.append("large").append(hash).append(large + extension)};
+                // an image page gets the node without its images, otherwise every page would hold the whole node
+                auto summary{node};
+                summary.erase("images");
+                summary.erase("children");
+                auto const& images{node["images"]};
+                for (size_t k{0}; k < images.size(); ++k) {
+                    nlohmann::json context{{"node", summary}, {"image", images[k]}};
+                    if (k > 0) {
+                        context["prev"] = images[k - 1];
+                    }
+                    if (k + 1 < images.size()) {
+                        context["next"] = images[k + 1];
+                    }
+                    pages.push_back({fs::path{dir}.append(images[k]["page"].get<std::string>()), image_template.render(context)});
+                }
 
-            if (!fs::exists(dst_path_small) || !fs::exists(dst_path_medium) || !fs::exists(dst_path_large)) {
-                cv::Mat src_mat{cv::imread(src_path)};
-                std::get<5>(images[size_t(i)]) = src_mat.size().width;
-                std::get<6>(images[size_t(i)]) = src_mat.size().height;
-
-                if (!fs::exists(dst_path_small) || (std::get<11>(images[size_t(i)]) == 0 || std::get<12>(images[size_t(i)]) == 0)) {
-                    try {
-                        util::crop(src_mat, dst_path_small, m_config.small_width(), m_config.small_height());
-                        std::get<11>(images[size_t(i)]) = m_config.small_width();
-                        std::get<12>(images[size_t(i)]) = m_config.small_height();
-                    } catch (std::exception const& e) {
-                        std::cerr << __FILE__ << ":" << __LINE__ << "\n"
-                                  << "file: " << src_path << "\n"
-                                  << e.what() << "\n"
-                                  << "\n";
-                        exit(0);
+                std::unordered_set<std::string> written;
+                for (auto const& [path, page]: pages) {
+                    if (!written.insert(path.filename().string()).second) {
+                        throw std::runtime_error(path.filename().string() + ": page name used twice");
                     }
                 }
-                if (!fs::exists(dst_path_medium) || (std::get<9>(images[size_t(i)]) == 0 || std::get<10>(images[size_t(i)]) == 0)) {
-                    util::resize(src_mat, dst_path_medium, m_config.medium_size(), m_config.watermark_text(), 24, 16, 4);
-                    cv::Mat tmp_mat{cv::imread(dst_path_medium)};
-                    std::get<9>(images[size_t(i)]) = tmp_mat.size().width;
-                    std::get<10>(images[size_t(i)]) = tmp_mat.size().height;
+                for (auto const& [path, page]: pages) {
+                    util::dump_to_file(path, page);
+                    entries.push_back(manifest_entry(path, std::vector<unsigned char>{page.begin(), page.end()}, false));
                 }
-                if (!fs::exists(dst_path_large) || (std::get<7>(images[size_t(i)]) == 0 || std::get<8>(images[size_t(i)]) == 0)) {
-                    util::resize(src_mat, dst_path_large, m_config.large_size(), m_config.watermark_text(), 36, 32, 6);
-                    cv::Mat tmp_mat{cv::imread(dst_path_large)};
-                    std::get<7>(images[size_t(i)]) = tmp_mat.size().width;
-                    std::get<8>(images[size_t(i)]) = tmp_mat.size().height;
+                // pages of images that left the node, the directories of child nodes stay
+                for (auto const& entry: fs::directory_iterator{dir}) {
+                    if (entry.is_regular_file() && entry.path().extension() == ".html" && written.count(entry.path().filename().string()) == 0) {
+                        fs::remove(entry.path());
+                    }
                 }
+            } catch (std::exception const& e) {
+                failed[size_t(c)] = 1;
+                std::lock_guard<std::mutex> lock{mtx};
+                std::cerr << "Error: " << e.what() << " (" << dir.string() << ")"
+                    #ifdef SHASHIN_DEBUG
+                          << " [" << __FILE__ << ":" << __LINE__ << "]"
+                    #endif
+                          << "\n";
+                continue;
             }
+            std::lock_guard<std::mutex> lock{mtx};
+            std::move(entries.begin(), entries.end(), std::back_inserter(manifest));
         }
-    }, int(images.size()));
-
-    exec_transaction(R"sql(
-        UPDATE images SET
-            width = ?,
-            height = ?,
-            large_width = ?,
-            large_height = ?,
-            medium_width = ?,
-            medium_height = ?,
-            small_width = ?,
-            small_height = ?,
-
-            updated_at = ?
-        WHERE path = ?;
-    )sql", [this, &images](sqlite3_stmt* stmt) -> void {
-        auto i{0};
-        for (auto const& image: images) {
-            auto [path, hash, small, medium, large, width, height, large_width, large_height, medium_width, medium_height, small_width, small_height]{image};
-
-            i = 0;
-            util::sqlite3_bind_int_or_null(stmt, ++i, width); // width
-            util::sqlite3_bind_int_or_null(stmt, ++i, height); // height
-            util::sqlite3_bind_int_or_null(stmt, ++i, large_width); // large_width
-            util::sqlite3_bind_int_or_null(stmt, ++i, large_height); // large_height
-            util::sqlite3_bind_int_or_null(stmt, ++i, medium_width); // medium_width
-            util::sqlite3_bind_int_or_null(stmt, ++i, medium_height); // medium_height
-            util::sqlite3_bind_int_or_null(stmt, ++i, small_width); // small_width
-            util::sqlite3_bind_int_or_null(stmt, ++i, small_height); // small_height
+    }, int(changed.size()));
 
-            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // updated_at
-            util::sqlite3_bind_string(stmt, ++i, path); // path
+    // a failed node keeps its old signature and is tried again by the next run
+    std::vector<std::tuple<std::string, std::string>> rendered;
+    for (size_t c{0}; c < changed.size(); ++c) {
+        if (!failed[c]) {
+            rendered.push_back(stored[c]);
+        }
+    }
+    store_export_signatures(rendered);
+    store_manifest(manifest);
 
+    // pages of nodes that are gone
+    std::vector<std::string> stale;
+    for (auto const& [name, signature]: signatures) {
+        if (name.compare(0, 5, "page:") == 0 && names.count(name) == 0) {
+            // only its own pages, a child node may still live below it
+            auto const dir{fs::path{pages_path}.append(name.substr(5))};
+            std::error_code ec;
+            for (auto const& entry: fs::directory_iterator{dir, ec}) {
+                if (entry.is_regular_file() && entry.path().extension() == ".html") {
+                    fs::remove(entry.path(), ec);
+                }
+            }
+            fs::remove(dir, ec);
+            stale.push_back(name);
+        }
+    }
+    exec_transaction(R"sql(
+        DELETE FROM exports WHERE name = ?;
+    )sql", [&stale](sqlite3_stmt* stmt) -> void {
+        for (auto const& name: stale) {
+            util::sqlite3_bind_string(stmt, 1, name); // name
             sqlite3_step(stmt);
             sqlite3_reset(stmt);
         }
@@ -889,252 +4835,157 @@ auto Shashin::process_images() const -> void {
 
     timestamp_end = util::make_timestamp();
     duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "process images" << "\n" << std::flush;
+    std::cout << std::setfill(' ') << std::setw(8) << rendered.size() << " " << "node" << "  " << "pages rendered" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create pages" << "\n" << std::flush;
 }
 
-auto Shashin::create_gallery_files() const -> void {
+// writes .gz and .br siblings of the text outputs for gzip_static and brotli_static, a file is only compressed again
+// when the hash of its content changed or a sibling is missing, e.g. because its directory was swapped in anew
+auto Shashin::compress_outputs() const -> void {
     long long duration_ms{0};
     auto timestamp_end{util::make_timestamp()};
     auto timestamp_start{util::make_timestamp()};
 
-    // nodes
-    {
-        std::stringstream ss;
-        ss << "\"" << "hash" << "\"" << ","
-           << "\"" << "path" << "\"" << ","
-           << "\"" << "depth" << "\"" << ","
-           << "\"" << "name" << "\"" << ","
-           << "\"" << "url" << "\"" << ","
-           << "\"" << "captured_at" << "\"" << ","
-           << "\"" << "title" << "\"" << ","
-           << "\"" << "event" << "\"" << ","
-           << "\"" << "location" << "\"" << ","
-           << "\"" << "city" << "\"" << ","
-           << "\"" << "country" << "\"" << "\n";
-        exec_transaction(R"sql(
-            SELECT
-                depth,
-                path,
-                created_at,
-                updated_at,
-                name,
-                url,
-                hash,
-                captured_at,
-                title,
-                event,
-                location,
-                city,
-                country
-            FROM nodes
-            ORDER BY depth, path, captured_at, title;
-        )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
-            auto i{0};
-            auto rc{0};
-            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-                i = -1;
-                auto depth{sqlite3_column_int(stmt, ++i)};
-                auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto name{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto url{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto title{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto event{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto location{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto city{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto country{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
+    auto const compressions{util::compressions_available()};
+    auto const is_sibling{[&compressions](fs::path const& path) -> bool {
+        return std::any_of(compressions.begin(), compressions.end(), [&path](util::Compression compression) -> bool {
+            return path.extension().string() == util::compression_extension(compression);
+        });
+    }};
 
-                ss << "\"" << hash << "\"" << ","
-                   << "\"" << path << "\"" << ","
-                   << "\"" << depth << "\"" << ","
-                   << "\"" << name << "\"" << ","
-                   << "\"" << url << "\"" << ","
-                   << "\"" << captured_at << "\"" << ","
-                   << "\"" << title << "\"" << ","
-                   << "\"" << event << "\"" << ","
-                   << "\"" << location << "\"" << ","
-                   << "\"" << city << "\"" << ","
-                   << "\"" << country << "\"" << "\n";
-            }
-            if (rc != SQLITE_DONE) {
-                std::cerr << "Error: " << sqlite3_errmsg(m_db)
-                    #ifdef SHASHIN_DEBUG
-                          << " [" << __FILE__ << ":" << __LINE__ << "]"
-                    #endif
-                          << "\n";
+    // the outputs, siblings whose original is gone are removed on the way
+    std::vector<fs::path> paths;
+    auto const collect{[&paths, &is_sibling](fs::path const& base, std::set<std::string> const& extensions) -> void {
+        if (!fs::is_directory(base)) {
+            return;
+        }
+        for (auto const& path: list_directory_recursive(base, [](fs::path const& path) -> bool { return fs::is_regular_file(path); })) {
+            if (is_sibling(path)) {
+                std::error_code ec;
+                if (!fs::exists(fs::path{path}.replace_extension(), ec)) {
+                    fs::remove(path, ec);
+                }
+            } else if (extensions.count(path.extension().string()) > 0) {
+                paths.push_back(path);
             }
-        });
-        util::dump_to_file(fs::path{m_config.data_path()}.append("nodes.csv"), ss.str());
+        }
+    }};
+    collect(m_config.data_path(), {".csv", ".json"});
+    collect(fs::path{m_config.cache_path()}.append(m_config.search_dir()), {".json"});
+    collect(fs::path{m_config.cache_path()}.append(m_config.map_dir()), {".json"});
+    collect(fs::path{m_config.site_path()}.append(m_config.pages_dir()), {".html"});
+    auto const list_path{fs::path{m_config.shashin_path()}.append("list.html")};
+    if (fs::exists(list_path)) {
+        paths.push_back(list_path);
     }
 
-    // images
-    {
-        std::stringstream ss;
-        ss << "\"" << "node_hash" << "\"" << ","
-           << "\"" << "small_hash" << "\"" << ","
-           << "\"" << "medium_hash" << "\"" << ","
-           << "\"" << "large_hash" << "\"" << ","
-           << "\"" << "small_path" << "\"" << ","
-           << "\"" << "medium_path" << "\"" << ","
-           << "\"" << "large_path" << "\"" << ","
-           << "\"" << "width" << "\"" << ","
-           << "\"" << "height" << "\"" << ","
-           << "\"" << "large_width" << "\"" << ","
-           << "\"" << "large_height" << "\"" << ","
-           << "\"" << "medium_width" << "\"" << ","
-           << "\"" << "medium_height" << "\"" << ","
-           << "\"" << "small_width" << "\"" << ","
-           << "\"" << "small_height" << "\"" << ","
-           << "\"" << "captured_at" << "\"" << ","
-           << "\"" << "fstop" << "\"" << ","
-           << "\"" << "exposure_time" << "\"" << ","
-           << "\"" << "iso_speed" << "\"" << ","
-           << "\"" << "exposure_bias" << "\"" << ","
-           << "\"" << "flash" << "\"" << ","
-           << "\"" << "metering_mode" << "\"" << ","
-           << "\"" << "focal_length" << "\"" << ","
-           << "\"" << "focal_length_35mm" << "\"" << ","
-           << "\"" << "camera_make" << "\"" << ","
-           << "\"" << "camera_model" << "\"" << ","
-           << "\"" << "lens_make" << "\"" << ","
-           << "\"" << "lens_model" << "\"" << ","
-           << "\"" << "software" << "\"" << ","
-           << "\"" << "description" << "\"" << ","
-           << "\"" << "copyright" << "\"" << ","
-           << "\"" << "gps" << "\"" << "\n";
-        exec_transaction(R"sql(
-            SELECT
-                i.path,
-                n.hash,
-                i.small,
-                i.medium,
-                i.large,
-                i.width,
-                i.height,
-                i.large_width,
-                i.large_height,
-                i.medium_width,
-                i.medium_height,
-                i.small_width,
-                i.small_height,
-                i.created_at,
-                i.updated_at,
-                i.captured_at,
-                i.fstop,
-                i.exposure_time,
-                i.iso_speed,
-                i.exposure_bias,
-                i.flash,
-                i.metering_mode,
-                i.focal_length,
-                i.focal_length_35mm,
-                i.camera_make,
-                i.camera_model,
-                i.lens_make,
-                i.lens_model,
-                i.software,
-                i.description,
-                i.copyright,
-                i.gps
-            FROM images i INNER JOIN nodes n ON i.parent = n.path
-            ORDER BY i.parent, i.captured_at;
-        )sql", [this, &ss](sqlite3_stmt* stmt) -> void {
-            auto i{0};
-            auto rc{0};
-            auto const extension{".jpg"};
-            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-                i = -1;
-                auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto hash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto small{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto medium{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto large{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto width{sqlite3_column_int(stmt, ++i)};
-                auto height{sqlite3_column_int(stmt, ++i)};
-                auto large_width{sqlite3_column_int(stmt, ++i)};
-                auto large_height{sqlite3_column_int(stmt, ++i)};
-                auto medium_width{sqlite3_column_int(stmt, ++i)};
-                auto medium_height{sqlite3_column_int(stmt, ++i)};
-                auto small_width{sqlite3_column_int(stmt, ++i)};
-                auto small_height{sqlite3_column_int(stmt, ++i)};
-                auto created_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto updated_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto captured_at{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto fstop{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto exposure_time{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto iso_speed{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto exposure_bias{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto flash{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto metering_mode{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto focal_length{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto focal_length_35mm{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto camera_make{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto camera_model{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto lens_make{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto lens_model{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto software{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto description{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto copyright{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-                auto gps{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, ++i))}};
-
-                auto const dst_path_small{"/" + fs::path{m_config.cache_dir()}.append("small").append(hash).append(small + extension).string()};
-                auto const dst_path_medium{"/" + fs::path{m_config.cache_dir()}.append("medium").append(hash).append(medium + extension).string()};
-                auto const dst_path_large{"/" + fs::path{m_config.cache_dir()}.append("large").append(hash).append(large + extension).string()};
+    // keyed by the path below the project, so moving the project keeps the hashes valid
+    auto const relative{[this](fs::path const& path) -> std::string {
+        return path.lexically_relative(m_config.project_path()).generic_string();
+    }};
+    std::unordered_map<std::string, std::string> hashes;
+    exec_transaction(R"sql(
+        SELECT path, hash FROM compressed;
+    )sql", [&hashes](sqlite3_stmt* stmt) -> void {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            auto path{std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 0))}};
+            hashes[path] = std::string{reinterpret_cast<char const* const>(sqlite3_column_text(stmt, 1))};
+        }
+    });
 
-                gps = std::regex_replace(gps, std::regex(R"raw(°)raw"), "&deg;");
-                gps = std::regex_replace(gps, std::regex(R"raw(")raw"), "&quot;");
-                gps = std::regex_replace(gps, std::regex(R"raw(')raw"), "&apos;");
+    std::vector<std::tuple<std::string, std::string>> compressed;
+    std::vector<std::tuple<std::string, long long, std::string, bool>> manifest;
+    std::vector<std::string> errors;
+    // the list is a local overview that is never deployed, so its siblings stay out of the manifest like the list itself
+    util::process_parallel_dynamic([this, &paths, &compressions, &relative, &hashes, &compressed, &manifest, &errors, &list_path](int worker_number, int lower_bound, int upper_bound) {
+        (void)worker_number;
+        auto const batch{std::vector<fs::path>(paths.begin() + lower_bound, paths.begin() + upper_bound)};
+        auto const contents{util::read_files(batch, m_config.io_backend())};
+        for (size_t i{0}; i < batch.size(); ++i) {
+            auto const& [data, error]{contents[i]};
+            if (error.size() > 0) {
+                std::lock_guard<std::mutex> lock{mtx};
+                errors.push_back(error);
+                continue;
+            }
 
-                ss << "\"" << hash << "\"" << ","
-                   << "\"" << small<< "\"" << ","
-                   << "\"" << medium << "\"" << ","
-                   << "\"" << large << "\"" << ","
-                   << "\"" << dst_path_small << "\"" << ","
-                   << "\"" << dst_path_medium << "\"" << ","
-                   << "\"" << dst_path_large << "\"" << ","
-                   << "\"" << width << "\"" << ","
-                   << "\"" << height << "\"" << ","
-                   << "\"" << large_width << "\"" << ","
-                   << "\"" << large_height << "\"" << ","
-                   << "\"" << medium_width << "\"" << ","
-                   << "\"" << medium_height << "\"" << ","
-                   << "\"" << small_width << "\"" << ","
-                   << "\"" << small_height << "\"" << ","
-                   << "\"" << captured_at << "\"" << ","
-                   << "\"" << fstop << "\"" << ","
-                   << "\"" << exposure_time << "\"" << ","
-                   << "\"" << iso_speed << "\"" << ","
-                   << "\"" << exposure_bias << "\"" << ","
-                   << "\"" << flash << "\"" << ","
-                   << "\"" << metering_mode << "\"" << ","
-                   << "\"" << focal_length << "\"" << ","
-                   << "\"" << focal_length_35mm << "\"" << ","
-                   << "\"" << camera_make << "\"" << ","
-                   << "\"" << camera_model << "\"" << ","
-                   << "\"" << lens_make << "\"" << ","
-                   << "\"" << lens_model << "\"" << ","
-                   << "\"" << software << "\"" << ","
-                   << "\"" << description << "\"" << ","
-                   << "\"" << copyright << "\"" << ","
-                   << "\"" << gps << "\"" << "\n";
+            auto const name{relative(batch[i])};
+            auto const hash{util::hash_to_hex_string(util::string_to_hash(std::string{data.begin(), data.end()}))};
+            auto const it{hashes.find(name)};
+            auto const complete{std::all_of(compressions.begin(), compressions.end(), [&batch, i](util::Compression compression) -> bool {
+                return fs::exists(fs::path{batch[i]}.concat(util::compression_extension(compression)));
+            })};
+            if (it != hashes.end() && it->second == hash && complete) {
+                continue;
             }
-            if (rc != SQLITE_DONE) {
-                std::cerr << "Error: " << sqlite3_errmsg(m_db)
-                    #ifdef SHASHIN_DEBUG
-                          << " [" << __FILE__ << ":" << __LINE__ << "]"
-                    #endif
-                          << "\n";
+
+            try {
+                std::vector<std::tuple<std::string, long long, std::string, bool>> entries;
+                for (auto const compression: compressions) {
+                    auto const sibling_path{fs::path{batch[i]}.concat(util::compression_extension(compression))};
+                    auto const bytes{util::compress(data, compression)};
+                    util::write_file_atomic(sibling_path, reinterpret_cast<char const*>(bytes.data()), bytes.size());
+                    if (batch[i] != list_path) {
+                        entries.push_back(manifest_entry(sibling_path, bytes, false));
+                    }
+                }
+                std::lock_guard<std::mutex> lock{mtx};
+                compressed.push_back({name, hash});
+                std::move(entries.begin(), entries.end(), std::back_inserter(manifest));
+            } catch (std::exception const& e) {
+                std::lock_guard<std::mutex> lock{mtx};
+                errors.push_back(batch[i].string() + ": " + e.what());
             }
-        });
-        util::dump_to_file(fs::path{m_config.data_path()}.append("images.csv"), ss.str());
+        }
+    }, int(paths.size()), 16);
+
+    for (auto const& error: errors) {
+        std::cerr << "Error: " << error
+            #ifdef SHASHIN_DEBUG
+                  << " [" << __FILE__ << ":" << __LINE__ << "]"
+            #endif
+                  << "\n";
+    }
+
+    exec_transaction(R"sql(
+        INSERT INTO compressed (created_at, path, hash)
+        VALUES (?,?,?)
+        ON CONFLICT(path) DO UPDATE SET created_at=excluded.created_at, hash=excluded.hash;
+    )sql", [this, &compressed](sqlite3_stmt* stmt) -> void {
+        auto i{0};
+        for (auto const& [path, hash]: compressed) {
+            i = 0;
+            util::sqlite3_bind_string(stmt, ++i, m_config.current_time()); // created_at
+            util::sqlite3_bind_string(stmt, ++i, path); // path
+            util::sqlite3_bind_string(stmt, ++i, hash); // hash
+
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+    });
+    store_manifest(manifest);
+
+    // rows of outputs that no longer exist
+    std::unordered_set<std::string> names;
+    for (auto const& path: paths) {
+        names.insert(relative(path));
     }
+    exec_transaction(R"sql(
+        DELETE FROM compressed WHERE path = ?;
+    )sql", [&hashes, &names](sqlite3_stmt* stmt) -> void {
+        for (auto const& [path, hash]: hashes) {
+            if (names.count(path) == 0) {
+                util::sqlite3_bind_string(stmt, 1, path); // path
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        }
+    });
 
     timestamp_end = util::make_timestamp();
     duration_ms = util::time_between(timestamp_start, timestamp_end);
-    std::cout << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "create gallery files" << "\n" << std::flush;
+    std::cout << std::setfill(' ') << std::setw(8) << compressed.size() << " " << "file" << "  " << "outputs compressed" << "\n"
+              << std::setfill(' ') << std::setw(8) << duration_ms << " " << "ms" << "  " << "compress outputs" << "\n" << std::flush;
 }
 
 } // namespace shashin
@@ -0,0 +1,82 @@
+#include <shashin/util/compress.h>
+#include <stdexcept>
+#include <zlib.h>
+#if SHASHIN_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace shashin {
+namespace util {
+
+auto compression_extension(Compression compression) -> std::string {
+    switch (compression) {
+        case Compression::gzip: return ".gz";
+        case Compression::brotli: return ".br";
+    }
+    return "";
+}
+
+auto compressions_available() -> std::vector<Compression> {
+#if SHASHIN_BROTLI
+    return {Compression::gzip, Compression::brotli};
+#else
+    return {Compression::gzip};
+#endif
+}
+
+static auto compress_gzip(std::vector<unsigned char> const& data) -> std::vector<unsigned char> {
+    z_stream zs{};
+    // 16 added to the window bits writes a gzip instead of a zlib header
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Failed to initialize gzip compression");
+    }
+
+    std::vector<unsigned char> buffer(deflateBound(&zs, uLong(data.size())));
+    zs.next_in = const_cast<Bytef*>(data.data());
+    zs.avail_in = uInt(data.size());
+    zs.next_out = buffer.data();
+    zs.avail_out = uInt(buffer.size());
+    auto const rc{deflate(&zs, Z_FINISH)};
+    auto const size{zs.total_out};
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) {
+        throw std::runtime_error("Failed to compress with gzip");
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+
+#if SHASHIN_BROTLI
+static auto compress_brotli(std::vector<unsigned char> const& data) -> std::vector<unsigned char> {
+    auto size{BrotliEncoderMaxCompressedSize(data.size())};
+    if (size == 0) {
+        throw std::runtime_error("Failed to compress with brotli: input too large");
+    }
+
+    std::vector<unsigned char> buffer(size);
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(), data.data(), &size, buffer.data())) {
+        throw std::runtime_error("Failed to compress with brotli");
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+#endif
+
+auto compress(std::vector<unsigned char> const& data, Compression compression) -> std::vector<unsigned char> {
+    switch (compression) {
+        case Compression::gzip:
+            return compress_gzip(data);
+        case Compression::brotli:
+#if SHASHIN_BROTLI
+            return compress_brotli(data);
+#else
+            break;
+#endif
+    }
+    throw std::runtime_error("Failed to compress: " + compression_extension(compression) + " is not compiled in");
+}
+
+} // namespace util
+} // namespace shashin
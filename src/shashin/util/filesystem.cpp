@@ -1,5 +1,11 @@
 #include <shashin/util/filesystem.h>
 #include <vector>
+#include <fstream>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 auto list_directory_recursive(fs::path const& base, std::function<bool(fs::path const& path)> const& condition) -> std::vector<fs::path> {
     std::vector<fs::path> paths;
@@ -7,3 +13,85 @@ auto list_directory_recursive(fs::path const& base, std::function<bool(fs::path
     std::copy_if(begin(it), end(it), std::back_inserter(paths), condition);
     return paths;
 }
+
+namespace shashin {
+namespace util {
+
+auto sync_path(fs::path const& path) -> bool {
+#if defined(__unix__) || defined(__APPLE__)
+    auto const fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd < 0) {
+        return false;
+    }
+    auto const synced{fsync(fd) == 0};
+    close(fd);
+    return synced;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+auto write_file_atomic(fs::path const& path, char const* data, std::size_t size, bool sync_directory) -> void {
+    auto tmp_path{path};
+    tmp_path += ".tmp";
+
+    std::ofstream ofs{tmp_path, std::ios::binary | std::ios::trunc};
+    if (!ofs) {
+        throw std::runtime_error("Failed to open file: " + tmp_path.string());
+    }
+    ofs.write(data, static_cast<std::streamsize>(size));
+    ofs.close();
+    if (!ofs) {
+        fs::remove(tmp_path);
+        throw std::runtime_error("Failed to write file: " + tmp_path.string());
+    }
+    // without it a crash may leave an empty file under the final name
+    if (!sync_path(tmp_path)) {
+        fs::remove(tmp_path);
+        throw std::runtime_error("Failed to sync file: " + tmp_path.string());
+    }
+
+    fs::rename(tmp_path, path);
+    if (sync_directory) {
+        sync_path(path.parent_path());
+    }
+}
+
+auto link_file_atomic(fs::path const& target, fs::path const& path) -> void {
+    auto tmp_path{path};
+    tmp_path += ".tmp";
+
+    std::error_code ec;
+    fs::remove(tmp_path, ec);
+    fs::create_hard_link(target, tmp_path, ec);
+    if (ec) {
+        fs::copy_file(target, tmp_path, fs::copy_options::overwrite_existing, ec);
+    }
+    if (ec) {
+        throw std::runtime_error("Failed to link file: " + path.string() + " (" + ec.message() + ")");
+    }
+    if (!sync_path(tmp_path)) {
+        fs::remove(tmp_path, ec);
+        throw std::runtime_error("Failed to sync file: " + tmp_path.string());
+    }
+
+    fs::rename(tmp_path, path);
+    sync_path(path.parent_path());
+}
+
+auto file_stat(fs::path const& path) -> std::tuple<long long, long long> {
+    std::error_code ec;
+    auto const size{fs::file_size(path, ec)};
+    if (ec) {
+        return {-1, -1};
+    }
+    auto const mtime{fs::last_write_time(path, ec)};
+    if (ec) {
+        return {-1, -1};
+    }
+    return {static_cast<long long>(size), static_cast<long long>(std::chrono::duration_cast<std::chrono::seconds>(mtime.time_since_epoch()).count())};
+}
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,22 @@
+#include <shashin/util/geo.h>
+#include <algorithm>
+#include <cmath>
+
+namespace shashin {
+namespace util {
+
+auto lat_lon_to_pixel(double latitude, double longitude, int zoom, int tile_size) -> std::tuple<double, double> {
+    auto const pi{3.14159265358979323846};
+    auto const world{double(tile_size) * double(1LL << zoom)};
+
+    // the projection is cut off where the map becomes square
+    auto const lat{std::max(-85.05112878, std::min(85.05112878, latitude))};
+    auto const sin_lat{std::sin(lat * pi / 180.0)};
+
+    auto const x{(longitude + 180.0) / 360.0 * world};
+    auto const y{(0.5 - std::log((1.0 + sin_lat) / (1.0 - sin_lat)) / (4.0 * pi)) * world};
+    return {std::max(0.0, std::min(world - 1.0, x)), std::max(0.0, std::min(world - 1.0, y))};
+}
+
+} // namespace util
+} // namespace shashin
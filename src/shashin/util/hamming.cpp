@@ -0,0 +1,184 @@
+#include <shashin/util/hamming.h>
+#include <shashin/util/parallel.h>
+#include <algorithm>
+#include <bitset>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+
+namespace shashin {
+namespace util {
+
+static constexpr int chunk_count{4};
+static constexpr int chunk_bits{16};
+
+static auto chunk(std::uint64_t hash, int c) -> std::uint16_t {
+    return std::uint16_t(hash >> (c * chunk_bits));
+}
+
+auto hamming_distance(std::uint64_t a, std::uint64_t b) -> int {
+    return int(std::bitset<64>(a ^ b).count());
+}
+
+HammingIndex::HammingIndex(int distance)
+    : m_distance{distance}
+    , m_buckets(std::size_t(chunk_count) << chunk_bits)
+{
+    auto const chunk_distance{std::min(std::max(distance, 0) / chunk_count, chunk_bits)};
+    for (std::uint32_t mask{0}; mask < (1u << chunk_bits); ++mask) {
+        if (int(std::bitset<chunk_bits>(mask).count()) <= chunk_distance) {
+            m_masks.push_back(std::uint16_t(mask));
+        }
+    }
+}
+
+auto HammingIndex::insert(std::uint64_t hash) -> std::size_t {
+    auto const id{m_hashes.size()};
+    m_hashes.push_back(hash);
+    for (auto c{0}; c < chunk_count; ++c) {
+        m_buckets[std::size_t(c) << chunk_bits | chunk(hash, c)].push_back(std::uint32_t(id));
+    }
+    return id;
+}
+
+auto HammingIndex::hash(std::size_t id) const -> std::uint64_t {
+    return m_hashes[id];
+}
+
+auto HammingIndex::size() const -> std::size_t {
+    return m_hashes.size();
+}
+
+auto HammingIndex::find(std::uint64_t hash) const -> std::vector<std::size_t> {
+    // a hash close in several chunks shows up in several buckets
+    std::vector<std::tuple<int, std::size_t>> found;
+    for (auto c{0}; c < chunk_count; ++c) {
+        auto const value{chunk(hash, c)};
+        for (auto const mask: m_masks) {
+            for (auto const id: m_buckets[std::size_t(c) << chunk_bits | std::uint16_t(value ^ mask)]) {
+                auto const distance{hamming_distance(hash, m_hashes[id])};
+                if (distance <= m_distance) {
+                    found.push_back({distance, id});
+                }
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+
+    std::vector<std::size_t> ids;
+    ids.reserve(found.size());
+    for (auto const& [distance, id]: found) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+auto hamming_clusters(std::vector<std::uint64_t> const& hashes, int distance) -> std::vector<std::vector<std::size_t>> {
+    auto const chunk_distance{std::min(std::max(distance, 0) / chunk_count, chunk_bits)};
+    std::vector<std::uint16_t> masks;
+    for (std::uint32_t mask{0}; mask < (1u << chunk_bits); ++mask) {
+        if (int(std::bitset<chunk_bits>(mask).count()) <= chunk_distance) {
+            masks.push_back(std::uint16_t(mask));
+        }
+    }
+
+    // all hashes are known up front, so every chunk gets a counting sorted copy of the hashes with ids ascending per bucket
+    std::vector<std::vector<std::uint32_t>> offsets(chunk_count, std::vector<std::uint32_t>((1u << chunk_bits) + 1, 0));
+    std::vector<std::vector<std::uint64_t>> sorted_hashes(chunk_count, std::vector<std::uint64_t>(hashes.size()));
+    std::vector<std::vector<std::uint32_t>> sorted_ids(chunk_count, std::vector<std::uint32_t>(hashes.size()));
+    for (auto c{0}; c < chunk_count; ++c) {
+        auto& offset{offsets[size_t(c)]};
+        for (auto const hash: hashes) {
+            ++offset[std::size_t(chunk(hash, c)) + 1];
+        }
+        std::partial_sum(offset.begin(), offset.end(), offset.begin());
+        auto next{offset};
+        for (std::size_t id{0}; id < hashes.size(); ++id) {
+            auto const position{next[chunk(hashes[id], c)]++};
+            sorted_hashes[size_t(c)][position] = hashes[id];
+            sorted_ids[size_t(c)][position] = std::uint32_t(id);
+        }
+    }
+
+    // buckets are joined with their neighbours as a whole instead of looking up every hash on its own, which keeps them in cache;
+    // a pair is taken from the first chunk that is close enough, so it is found exactly once without any deduplication
+    std::vector<std::tuple<std::uint32_t, std::uint32_t>> pairs;
+    std::mutex pairs_mutex;
+    for (auto c{0}; c < chunk_count; ++c) {
+        auto const& offset{offsets[size_t(c)]};
+        auto const& chunk_hashes{sorted_hashes[size_t(c)]};
+        auto const& chunk_ids{sorted_ids[size_t(c)]};
+        process_parallel([&masks, &offset, &chunk_hashes, &chunk_ids, &pairs, &pairs_mutex, c, distance, chunk_distance](int worker_number, int lower_bound, int upper_bound) {
+            (void)worker_number;
+            std::vector<std::tuple<std::uint32_t, std::uint32_t>> found;
+            for (auto value{std::uint32_t(lower_bound)}; value < std::uint32_t(upper_bound); ++value) {
+                for (auto const mask: masks) {
+                    auto const other_value{value ^ mask};
+                    for (auto k{offset[value]}; k < offset[value + 1]; ++k) {
+                        auto const hash{chunk_hashes[k]};
+                        auto const id{chunk_ids[k]};
+                        // ids ascend within a bucket, smaller ones were paired from the other side
+                        auto const last{offset[other_value + 1]};
+                        auto l{std::uint32_t(std::upper_bound(chunk_ids.begin() + offset[other_value], chunk_ids.begin() + last, id) - chunk_ids.begin())};
+                        for (; l < last; ++l) {
+                            if (hamming_distance(hash, chunk_hashes[l]) > distance) {
+                                continue;
+                            }
+                            auto first{true};
+                            for (auto earlier{0}; earlier < c && first; ++earlier) {
+                                first = int(std::bitset<chunk_bits>(chunk(hash ^ chunk_hashes[l], earlier)).count()) > chunk_distance;
+                            }
+                            if (first) {
+                                found.push_back({id, chunk_ids[l]});
+                            }
+                        }
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock{pairs_mutex};
+            pairs.insert(pairs.end(), found.begin(), found.end());
+        }, 1 << chunk_bits);
+    }
+
+    // union find with path halving, the smallest id becomes the root
+    std::vector<std::size_t> parents(hashes.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    auto const root{[&parents](std::size_t id) -> std::size_t {
+        while (parents[id] != id) {
+            parents[id] = parents[parents[id]];
+            id = parents[id];
+        }
+        return id;
+    }};
+    for (auto const& [i, j]: pairs) {
+        auto const a{root(i)};
+        auto const b{root(j)};
+        if (a != b) {
+            parents[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    // ids sorted by their root, clusters come out in the order of their smallest id
+    std::vector<std::tuple<std::size_t, std::size_t>> members;
+    for (std::size_t id{0}; id < hashes.size(); ++id) {
+        members.push_back({root(id), id});
+    }
+    std::sort(members.begin(), members.end());
+    std::vector<std::vector<std::size_t>> clusters;
+    for (std::size_t first{0}, last{0}; first < members.size(); first = last) {
+        while (last < members.size() && std::get<0>(members[last]) == std::get<0>(members[first])) {
+            ++last;
+        }
+        if (last - first > 1) {
+            clusters.emplace_back();
+            for (auto k{first}; k < last; ++k) {
+                clusters.back().push_back(std::get<1>(members[k]));
+            }
+        }
+    }
+    return clusters;
+}
+
+} // namespace util
+} // namespace shashin
@@ -0,0 +1,220 @@
+#include <shashin/util/http.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace shashin {
+namespace util {
+
+auto mime_type(std::string const& path) -> std::string {
+    static std::unordered_map<std::string, std::string> const types{
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".png", "image/png"},
+        {".webp", "image/webp"},
+        {".svg", "image/svg+xml"},
+        {".html", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"},
+        {".json", "application/json"},
+        {".csv", "text/csv; charset=utf-8"},
+        {".dzi", "application/xml"},
+        {".xml", "application/xml"},
+    };
+    auto const dot{path.find_last_of('.')};
+    if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+        auto extension{path.substr(dot)};
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        auto const it{types.find(extension)};
+        if (it != types.end()) {
+            return it->second;
+        }
+    }
+    return "application/octet-stream";
+}
+
+auto url_decode_path(std::string const& target) -> std::string {
+    auto const end{std::min(target.find('?'), target.find('#'))};
+    std::string path;
+    for (size_t i{0}; i < std::min(end, target.size()); ++i) {
+        if (target[i] == '%' && i + 2 < target.size() && std::isxdigit(static_cast<unsigned char>(target[i + 1])) && std::isxdigit(static_cast<unsigned char>(target[i + 2]))) {
+            path += char(std::stoi(target.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            path += target[i];
+        }
+    }
+    return path;
+}
+
+#ifndef _WIN32
+static auto reason_phrase(int status) -> char const* {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+    }
+    return "Unknown";
+}
+
+static auto send_all(int fd, char const* data, size_t size) -> bool {
+    while (size > 0) {
+        auto const sent{::send(fd, data, size, MSG_NOSIGNAL)};
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= size_t(sent);
+    }
+    return true;
+}
+
+// the loopback address alone does not keep other sites out, a page whose name was rebound to 127.0.0.1
+// sends its own name as the host, so only the loopback names are answered
+static auto is_local_host(std::string const& head) -> bool {
+    std::istringstream lines{head};
+    std::string line;
+    while (std::getline(lines, line) && line != "\r") {
+        auto const colon{line.find(':')};
+        if (colon == std::string::npos) {
+            continue;
+        }
+        auto name{line.substr(0, colon)};
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        if (name != "host") {
+            continue;
+        }
+        std::string host;
+        std::istringstream{line.substr(colon + 1)} >> host;
+        std::transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        auto const port{host.rfind(':')};
+        if (port != std::string::npos && host.find(']', port) == std::string::npos) {
+            host = host.substr(0, port);
+        }
+        return host == "127.0.0.1" || host == "localhost";
+    }
+    return false;
+}
+
+// reads the request head only, GET and HEAD have no body; one request per connection
+static auto handle_connection(int fd, std::function<HttpResponse(std::string const& path)> const& handler) -> void {
+    std::string head;
+    char buffer[4096];
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < 16384) {
+        auto const received{::recv(fd, buffer, sizeof(buffer), 0)};
+        if (received <= 0) {
+            return;
+        }
+        head.append(buffer, size_t(received));
+    }
+
+    std::string method;
+    std::string target;
+    std::istringstream{head.substr(0, head.find("\r\n"))} >> method >> target;
+
+    HttpResponse response;
+    if (method != "GET" && method != "HEAD") {
+        response = {405, "text/plain", {}};
+    } else if (target.empty() || target[0] != '/') {
+        response = {400, "text/plain", {}};
+    } else if (!is_local_host(head)) {
+        response = {403, "text/plain", {}};
+    } else {
+        try {
+            response = handler(url_decode_path(target));
+        } catch (std::exception const& e) {
+            std::string const message{e.what()};
+            response = {500, "text/plain", {message.begin(), message.end()}};
+        }
+    }
+
+    auto const& [status, content_type, body]{response};
+    std::stringstream ss;
+    ss << "HTTP/1.1 " << status << " " << reason_phrase(status) << "\r\n"
+       << "Content-Type: " << content_type << "\r\n"
+       << "Content-Length: " << body.size() << "\r\n"
+       << "Cache-Control: no-cache" << "\r\n"
+       << "Connection: close" << "\r\n"
+       << "\r\n";
+    auto const header{ss.str()};
+    if (send_all(fd, header.data(), header.size()) && method != "HEAD") {
+        send_all(fd, reinterpret_cast<char const*>(body.data()), body.size());
+    }
+}
+
+auto serve_http(int port, std::function<HttpResponse(std::string const& path)> const& handler, std::function<bool()> const& stop) -> void {
+    auto const listener{::socket(AF_INET, SOCK_STREAM, 0)};
+    if (listener < 0) {
+        throw std::runtime_error("Failed to create socket");
+    }
+    auto const reuse{1};
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0) {
+        ::close(listener);
+        throw std::runtime_error("Failed to listen on 127.0.0.1:" + std::to_string(port));
+    }
+
+    std::vector<std::thread> connections;
+    std::atomic<int> active{0};
+    while (!stop()) {
+        // finished connections are joined whenever none is open, so a long session does not pile up threads
+        if (active.load() == 0) {
+            for (auto& connection: connections) {
+                connection.join();
+            }
+            connections.clear();
+        }
+
+        pollfd pfd{listener, POLLIN, 0};
+        if (::poll(&pfd, 1, 250) <= 0 || (pfd.revents & POLLIN) == 0) {
+            continue;
+        }
+        auto const fd{::accept(listener, nullptr, nullptr)};
+        if (fd < 0) {
+            continue;
+        }
+        ++active;
+        connections.push_back(std::thread([fd, &handler, &active]() {
+            handle_connection(fd, handler);
+            ::close(fd);
+            --active;
+        }));
+    }
+
+    ::close(listener);
+    for (auto& connection: connections) {
+        connection.join();
+    }
+}
+#else
+auto serve_http(int port, std::function<HttpResponse(std::string const& path)> const& handler, std::function<bool()> const& stop) -> void {
+    (void)port;
+    (void)handler;
+    (void)stop;
+    throw std::runtime_error("Failed to serve: not supported on this platform");
+}
+#endif
+
+} // namespace util
+} // namespace shashin
@@ -1,6 +1,11 @@
 #include <shashin/util/image.h>
+#include <shashin/util/jpeg.h>
 #include <shashin/util/string.h>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
 #include <exception>
 #include <regex>
 #include <easyexif/exif.h>
@@ -15,9 +20,13 @@ namespace util {
 auto fix_datetime(std::string& input) -> void;
 auto fix_camera_make(std::string& input) -> void;
 auto fix_camera_model(std::string& input) -> void;
-auto fix_exposure_time(std::string& input) -> void;
 auto fix_lens_model(std::string& input) -> void;
 auto metering_mode_to_string(int metering_mode) -> std::string;
+auto srgb_to_linear(int value) -> double;
+auto linear_to_srgb(double value) -> int;
+auto base83(int value, int length) -> std::string;
+auto blurhash(cv::Mat const& mat, int x_components, int y_components) -> std::string;
+auto dominant_color(cv::Mat const& mat) -> std::string;
 
 auto fix_datetime(std::string& input) -> void {
     if (input.size() >= 10) {
@@ -58,12 +67,6 @@ auto fix_camera_model(std::string& input) -> void {
     }
 }
 
-auto fix_exposure_time(std::string& input) -> void {
-    if (input == "1/inf") {
-        input = "";
-    }
-}
-
 auto fix_lens_model(std::string& input) -> void {
     input = std::regex_replace(input, std::regex("\\.0"), "");
     input = std::regex_replace(input, std::regex("(EF(\\-S)?)( ?)(.*)"), "$1 $4");
@@ -83,6 +86,103 @@ auto metering_mode_to_string(int metering_mode) -> std::string {
     }
 }
 
+auto srgb_to_linear(int value) -> double {
+    auto const v{double(value) / 255.0};
+    return (v <= 0.04045) ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+auto linear_to_srgb(double value) -> int {
+    auto const v{std::max(0.0, std::min(1.0, value))};
+    return (v <= 0.0031308) ? int(v * 12.92 * 255.0 + 0.5) : int((1.055 * std::pow(v, 1.0 / 2.4) - 0.055) * 255.0 + 0.5);
+}
+
+auto base83(int value, int length) -> std::string {
+    static char const* const alphabet{"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~"};
+    std::string output(size_t(length), '0');
+    for (auto i{length - 1}; i >= 0; --i) {
+        output[size_t(i)] = alphabet[value % 83];
+        value /= 83;
+    }
+    return output;
+}
+
+// https://github.com/woltapp/blurhash/blob/master/Algorithm.md
+auto blurhash(cv::Mat const& mat, int x_components, int y_components) -> std::string {
+    auto const pi{3.14159265358979323846};
+    std::vector<double> factors(size_t(x_components * y_components * 3), 0.0);
+    for (auto j{0}; j < y_components; ++j) {
+        for (auto i{0}; i < x_components; ++i) {
+            auto* factor{&factors[size_t((j * x_components + i) * 3)]};
+            for (auto y{0}; y < mat.rows; ++y) {
+                auto const* row{mat.ptr<cv::Vec3b>(y)};
+                auto const basis_y{std::cos(pi * j * y / mat.rows)};
+                for (auto x{0}; x < mat.cols; ++x) {
+                    auto const basis{std::cos(pi * i * x / mat.cols) * basis_y};
+                    factor[0] += basis * srgb_to_linear(row[x][2]);
+                    factor[1] += basis * srgb_to_linear(row[x][1]);
+                    factor[2] += basis * srgb_to_linear(row[x][0]);
+                }
+            }
+            auto const scale{((i == 0 && j == 0) ? 1.0 : 2.0) / double(mat.rows * mat.cols)};
+            factor[0] *= scale;
+            factor[1] *= scale;
+            factor[2] *= scale;
+        }
+    }
+
+    std::string hash{base83((x_components - 1) + (y_components - 1) * 9, 1)};
+
+    auto maximum_value{1.0};
+    if (factors.size() > 3) {
+        auto const actual_maximum{std::abs(*std::max_element(factors.begin() + 3, factors.end(), [](double a, double b) { return std::abs(a) < std::abs(b); }))};
+        auto const quantised_maximum{int(std::max(0.0, std::min(82.0, std::floor(actual_maximum * 166.0 - 0.5))))};
+        maximum_value = double(quantised_maximum + 1) / 166.0;
+        hash += base83(quantised_maximum, 1);
+    } else {
+        hash += base83(0, 1);
+    }
+
+    hash += base83((linear_to_srgb(factors[0]) << 16) + (linear_to_srgb(factors[1]) << 8) + linear_to_srgb(factors[2]), 4);
+
+    auto const quantise{[maximum_value](double value) -> int {
+        auto const v{value / maximum_value};
+        auto const sign_pow{std::copysign(std::pow(std::abs(v), 0.5), v)};
+        return int(std::max(0.0, std::min(18.0, std::floor(sign_pow * 9.0 + 9.5))));
+    }};
+    for (size_t k{3}; k < factors.size(); k += 3) {
+        hash += base83(quantise(factors[k]) * 19 * 19 + quantise(factors[k + 1]) * 19 + quantise(factors[k + 2]), 2);
+    }
+    return hash;
+}
+
+// the most frequent color after reducing every channel to 4 bit, averaged over the pixels in that bucket
+auto dominant_color(cv::Mat const& mat) -> std::string {
+    std::vector<int> counts(4096, 0);
+    std::vector<std::tuple<long long, long long, long long>> sums(4096, {0, 0, 0});
+    for (auto y{0}; y < mat.rows; ++y) {
+        auto const* row{mat.ptr<cv::Vec3b>(y)};
+        for (auto x{0}; x < mat.cols; ++x) {
+            auto const bucket{size_t((row[x][2] >> 4) << 8 | (row[x][1] >> 4) << 4 | (row[x][0] >> 4))};
+            ++counts[bucket];
+            std::get<0>(sums[bucket]) += row[x][2];
+            std::get<1>(sums[bucket]) += row[x][1];
+            std::get<2>(sums[bucket]) += row[x][0];
+        }
+    }
+
+    auto const bucket{size_t(std::max_element(counts.begin(), counts.end()) - counts.begin())};
+    if (counts[bucket] == 0) {
+        return "";
+    }
+    auto const [r, g, b]{sums[bucket]};
+    std::stringstream ss;
+    ss << "#" << std::hex << std::setfill('0')
+       << std::setw(2) << r / counts[bucket]
+       << std::setw(2) << g / counts[bucket]
+       << std::setw(2) << b / counts[bucket];
+    return ss.str();
+}
+
 auto watermark(cv::Mat& mat, std::string const& text, int fontsize, int margin, int thickness) -> void {
     if (text.size() == 0) {
         return;
@@ -105,79 +205,289 @@ auto watermark(cv::Mat& mat, std::string const& text, int fontsize, int margin,
     }
 }
 
-auto resize(cv::Mat& src_mat, fs::path const& dst_path, int size, std::string const& text, int fontsize, int margin, int thickness) -> void {
-    if (!fs::exists(dst_path.parent_path())) {
-        fs::create_directories(dst_path.parent_path());
+auto resize(cv::Mat const& src_mat, int size, std::string const& text, int fontsize, int margin, int thickness) -> cv::Mat {
+    // INTER_AREA is meant for shrinking, sources that fit are only watermarked
+    if (std::max(src_mat.cols, src_mat.rows) <= size) {
+        auto dst_mat{src_mat.clone()};
+        watermark(dst_mat, text, fontsize, margin, thickness);
+        return dst_mat;
     }
 
-    try {
-        auto const width{(src_mat.cols > src_mat.rows) ? size : int(std::ceil(double(size) * (double(src_mat.cols) / double(src_mat.rows))))};
-        auto const height{(src_mat.cols > src_mat.rows) ? int(std::ceil(double(size) * (double(src_mat.rows) / double(src_mat.cols)))) : size};
+    auto const width{(src_mat.cols > src_mat.rows) ? size : int(std::ceil(double(size) * (double(src_mat.cols) / double(src_mat.rows))))};
+    auto const height{(src_mat.cols > src_mat.rows) ? int(std::ceil(double(size) * (double(src_mat.rows) / double(src_mat.cols)))) : size};
+
+    cv::Mat dst_mat;
+    cv::resize(src_mat, dst_mat, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    watermark(dst_mat, text, fontsize, margin, thickness);
+    return dst_mat;
+}
+
+auto crop(cv::Mat const& src_mat, int cropped_width, int cropped_height, std::string const& text, int fontsize, int margin, int thickness) -> cv::Mat {
+    auto const ratio{std::min(double(src_mat.cols) / double(cropped_width), double(src_mat.rows) / double(cropped_height))};
+    auto const width{int(std::ceil(src_mat.cols / ratio))};
+    auto const height{int(std::ceil(src_mat.rows / ratio))};
+
+    cv::Mat dst_mat;
+    cv::resize(src_mat, dst_mat, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    cv::Rect roi;
+    roi.x = std::max(0, int(0.5 * double(width - cropped_width)));
+    roi.y = std::max(0, int(0.5 * double(height - cropped_height)));
+    roi.width = cropped_width;
+    roi.height = cropped_height;
+    //std::cerr << roi.x << "," << roi.y << " " << roi.width << "x" << roi.height << " " << width << "x" << height << "\n";
+    cv::Mat dst2_mat{dst_mat(roi)};
+    watermark(dst2_mat, text, fontsize, margin, thickness);
+    return dst2_mat;
+}
+
+auto encode_jpeg(cv::Mat const& mat, int quality) -> std::vector<unsigned char> {
+    std::vector<int> const params{{
+        cv::IMWRITE_JPEG_QUALITY, quality,
+        cv::IMWRITE_JPEG_PROGRESSIVE, 1,
+        cv::IMWRITE_JPEG_OPTIMIZE, 1,
+    }};
+
+    std::vector<unsigned char> buffer;
+    if (!cv::imencode(".jpg", mat, buffer, params)) {
+        throw std::runtime_error("Failed to encode image");
+    }
+    return buffer;
+}
+
+// the behaviour of encode_jpeg, subsampling and trellis quantization cannot be chosen through imencode
+class OpencvEncoder : public Encoder {
+public:
+    auto encode(cv::Mat const& mat, EncoderSettings const& settings) -> std::vector<unsigned char> override {
         std::vector<int> const params{{
-            cv::IMWRITE_JPEG_QUALITY, 80,
-            cv::IMWRITE_JPEG_PROGRESSIVE, 1,
-            cv::IMWRITE_JPEG_OPTIMIZE, 1,
+            cv::IMWRITE_JPEG_QUALITY, settings.quality,
+            cv::IMWRITE_JPEG_PROGRESSIVE, settings.progressive ? 1 : 0,
+            cv::IMWRITE_JPEG_OPTIMIZE, settings.optimize ? 1 : 0,
         }};
 
-        cv::Mat dst_mat{cv::imread(dst_path)};
-        cv::resize(src_mat, dst_mat, cv::Size(width, height), 0, 0, cv::INTER_AREA);
-        watermark(dst_mat, text, fontsize, margin, thickness);
-        cv::imwrite(dst_path, dst_mat, params);
-    } catch (std::exception const& e) {
-        std::cerr << "Error: " << e.what()
-            #ifdef SHASHIN_DEBUG
-                  << " [" << __FILE__ << ":" << __LINE__ << "]"
-            #endif
-                  << "\n";
+        std::vector<unsigned char> buffer;
+        if (!cv::imencode(".jpg", mat, buffer, params)) {
+            throw std::runtime_error("Failed to encode image");
+        }
+        return buffer;
+    }
+};
+
+auto encoder_backend_name(EncoderBackend backend) -> std::string {
+    switch (backend) {
+        case EncoderBackend::opencv: return "opencv";
+        case EncoderBackend::libjpeg: return "libjpeg";
+        default: return "unknown";
     }
 }
 
-auto crop(cv::Mat& src_mat, fs::path const& dst_path, int cropped_width, int cropped_height, std::string const& text, int fontsize, int margin, int thickness) -> void {
-    if (!fs::exists(dst_path.parent_path())) {
-        fs::create_directories(dst_path.parent_path());
+auto encoder_backend_default() -> EncoderBackend {
+#if SHASHIN_LIBJPEG
+    return EncoderBackend::libjpeg;
+#else
+    return EncoderBackend::opencv;
+#endif
+}
+
+auto make_encoder(EncoderBackend backend) -> std::unique_ptr<Encoder> {
+    if (backend == EncoderBackend::libjpeg) {
+        if (auto encoder{make_libjpeg_encoder()}) {
+            return encoder;
+        }
     }
+    return std::make_unique<OpencvEncoder>();
+}
 
-    try {
-        auto const ratio{std::min(double(src_mat.cols) / double(cropped_width), double(src_mat.rows) / double(cropped_height))};
-        auto const width{int(std::ceil(src_mat.cols / ratio))};
-        auto const height{int(std::ceil(src_mat.rows / ratio))};
-        std::vector<int> const params{{
-            cv::IMWRITE_JPEG_QUALITY, 80,
-            cv::IMWRITE_JPEG_PROGRESSIVE, 1,
-            cv::IMWRITE_JPEG_OPTIMIZE, 1,
-        }};
+auto ssim(cv::Mat const& a, cv::Mat const& b) -> double {
+    // whole image operations of OpenCV are vectorized, the window is the usual 11x11 gaussian with sigma 1.5
+    auto const luma{[](cv::Mat const& mat) -> cv::Mat {
+        cv::Mat gray;
+        if (mat.channels() == 3) {
+            cv::cvtColor(mat, gray, cv::COLOR_BGR2GRAY);
+        } else {
+            gray = mat;
+        }
+        cv::Mat dst;
+        gray.convertTo(dst, CV_32F);
+        return dst;
+    }};
+    auto const blur{[](cv::Mat const& mat) -> cv::Mat {
+        cv::Mat dst;
+        cv::GaussianBlur(mat, dst, cv::Size(11, 11), 1.5);
+        return dst;
+    }};
+    auto const c1{6.5025}; // (0.01 * 255)^2
+    auto const c2{58.5225}; // (0.03 * 255)^2
 
-        cv::Mat dst_mat{cv::imread(dst_path)};
-        cv::resize(src_mat, dst_mat, cv::Size(width, height), 0, 0, cv::INTER_AREA);
-        cv::Rect roi;
-        roi.x = std::max(0, int(0.5 * double(width - cropped_width)));
-        roi.y = std::max(0, int(0.5 * double(height - cropped_height)));
-        roi.width = cropped_width;
-        roi.height = cropped_height;
-        //std::cerr << roi.x << "," << roi.y << " " << roi.width << "x" << roi.height << " " << width << "x" << height << "\n";
-        cv::Mat dst2_mat{dst_mat(roi)};
-        watermark(dst2_mat, text, fontsize, margin, thickness);
-        cv::imwrite(dst_path, dst2_mat, params);
-    } catch (std::exception const& e) {
-        std::cerr << "Error: " << e.what()
-            #ifdef SHASHIN_DEBUG
-                  << " [" << __FILE__ << ":" << __LINE__ << "]"
-            #endif
-                  << "\n";
+    auto const x{luma(a)};
+    auto const y{luma(b)};
+    cv::Mat const mu_x{blur(x)};
+    cv::Mat const mu_y{blur(y)};
+    cv::Mat const mu_xx{mu_x.mul(mu_x)};
+    cv::Mat const mu_yy{mu_y.mul(mu_y)};
+    cv::Mat const mu_xy{mu_x.mul(mu_y)};
+    cv::Mat const sigma_xx{blur(x.mul(x)) - mu_xx};
+    cv::Mat const sigma_yy{blur(y.mul(y)) - mu_yy};
+    cv::Mat const sigma_xy{blur(x.mul(y)) - mu_xy};
+
+    cv::Mat numerator{(2 * mu_xy + c1).mul(2 * sigma_xy + c2)};
+    cv::Mat denominator{(mu_xx + mu_yy + c1).mul(sigma_xx + sigma_yy + c2)};
+    cv::Mat map;
+    cv::divide(numerator, denominator, map);
+    return cv::mean(map)[0];
+}
+
+auto encode_jpeg_targeted(Encoder& encoder, cv::Mat const& mat, EncoderSettings settings, double target_ssim, int min_quality, int max_quality, int crop_size, int crop_count) -> std::tuple<std::vector<unsigned char>, int> {
+    // the search runs on crops at the resolution of the tier, so blocking and ringing show up as they will in the tier;
+    // the crops are spread over a grid and start on 16 pixel boundaries, their blocks are the blocks of the full encoding
+    std::vector<cv::Rect> rects;
+    auto const width{std::min(crop_size, mat.cols)};
+    auto const height{std::min(crop_size, mat.rows)};
+    auto const grid{std::max(1, int(std::ceil(std::sqrt(double(crop_count)))))};
+    for (auto i{0}; i < std::max(1, crop_count); ++i) {
+        auto const x{int(double(mat.cols - width) * (i % grid + 0.5) / grid) / 16 * 16};
+        auto const y{int(double(mat.rows - height) * (i / grid + 0.5) / grid) / 16 * 16};
+        cv::Rect const rect{x, y, width, height};
+        if (std::find(rects.begin(), rects.end(), rect) == rects.end()) {
+            rects.push_back(rect);
+        }
+    }
+
+    auto low{min_quality};
+    auto high{max_quality};
+    while (low < high) {
+        settings.quality = (low + high) / 2;
+        auto const reached{std::all_of(rects.begin(), rects.end(), [&encoder, &mat, &settings, target_ssim](cv::Rect const& rect) -> bool {
+            cv::Mat const crop{mat(rect)};
+            return ssim(crop, decode_image(encoder.encode(crop, settings))) >= target_ssim;
+        })};
+        if (reached) {
+            high = settings.quality;
+        } else {
+            low = settings.quality + 1;
+        }
+    }
+    settings.quality = high;
+    return {encoder.encode(mat, settings), high};
+}
+
+auto decode_image(std::vector<unsigned char> const& buffer) -> cv::Mat {
+    if (buffer.size() == 0) {
+        throw std::runtime_error("Failed to decode image: empty file");
+    }
+    cv::Mat mat{cv::imdecode(cv::Mat(1, int(buffer.size()), CV_8UC1, const_cast<unsigned char*>(buffer.data())), cv::IMREAD_COLOR)};
+    if (mat.empty()) {
+        throw std::runtime_error("Failed to decode image");
+    }
+    return mat;
+}
+
+auto placeholders(cv::Mat const& mat) -> std::tuple<std::string, std::string, std::string> {
+    // everything works on copies of a few pixels, so the cost does not depend on the tier size
+    auto const scale{32.0 / double(std::max(mat.cols, mat.rows))};
+    cv::Mat thumbnail_mat;
+    cv::resize(mat, thumbnail_mat, cv::Size(std::max(1, int(mat.cols * scale)), std::max(1, int(mat.rows * scale))), 0, 0, cv::INTER_AREA);
+
+    cv::Mat lqip_mat;
+    cv::resize(mat, lqip_mat, cv::Size(16, std::max(1, int(std::round(16.0 * double(mat.rows) / double(mat.cols))))), 0, 0, cv::INTER_AREA);
+    std::vector<int> const params{{
+        cv::IMWRITE_JPEG_QUALITY, 40,
+        cv::IMWRITE_JPEG_OPTIMIZE, 1,
+    }};
+    std::vector<unsigned char> buffer;
+    if (!cv::imencode(".jpg", lqip_mat, buffer, params)) {
+        throw std::runtime_error("Failed to encode placeholder");
     }
+
+    return {blurhash(thumbnail_mat, 4, 3), "data:image/jpeg;base64," + base64_encode(buffer.data(), buffer.size()), dominant_color(thumbnail_mat)};
+}
+
+auto perceptual_hash(cv::Mat const& mat) -> std::uint64_t {
+    // the 8x8 lowest frequencies of a 32x32 thumbnail, each bit tells whether a coefficient is above their median
+    cv::Mat gray_mat;
+    if (mat.channels() == 3) {
+        cv::cvtColor(mat, gray_mat, cv::COLOR_BGR2GRAY);
+    } else {
+        gray_mat = mat;
+    }
+    cv::Mat thumbnail_mat;
+    cv::resize(gray_mat, thumbnail_mat, cv::Size(32, 32), 0, 0, cv::INTER_AREA);
+    cv::Mat float_mat;
+    thumbnail_mat.convertTo(float_mat, CV_32F);
+    cv::Mat dct_mat;
+    cv::dct(float_mat, dct_mat);
+
+    std::vector<float> coefficients;
+    for (auto y{0}; y < 8; ++y) {
+        auto const row{dct_mat.ptr<float>(y)};
+        coefficients.insert(coefficients.end(), row, row + 8);
+    }
+    // the DC term only carries the brightness, it is left out of the median
+    auto sorted{std::vector<float>(coefficients.begin() + 1, coefficients.end())};
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    auto const median{sorted[sorted.size() / 2]};
+
+    std::uint64_t hash{0};
+    for (size_t i{0}; i < coefficients.size(); ++i) {
+        if (coefficients[i] > median) {
+            hash |= std::uint64_t(1) << i;
+        }
+    }
+    return hash;
+}
+
+auto sprite_sheet(std::vector<cv::Mat> const& tiles, int columns, cv::Size const& tile_size) -> cv::Mat {
+    auto const rows{(int(tiles.size()) + columns - 1) / columns};
+    cv::Mat sheet_mat(rows * tile_size.height, std::min(int(tiles.size()), columns) * tile_size.width, CV_8UC3, cv::Scalar::all(0));
+    for (size_t i{0}; i < tiles.size(); ++i) {
+        cv::Mat roi_mat{sheet_mat(cv::Rect(int(i) % columns * tile_size.width, int(i) / columns * tile_size.height, tile_size.width, tile_size.height))};
+        if (tiles[i].size() == tile_size) {
+            tiles[i].copyTo(roi_mat);
+        } else {
+            cv::resize(tiles[i], roi_mat, tile_size, 0, 0, cv::INTER_AREA);
+        }
+    }
+    return sheet_mat;
 }
 
-auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, double, double> {
+auto tile_rect(cv::Size const& level_size, int tile_size, int overlap, int col, int row) -> cv::Rect {
+    auto const x{col * tile_size - (col > 0 ? overlap : 0)};
+    auto const y{row * tile_size - (row > 0 ? overlap : 0)};
+    auto const width{std::min(level_size.width, (col + 1) * tile_size + overlap) - x};
+    auto const height{std::min(level_size.height, (row + 1) * tile_size + overlap) - y};
+    return {x, y, width, height};
+}
+
+auto deepzoom_next_level(cv::Mat const& level_mat) -> cv::Mat {
+    cv::Mat dst_mat;
+    cv::resize(level_mat, dst_mat, cv::Size((level_mat.cols + 1) / 2, (level_mat.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+    return dst_mat;
+}
+
+auto deepzoom_manifest(cv::Size const& size, int tile_size, int overlap) -> std::string {
+    std::stringstream ss;
+    ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << "\n"
+       << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"" << tile_size << "\" Overlap=\"" << overlap << "\" Format=\"jpg\">" << "\n"
+       << "  <Size Width=\"" << size.width << "\" Height=\"" << size.height << "\"/>" << "\n"
+       << "</Image>" << "\n";
+    return ss.str();
+}
+
+auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, double, double, int, double, int, int, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, int, double, double, double> {
+    auto buffer{util::stackoverflow::load_file_binary(path)};
+    return exif_info(reinterpret_cast<unsigned char const*>(buffer.data()), buffer.size());
+}
+
+auto exif_info(unsigned char const* data, std::size_t size) -> std::tuple<bool, std::string, double, double, int, double, int, int, std::string, std::string, std::string, std::string, std::string, std::string, std::string, double, int, double, double, double> {
     // https://exiftool.org/TagNames/EXIF.html
 
     bool exif{false};
     std::string captured_at;
-    std::string fstop;
-    std::string exposure_time;
-    std::string iso_speed;
-    std::string exposure_bias;
-    std::string flash;
-    std::string metering_mode;
+    double fstop{0};
+    double exposure_time{0};
+    int iso_speed{0};
+    double exposure_bias{0};
+    int flash{0};
+    int metering_mode{0};
     std::string camera_make;
     std::string camera_model;
     std::string lens_make;
@@ -185,27 +495,34 @@ auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, std::strin
     std::string copyright;
     std::string description;
     std::string software;
-    std::string focal_length;
-    std::string focal_length_35mm;
-    std::string gps;
+    double focal_length{0};
+    int focal_length_35mm{0};
     double gps_latitude{0};
     double gps_longitude{0};
     double gps_altitude{0};
 
-    auto buffer{util::stackoverflow::load_file_binary(path)};
+    // TIFF based RAW files start with the structure a JPEG wraps into its EXIF segment
     easyexif::EXIFInfo exif_info;
-    if (exif_info.parseFrom(reinterpret_cast<unsigned char const* const>(buffer.data()), static_cast<unsigned int>(buffer.size())) == 0) {
+    auto rc{PARSE_EXIF_ERROR_NO_EXIF};
+    if (size >= 4 && (std::memcmp(data, "II*\0", 4) == 0 || std::memcmp(data, "MM\0*", 4) == 0)) {
+        std::vector<unsigned char> segment{'E', 'x', 'i', 'f', 0, 0};
+        segment.insert(segment.end(), data, data + size);
+        rc = exif_info.parseFromEXIFSegment(segment.data(), static_cast<unsigned int>(segment.size()));
+    } else {
+        rc = exif_info.parseFrom(data, static_cast<unsigned int>(size));
+    }
+    if (rc == PARSE_EXIF_SUCCESS) {
         exif = true;
 
         captured_at = exif_info.DateTimeDigitized;
-        fstop = double_to_string(exif_info.FNumber, 1);
-        exposure_time = "1/" + double_to_string(1.0 / exif_info.ExposureTime);
-        iso_speed = int_to_string(exif_info.ISOSpeedRatings);
-        exposure_bias = double_to_string(exif_info.ExposureBiasValue, 1);
-        flash = exif_info.Flash ? "on" : "off";
-        metering_mode = metering_mode_to_string(exif_info.MeteringMode);
-        focal_length = double_to_string(exif_info.FocalLength);
-        focal_length_35mm = double_to_string(exif_info.FocalLengthIn35mm);
+        fstop = exif_info.FNumber;
+        exposure_time = exif_info.ExposureTime;
+        iso_speed = exif_info.ISOSpeedRatings;
+        exposure_bias = exif_info.ExposureBiasValue;
+        flash = exif_info.Flash ? 1 : 0;
+        metering_mode = exif_info.MeteringMode;
+        focal_length = exif_info.FocalLength;
+        focal_length_35mm = exif_info.FocalLengthIn35mm;
         camera_make = exif_info.Make;
         camera_model = exif_info.Model;
         lens_make = exif_info.LensInfo.Make;
@@ -213,21 +530,6 @@ auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, std::strin
         copyright = exif_info.Copyright;
         description = exif_info.ImageDescription;
         software = exif_info.Software;
-        gps = [&exif_info]() -> std::string {
-            auto& lat{exif_info.GeoLocation.LatComponents};
-            auto& lon{exif_info.GeoLocation.LonComponents};
-            std::stringstream ss;
-            ss << std::fixed << std::setw(1) << std::setprecision(0) << lat.degrees << "°"
-               << std::fixed << std::setw(1) << std::setprecision(0) << lat.minutes << "'"
-               << std::fixed << std::setw(1) << std::setprecision(0) << lat.seconds << "\""
-               << " " << lat.direction
-               << " "
-               << std::fixed << std::setw(1) << std::setprecision(0) << lon.degrees << "°"
-               << std::fixed << std::setw(1) << std::setprecision(0) << lon.minutes << "'"
-               << std::fixed << std::setw(1) << std::setprecision(0) << lon.seconds << "\""
-               << " " << lon.direction;
-            return ss.str();
-        }();
         gps_latitude = exif_info.GeoLocation.Latitude;
         gps_longitude = exif_info.GeoLocation.Longitude;
         gps_altitude = exif_info.GeoLocation.Altitude;
@@ -235,18 +537,71 @@ auto exif_info(fs::path const& path) -> std::tuple<bool, std::string, std::strin
         fix_datetime(captured_at);
         fix_camera_make(camera_make);
         fix_camera_model(camera_model);
-        fix_exposure_time(exposure_time);
         fix_lens_model(lens_model);
-        make_zero_empty(fstop);
-        make_zero_empty(exposure_bias);
-        make_zero_empty(iso_speed);
-        make_zero_empty(focal_length);
-        make_zero_empty(focal_length_35mm);
-        remove_precision(fstop);
-        stackoverflow::trim(gps);
     }
 
-    return {exif, captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, camera_make, camera_model, lens_make, lens_model, copyright, description, software, focal_length, focal_length_35mm, gps, gps_latitude, gps_longitude, gps_altitude};
+    return {exif, captured_at, fstop, exposure_time, iso_speed, exposure_bias, flash, metering_mode, camera_make, camera_model, lens_make, lens_model, copyright, description, software, focal_length, focal_length_35mm, gps_latitude, gps_longitude, gps_altitude};
+}
+
+auto format_fstop(double fstop) -> std::string {
+    auto str{double_to_string(fstop, 1)};
+    make_zero_empty(str);
+    remove_precision(str);
+    return str;
+}
+
+auto format_exposure_time(double exposure_time) -> std::string {
+    if (exposure_time <= 0) {
+        return "";
+    }
+    return "1/" + double_to_string(1.0 / exposure_time);
+}
+
+auto format_iso_speed(int iso_speed) -> std::string {
+    auto str{int_to_string(iso_speed)};
+    make_zero_empty(str);
+    return str;
+}
+
+auto format_exposure_bias(double exposure_bias) -> std::string {
+    auto str{double_to_string(exposure_bias, 1)};
+    make_zero_empty(str);
+    return str;
+}
+
+auto format_flash(int flash) -> std::string {
+    return flash ? "on" : "off";
+}
+
+auto format_metering_mode(int metering_mode) -> std::string {
+    return metering_mode_to_string(metering_mode);
+}
+
+auto format_focal_length(double focal_length) -> std::string {
+    auto str{double_to_string(focal_length)};
+    make_zero_empty(str);
+    return str;
+}
+
+auto format_gps(double latitude, double longitude) -> std::string {
+    if (latitude == 0 && longitude == 0) {
+        return "";
+    }
+
+    auto const dms{[](double value, char positive, char negative) -> std::string {
+        auto const direction{value < 0 ? negative : positive};
+        value = std::abs(value);
+        auto const degrees{std::floor(value)};
+        auto const minutes{std::floor((value - degrees) * 60.0)};
+        auto const seconds{((value - degrees) * 60.0 - minutes) * 60.0};
+        std::stringstream ss;
+        ss << std::fixed << std::setw(1) << std::setprecision(0) << degrees << "°"
+           << std::fixed << std::setw(1) << std::setprecision(0) << minutes << "'"
+           << std::fixed << std::setw(1) << std::setprecision(0) << seconds << "\""
+           << " " << direction;
+        return ss.str();
+    }};
+    return dms(latitude, 'N', 'S') + " " + dms(longitude, 'E', 'W');
 }
 
 } // namespace util
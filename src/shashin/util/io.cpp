@@ -0,0 +1,336 @@
+#include <shashin/util/io.h>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#if SHASHIN_IO_URING
+#include <liburing.h>
+#endif
+
+namespace shashin {
+namespace util {
+
+// the part of a file of size file_size that a range covers, a length of 0 reaches to its end
+static auto clamp_range(std::size_t file_size, std::size_t offset, std::size_t length) -> std::size_t {
+    if (offset >= file_size) {
+        return 0;
+    }
+    return length > 0 ? std::min(file_size - offset, length) : file_size - offset;
+}
+
+static auto read_file_blocking(fs::path const& path, std::size_t offset, std::size_t length) -> std::tuple<std::vector<unsigned char>, std::string> {
+    std::ifstream ifs{path, std::ios::binary | std::ios::ate};
+    if (!ifs) {
+        return {std::vector<unsigned char>{}, path.string() + ": " + std::strerror(errno)};
+    }
+    auto const size{clamp_range(static_cast<std::size_t>(ifs.tellg()), offset, length)};
+    ifs.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    std::vector<unsigned char> buffer(size);
+    if (size > 0 && !ifs.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size))) {
+        return {std::vector<unsigned char>{}, path.string() + ": " + std::strerror(errno)};
+    }
+    return {std::move(buffer), ""};
+}
+
+static auto write_file_blocking(fs::path const& path, std::vector<unsigned char> const& buffer) -> std::string {
+    try {
+        write_file_atomic(path, reinterpret_cast<char const*>(buffer.data()), buffer.size(), false);
+    } catch (std::exception const& e) {
+        return e.what();
+    }
+    return "";
+}
+
+#if SHASHIN_IO_URING
+
+static constexpr unsigned uring_entries{64};
+
+// keeps up to uring_entries reads or writes in flight and resubmits short transfers, buffer i starts at offsets[i] of its file;
+// returns the number of bytes transferred per file, errors are stored in errors; returns nothing if there is no ring, the caller then falls back to blocking I/O
+static auto transfer_uring(std::vector<int> const& fds, std::vector<std::tuple<unsigned char*, std::size_t>> const& buffers, std::vector<std::size_t> const& offsets, bool write, std::vector<std::string>& errors) -> std::vector<std::size_t> {
+    std::vector<std::size_t> done(fds.size(), 0);
+
+    io_uring ring;
+    auto rc{io_uring_queue_init(uring_entries, &ring, 0)};
+    if (rc < 0) {
+        return {};
+    }
+
+    auto const submit{[&ring, &fds, &buffers, &offsets, &done, write](std::size_t i) -> void {
+        auto* sqe{io_uring_get_sqe(&ring)};
+        auto const [data, size]{buffers[i]};
+        if (write) {
+            io_uring_prep_write(sqe, fds[i], data + done[i], static_cast<unsigned>(size - done[i]), offsets[i] + done[i]);
+        } else {
+            io_uring_prep_read(sqe, fds[i], data + done[i], static_cast<unsigned>(size - done[i]), offsets[i] + done[i]);
+        }
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<std::uintptr_t>(i)));
+    }};
+
+    std::size_t next{0};
+    unsigned in_flight{0};
+    while (next < fds.size() || in_flight > 0) {
+        while (next < fds.size() && in_flight < uring_entries) {
+            auto const i{next++};
+            if (fds[i] < 0 || std::get<1>(buffers[i]) == 0) {
+                continue;
+            }
+            submit(i);
+            ++in_flight;
+        }
+        if (in_flight == 0) {
+            break;
+        }
+        io_uring_submit(&ring);
+
+        io_uring_cqe* cqe{nullptr};
+        rc = io_uring_wait_cqe(&ring, &cqe);
+        if (rc == -EINTR) {
+            continue;
+        }
+        if (rc < 0) {
+            for (std::size_t i{0}; i < fds.size(); ++i) {
+                if (done[i] < std::get<1>(buffers[i]) && errors[i].empty()) {
+                    errors[i] = std::string{"io_uring: "} + std::strerror(-rc);
+                }
+            }
+            break;
+        }
+        auto const i{static_cast<std::size_t>(reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(cqe)))};
+        auto const res{cqe->res};
+        io_uring_cqe_seen(&ring, cqe);
+        --in_flight;
+
+        if (res < 0) {
+            errors[i] = std::strerror(-res);
+        } else if (res == 0) {
+            // the file shrank since it was stat'ed, keep what was read
+            if (write) {
+                errors[i] = "short write";
+            }
+        } else {
+            done[i] += static_cast<std::size_t>(res);
+            if (done[i] < std::get<1>(buffers[i])) {
+                submit(i);
+                ++in_flight;
+            }
+        }
+    }
+
+    io_uring_queue_exit(&ring);
+    return done;
+}
+
+static auto read_files_uring(std::vector<std::tuple<fs::path, std::size_t, std::size_t>> const& ranges) -> std::vector<std::tuple<std::vector<unsigned char>, std::string>> {
+    std::vector<std::tuple<std::vector<unsigned char>, std::string>> results(ranges.size());
+    std::vector<int> fds(ranges.size(), -1);
+    std::vector<std::tuple<unsigned char*, std::size_t>> buffers(ranges.size(), {nullptr, 0});
+    std::vector<std::size_t> offsets(ranges.size(), 0);
+    std::vector<std::string> errors(ranges.size());
+
+    for (std::size_t i{0}; i < ranges.size(); ++i) {
+        auto const& [path, offset, length]{ranges[i]};
+        struct stat st;
+        fds[i] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fds[i] < 0 || fstat(fds[i], &st) != 0) {
+            errors[i] = path.string() + ": " + std::strerror(errno);
+            continue;
+        }
+        auto& buffer{std::get<0>(results[i])};
+        buffer.resize(clamp_range(static_cast<std::size_t>(st.st_size), offset, length));
+        buffers[i] = {buffer.data(), buffer.size()};
+        offsets[i] = offset;
+    }
+
+    auto const done{transfer_uring(fds, buffers, offsets, false, errors)};
+
+    for (std::size_t i{0}; i < ranges.size(); ++i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+        if (done.size() != ranges.size()) {
+            continue;
+        }
+        auto& [buffer, error]{results[i]};
+        if (errors[i].size() > 0) {
+            buffer.clear();
+            error = errors[i];
+        } else {
+            buffer.resize(done[i]);
+        }
+    }
+    if (done.size() != ranges.size()) {
+        return {};
+    }
+    return results;
+}
+
+static auto write_files_uring(std::vector<std::tuple<fs::path, std::vector<unsigned char>>> const& files) -> std::vector<std::string> {
+    std::vector<int> fds(files.size(), -1);
+    std::vector<std::tuple<unsigned char*, std::size_t>> buffers(files.size(), {nullptr, 0});
+    std::vector<std::string> errors(files.size());
+    std::vector<fs::path> tmp_paths(files.size());
+
+    for (std::size_t i{0}; i < files.size(); ++i) {
+        auto const& [path, buffer]{files[i]};
+        tmp_paths[i] = path;
+        tmp_paths[i] += ".tmp";
+        fds[i] = open(tmp_paths[i].c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fds[i] < 0) {
+            errors[i] = tmp_paths[i].string() + ": " + std::strerror(errno);
+            continue;
+        }
+        buffers[i] = {const_cast<unsigned char*>(buffer.data()), buffer.size()};
+    }
+
+    auto const done{transfer_uring(fds, buffers, std::vector<std::size_t>(files.size(), 0), true, errors)};
+    if (done.size() != files.size()) {
+        for (std::size_t i{0}; i < files.size(); ++i) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+                std::error_code ec;
+                fs::remove(tmp_paths[i], ec);
+            }
+        }
+        return {};
+    }
+
+    for (std::size_t i{0}; i < files.size(); ++i) {
+        if (fds[i] < 0) {
+            continue;
+        }
+        if (errors[i].empty() && fsync(fds[i]) != 0) {
+            errors[i] = tmp_paths[i].string() + ": " + std::strerror(errno);
+        }
+        if (close(fds[i]) != 0 && errors[i].empty()) {
+            errors[i] = tmp_paths[i].string() + ": " + std::strerror(errno);
+        }
+        std::error_code ec;
+        if (errors[i].empty()) {
+            fs::rename(tmp_paths[i], std::get<0>(files[i]), ec);
+            if (ec) {
+                errors[i] = std::get<0>(files[i]).string() + ": " + ec.message();
+            }
+        }
+        if (errors[i].size() > 0) {
+            fs::remove(tmp_paths[i], ec);
+        }
+    }
+    return errors;
+}
+
+#endif
+
+auto io_backend_name(IoBackend backend) -> std::string {
+    switch (backend) {
+        case IoBackend::blocking: return "blocking";
+        case IoBackend::uring: return "io_uring";
+        default: return "unknown";
+    }
+}
+
+auto io_backend_default() -> IoBackend {
+#if SHASHIN_IO_URING
+    static auto const supported{[]() -> bool {
+        io_uring ring;
+        if (io_uring_queue_init(2, &ring, 0) < 0) {
+            return false;
+        }
+        io_uring_queue_exit(&ring);
+        return true;
+    }()};
+    return supported ? IoBackend::uring : IoBackend::blocking;
+#else
+    return IoBackend::blocking;
+#endif
+}
+
+auto read_files(std::vector<fs::path> const& paths, IoBackend backend, std::size_t head_size) -> std::vector<std::tuple<std::vector<unsigned char>, std::string>> {
+    std::vector<std::tuple<fs::path, std::size_t, std::size_t>> ranges;
+    ranges.reserve(paths.size());
+    for (auto const& path: paths) {
+        ranges.push_back({path, 0, head_size});
+    }
+    return read_file_ranges(ranges, backend);
+}
+
+auto read_file_ranges(std::vector<std::tuple<fs::path, std::size_t, std::size_t>> const& ranges, IoBackend backend) -> std::vector<std::tuple<std::vector<unsigned char>, std::string>> {
+#if SHASHIN_IO_URING
+    // without a ring, for example when the memlock limit is reached, the batch is read blocking instead
+    if (backend == IoBackend::uring) {
+        auto results{read_files_uring(ranges)};
+        if (results.size() == ranges.size()) {
+            return results;
+        }
+    }
+#else
+    (void)backend;
+#endif
+    std::vector<std::tuple<std::vector<unsigned char>, std::string>> results;
+    results.reserve(ranges.size());
+    for (auto const& [path, offset, length]: ranges) {
+        results.push_back(read_file_blocking(path, offset, length));
+    }
+    return results;
+}
+
+auto write_files_atomic(std::vector<std::tuple<fs::path, std::vector<unsigned char>>> const& files, IoBackend backend) -> std::vector<std::string> {
+    for (auto const& [path, buffer]: files) {
+        std::error_code ec;
+        if (!fs::exists(path.parent_path(), ec)) {
+            fs::create_directories(path.parent_path(), ec);
+        }
+    }
+
+    std::vector<std::string> errors;
+#if SHASHIN_IO_URING
+    if (backend == IoBackend::uring) {
+        errors = write_files_uring(files);
+    }
+#else
+    (void)backend;
+#endif
+    // nothing came back if there was no ring, the batch is then written blocking
+    if (errors.empty()) {
+        errors.reserve(files.size());
+        for (auto const& [path, buffer]: files) {
+            errors.push_back(write_file_blocking(path, buffer));
+        }
+    }
+
+    // the renames only survive a crash once their directories are synced, once per directory for the whole batch
+    std::vector<fs::path> directories;
+    for (auto const& [path, buffer]: files) {
+        if (std::find(directories.begin(), directories.end(), path.parent_path()) == directories.end()) {
+            directories.push_back(path.parent_path());
+        }
+    }
+    for (auto const& directory: directories) {
+        sync_path(directory);
+    }
+    return errors;
+}
+
+auto evict_files(std::vector<fs::path> const& paths) -> void {
+#if defined(POSIX_FADV_DONTNEED)
+    for (auto const& path: paths) {
+        auto const fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#else
+    (void)paths;
+#endif
+}
+
+} // namespace util
+} // namespace shashin
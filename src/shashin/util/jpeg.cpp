@@ -0,0 +1,459 @@
+#include <shashin/util/jpeg.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <csetjmp>
+#include <stdexcept>
+#include <string>
+#include <opencv2/imgproc.hpp>
+#include <easyexif/exif.h>
+#if SHASHIN_LIBJPEG
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <jpeglib.h>
+#endif
+
+namespace shashin {
+namespace util {
+
+auto jpeg_size(std::vector<unsigned char> const& buffer) -> cv::Size {
+    if (buffer.size() < 4 || buffer[0] != 0xFF || buffer[1] != 0xD8) {
+        return {};
+    }
+
+    // walk the marker segments up to the first start of frame
+    std::size_t offset{2};
+    while (offset + 9 < buffer.size()) {
+        if (buffer[offset] != 0xFF) {
+            return {};
+        }
+        auto const marker{buffer[offset + 1]};
+        if (marker == 0xFF) {
+            ++offset;
+            continue;
+        }
+        auto const length{std::size_t(buffer[offset + 2]) << 8 | std::size_t(buffer[offset + 3])};
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            auto const height{int(buffer[offset + 5]) << 8 | int(buffer[offset + 6])};
+            auto const width{int(buffer[offset + 7]) << 8 | int(buffer[offset + 8])};
+            return {width, height};
+        }
+        offset += 2 + length;
+    }
+    return {};
+}
+
+auto jpeg_quality(std::vector<unsigned char> const& buffer) -> int {
+    // Annex K luminance table in natural order, libjpeg scales it by 5000 / quality below 50 and by 200 - 2 * quality above
+    static int const standard[64]{
+        16, 11, 10, 16, 24, 40, 51, 61,
+        12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56,
+        14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77,
+        24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101,
+        72, 92, 95, 98, 112, 100, 103, 99
+    };
+    if (buffer.size() < 4 || buffer[0] != 0xFF || buffer[1] != 0xD8) {
+        return 0;
+    }
+
+    std::size_t offset{2};
+    while (offset + 4 < buffer.size()) {
+        if (buffer[offset] != 0xFF) {
+            return 0;
+        }
+        auto const marker{buffer[offset + 1]};
+        if (marker == 0xFF) {
+            ++offset;
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9) {
+            return 0;
+        }
+        auto const length{std::size_t(buffer[offset + 2]) << 8 | std::size_t(buffer[offset + 3])};
+        if (marker == 0xDB && offset + 2 + length <= buffer.size()) {
+            // a DQT segment holds one or more tables, each a precision and id byte followed by 64 entries
+            auto table{offset + 4};
+            while (table < offset + 2 + length) {
+                auto const precision{buffer[table] >> 4};
+                auto const id{buffer[table] & 0x0F};
+                auto const entry_size{std::size_t(precision == 0 ? 1 : 2)};
+                if (table + 1 + 64 * entry_size > offset + 2 + length) {
+                    return 0;
+                }
+                if (id == 0) {
+                    // the table is stored in zigzag order, sums do not depend on the order
+                    double sum{0};
+                    double standard_sum{0};
+                    for (std::size_t k{0}; k < 64; ++k) {
+                        auto const p{table + 1 + k * entry_size};
+                        sum += entry_size == 1 ? buffer[p] : (int(buffer[p]) << 8 | int(buffer[p + 1]));
+                        standard_sum += standard[k];
+                    }
+                    auto const scale{sum * 100.0 / standard_sum};
+                    auto const quality{scale <= 100.0 ? (200.0 - scale) / 2.0 : 5000.0 / scale};
+                    return std::max(1, std::min(100, int(std::lround(quality))));
+                }
+                table += 1 + 64 * entry_size;
+            }
+        }
+        offset += 2 + length;
+    }
+    return 0;
+}
+
+auto jpeg_passthrough(std::vector<unsigned char> const& buffer) -> std::vector<unsigned char> {
+    if (buffer.size() < 4 || buffer[0] != 0xFF || buffer[1] != 0xD8) {
+        return {};
+    }
+
+    std::vector<unsigned char> output{0xFF, 0xD8};
+    output.reserve(buffer.size());
+    auto frame{false};
+    std::size_t offset{2};
+    while (offset + 4 <= buffer.size()) {
+        if (buffer[offset] != 0xFF) {
+            return {};
+        }
+        auto const marker{buffer[offset + 1]};
+        if (marker == 0xFF) {
+            ++offset;
+            continue;
+        }
+        auto const length{std::size_t(buffer[offset + 2]) << 8 | std::size_t(buffer[offset + 3])};
+        if (offset + 2 + length > buffer.size()) {
+            return {};
+        }
+        auto const segment{buffer.data() + offset};
+
+        if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2) {
+            // precision, height, width and the component count come first
+            if (length < 8) {
+                return {};
+            }
+            auto const components{segment[9]};
+            if (segment[4] != 8 || (components != 1 && components != 3)) {
+                return {};
+            }
+            frame = true;
+        } else if (marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            return {};
+        }
+
+        if (marker == 0xE1 && length > 8 && std::memcmp(segment + 4, "Exif\0\0", 6) == 0) {
+            easyexif::EXIFInfo exif_info;
+            if (exif_info.parseFromEXIFSegment(segment + 4, unsigned(length - 2)) == PARSE_EXIF_SUCCESS && exif_info.Orientation > 1) {
+                return {};
+            }
+        }
+
+        // APP2 carries the ICC profile and APP14 the Adobe color transform, both change how the pixels look
+        auto const metadata{(marker >= 0xE1 && marker <= 0xEF && marker != 0xE2 && marker != 0xEE) || marker == 0xFE};
+        if (marker == 0xDA) {
+            if (!frame) {
+                return {};
+            }
+            output.insert(output.end(), segment, buffer.data() + buffer.size());
+            return output;
+        }
+        if (!metadata) {
+            output.insert(output.end(), segment, segment + 2 + length);
+        }
+        offset += 2 + length;
+    }
+    return {};
+}
+
+#if SHASHIN_LIBJPEG
+
+struct JpegError {
+    jpeg_error_mgr mgr;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static auto jpeg_error_exit(j_common_ptr cinfo) -> void {
+    auto* error{reinterpret_cast<JpegError*>(cinfo->err)};
+    (*cinfo->err->format_message)(cinfo, error->message);
+    std::longjmp(error->jump, 1);
+}
+
+static auto jpeg_output_message(j_common_ptr cinfo) -> void {
+    (void)cinfo;
+}
+
+static auto jpeg_orientation(jpeg_decompress_struct const& cinfo) -> int {
+    for (auto marker{cinfo.marker_list}; marker != nullptr; marker = marker->next) {
+        if (marker->marker == JPEG_APP0 + 1 && marker->data_length > 6 && std::memcmp(marker->data, "Exif\0\0", 6) == 0) {
+            easyexif::EXIFInfo exif_info;
+            if (exif_info.parseFromEXIFSegment(marker->data, marker->data_length) == PARSE_EXIF_SUCCESS) {
+                return exif_info.Orientation;
+            }
+        }
+    }
+    return 1;
+}
+
+// same orientation handling as cv::imdecode
+static auto apply_orientation(cv::Mat& mat, int orientation) -> void {
+    if (orientation >= 5 && orientation <= 8) {
+        cv::Mat transposed;
+        cv::transpose(mat, transposed);
+        mat = transposed;
+    }
+    switch (orientation) {
+        case 2: case 7: cv::flip(mat, mat, orientation == 2 ? 1 : -1); break;
+        case 3: cv::flip(mat, mat, -1); break;
+        case 4: cv::flip(mat, mat, 0); break;
+        case 6: cv::flip(mat, mat, 1); break;
+        case 8: cv::flip(mat, mat, 0); break;
+        default: break;
+    }
+}
+
+auto decode_jpeg_downscaled(std::vector<unsigned char> const& buffer, int size) -> std::tuple<cv::Mat, cv::Size> {
+    jpeg_decompress_struct cinfo;
+    JpegError error;
+    cinfo.err = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = jpeg_error_exit;
+    error.mgr.output_message = jpeg_output_message;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        throw std::runtime_error(std::string{"Failed to decode image: "} + error.message);
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(buffer.data()), static_cast<unsigned long>(buffer.size()));
+    jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) {
+        jpeg_destroy_decompress(&cinfo);
+        return {cv::Mat{}, cv::Size{}};
+    }
+
+    auto const orientation{jpeg_orientation(cinfo)};
+    auto const src_width{int(cinfo.image_width)};
+    auto const src_height{int(cinfo.image_height)};
+    auto const dst_width{(src_width > src_height) ? size : int(std::ceil(double(size) * (double(src_width) / double(src_height))))};
+    auto const dst_height{(src_width > src_height) ? int(std::ceil(double(size) * (double(src_height) / double(src_width)))) : size};
+    if (src_width < dst_width || src_height < dst_height) {
+        jpeg_destroy_decompress(&cinfo);
+        return {cv::Mat{}, cv::Size{}};
+    }
+
+    // the IDCT can already scale by 1/2, 1/4 or 1/8 for free, the rest is area averaged
+    unsigned int denom{1};
+    while (denom < 8 && (src_width + int(denom) * 2 - 1) / (int(denom) * 2) >= dst_width && (src_height + int(denom) * 2 - 1) / (int(denom) * 2) >= dst_height) {
+        denom *= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+#ifdef JCS_EXTENSIONS
+    cinfo.out_color_space = (cinfo.jpeg_color_space == JCS_GRAYSCALE) ? JCS_GRAYSCALE : JCS_EXT_BGR;
+#else
+    cinfo.out_color_space = (cinfo.jpeg_color_space == JCS_GRAYSCALE) ? JCS_GRAYSCALE : JCS_RGB;
+#endif
+    jpeg_start_decompress(&cinfo);
+
+    auto const width{int(cinfo.output_width)};
+    auto const height{int(cinfo.output_height)};
+    auto const channels{int(cinfo.output_components)};
+#ifdef JCS_EXTENSIONS
+    auto const rgb{false};
+#else
+    // only libjpeg-turbo decodes to BGR, with other libjpegs the channels are swapped while averaging
+    auto const rgb{channels == 3};
+#endif
+    auto const strip_height{16};
+
+    cv::Mat dst_mat(dst_height, dst_width, CV_8UC3);
+    std::vector<unsigned char> strip(std::size_t(width) * std::size_t(channels) * std::size_t(strip_height));
+    std::vector<JSAMPROW> rows(strip_height);
+    for (auto y{0}; y < strip_height; ++y) {
+        rows[std::size_t(y)] = strip.data() + std::size_t(y) * std::size_t(width) * std::size_t(channels);
+    }
+    std::vector<int> column_map(static_cast<std::size_t>(width));
+    std::vector<int> column_count(std::size_t(dst_width), 0);
+    for (auto x{0}; x < width; ++x) {
+        column_map[std::size_t(x)] = int((long long)(x) * dst_width / width);
+        ++column_count[std::size_t(column_map[std::size_t(x)])];
+    }
+    std::vector<float> sums(std::size_t(dst_width) * std::size_t(channels), 0.0f);
+
+    // allocations above happened after the first setjmp, rearm so an error cannot jump over them
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        throw std::runtime_error(std::string{"Failed to decode image: "} + error.message);
+    }
+
+    auto dst_y{0};
+    auto row_count{0};
+    auto const flush{[&]() -> void {
+        auto* dst{dst_mat.ptr<unsigned char>(dst_y)};
+        for (auto x{0}; x < dst_width; ++x) {
+            auto const weight{1.0f / float(column_count[std::size_t(x)] * row_count)};
+            for (auto c{0}; c < 3; ++c) {
+                auto const sum{sums[std::size_t(x * channels + (rgb ? 2 - c : std::min(c, channels - 1)))]};
+                dst[x * 3 + c] = cv::saturate_cast<unsigned char>(sum * weight);
+            }
+        }
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        row_count = 0;
+    }};
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        auto const first_y{int(cinfo.output_scanline)};
+        auto const lines{int(jpeg_read_scanlines(&cinfo, rows.data(), JDIMENSION(strip_height)))};
+        for (auto line{0}; line < lines; ++line) {
+            auto const y{int((long long)(first_y + line) * dst_height / height)};
+            if (y != dst_y && row_count > 0) {
+                flush();
+            }
+            dst_y = y;
+            auto const* src{rows[std::size_t(line)]};
+            for (auto x{0}; x < width; ++x) {
+                auto* sum{&sums[std::size_t(column_map[std::size_t(x)] * channels)]};
+                for (auto c{0}; c < channels; ++c) {
+                    sum[c] += float(src[x * channels + c]);
+                }
+            }
+            ++row_count;
+        }
+    }
+    if (row_count > 0) {
+        flush();
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    apply_orientation(dst_mat, orientation);
+    auto const oriented{orientation >= 5 && orientation <= 8};
+    return {dst_mat, oriented ? cv::Size{src_height, src_width} : cv::Size{src_width, src_height}};
+}
+
+class LibjpegEncoder : public Encoder {
+public:
+    ~LibjpegEncoder() override {
+        std::free(m_buffer);
+    }
+
+    auto encode(cv::Mat const& mat, EncoderSettings const& settings) -> std::vector<unsigned char> override {
+        if (mat.depth() != CV_8U || (mat.channels() != 1 && mat.channels() != 3)) {
+            throw std::runtime_error("Failed to encode image: unsupported pixel format");
+        }
+
+        if (m_buffer == nullptr) {
+            m_capacity = 1 << 20;
+            m_buffer = static_cast<unsigned char*>(std::malloc(m_capacity));
+            if (m_buffer == nullptr) {
+                throw std::bad_alloc();
+            }
+        }
+
+#ifdef JCS_EXTENSIONS
+        auto const& input{mat};
+#else
+        // only libjpeg-turbo takes BGR rows, other libjpegs get a RGB copy
+        cv::Mat input{mat};
+        if (mat.channels() == 3) {
+            cv::cvtColor(mat, input, cv::COLOR_BGR2RGB);
+        }
+#endif
+
+        jpeg_compress_struct cinfo;
+        JpegError error;
+        cinfo.err = jpeg_std_error(&error.mgr);
+        error.mgr.error_exit = jpeg_error_exit;
+        error.mgr.output_message = jpeg_output_message;
+        // libjpeg moves to a larger buffer of its own when the data does not fit, m_output and m_output_size then describe that one;
+        // they are members so their values are still valid after the longjmp
+        m_output = m_buffer;
+        m_output_size = m_capacity;
+        if (setjmp(error.jump)) {
+            jpeg_destroy_compress(&cinfo);
+            if (m_output != m_buffer) {
+                std::free(m_output);
+            }
+            m_output = nullptr;
+            throw std::runtime_error(std::string{"Failed to encode image: "} + error.message);
+        }
+
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &m_output, &m_output_size);
+        cinfo.image_width = JDIMENSION(mat.cols);
+        cinfo.image_height = JDIMENSION(mat.rows);
+        cinfo.input_components = mat.channels();
+#ifdef JCS_EXTENSIONS
+        cinfo.in_color_space = mat.channels() == 3 ? JCS_EXT_BGR : JCS_GRAYSCALE;
+#else
+        cinfo.in_color_space = mat.channels() == 3 ? JCS_RGB : JCS_GRAYSCALE;
+#endif
+        jpeg_set_defaults(&cinfo);
+#ifdef JPEG_C_PARAM_SUPPORTED
+        // mozjpeg defaults to its slow size optimized profile, every switch follows the settings instead
+        jpeg_c_set_bool_param(&cinfo, JBOOLEAN_TRELLIS_QUANT, settings.trellis ? TRUE : FALSE);
+        jpeg_c_set_bool_param(&cinfo, JBOOLEAN_TRELLIS_QUANT_DC, settings.trellis ? TRUE : FALSE);
+#endif
+        jpeg_set_quality(&cinfo, settings.quality, TRUE);
+        cinfo.optimize_coding = settings.optimize ? TRUE : FALSE;
+        if (mat.channels() == 3) {
+            cinfo.comp_info[0].h_samp_factor = settings.subsampling == 444 ? 1 : 2;
+            cinfo.comp_info[0].v_samp_factor = settings.subsampling == 420 ? 2 : 1;
+        }
+        if (settings.progressive) {
+            jpeg_simple_progression(&cinfo);
+        } else {
+            cinfo.num_scans = 0;
+            cinfo.scan_info = nullptr;
+        }
+
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            auto row{const_cast<JSAMPROW>(input.ptr<unsigned char>(int(cinfo.next_scanline)))};
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        std::vector<unsigned char> output(m_output, m_output + m_output_size);
+        jpeg_destroy_compress(&cinfo);
+
+        // the larger buffer is kept for the next image, its capacity is at least the size written into it
+        if (m_output != m_buffer) {
+            std::free(m_buffer);
+            m_buffer = m_output;
+            m_capacity = m_output_size;
+        }
+        m_output = nullptr;
+        return output;
+    }
+
+private:
+    unsigned char* m_buffer{nullptr};
+    unsigned long m_capacity{0};
+    unsigned char* m_output{nullptr};
+    unsigned long m_output_size{0};
+};
+
+auto make_libjpeg_encoder() -> std::unique_ptr<Encoder> {
+    return std::make_unique<LibjpegEncoder>();
+}
+
+#else
+
+auto decode_jpeg_downscaled(std::vector<unsigned char> const& buffer, int size) -> std::tuple<cv::Mat, cv::Size> {
+    (void)buffer;
+    (void)size;
+    return {cv::Mat{}, cv::Size{}};
+}
+
+auto make_libjpeg_encoder() -> std::unique_ptr<Encoder> {
+    return nullptr;
+}
+
+#endif
+
+} // namespace util
+} // namespace shashin
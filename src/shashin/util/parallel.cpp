@@ -1,9 +1,21 @@
 #include <shashin/util/parallel.h>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
 
 namespace shashin {
 namespace util {
 
+static std::atomic<bool> interrupt_flag{false};
+
+static auto interrupt_handler(int signal) -> void {
+    if (interrupt_flag.exchange(true)) {
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+}
+
 auto process_parallel(std::function<void(int worker_number, int lower_bound, int upper_bound)> process_func, int list_size, int worker_size) -> void {
     auto const chunk_size{list_size / worker_size};
     std::vector<std::thread> workers;
@@ -20,5 +32,29 @@ auto process_parallel(std::function<void(int worker_number, int lower_bound, int
     }
 }
 
+auto process_parallel_dynamic(std::function<void(int worker_number, int lower_bound, int upper_bound)> process_func, int list_size, int batch_size, int worker_size) -> void {
+    std::atomic<int> next_bound{0};
+    std::vector<std::thread> workers;
+    for (auto worker_number{0}; worker_number < std::min(worker_size, list_size); ++worker_number) {
+        workers.push_back(std::thread([&process_func, &next_bound, list_size, batch_size, worker_number]() {
+            for (auto lower_bound{next_bound.fetch_add(batch_size)}; lower_bound < list_size; lower_bound = next_bound.fetch_add(batch_size)) {
+                process_func(worker_number, lower_bound, std::min(lower_bound + batch_size, list_size));
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+auto install_interrupt_handler() -> void {
+    std::signal(SIGINT, interrupt_handler);
+    std::signal(SIGTERM, interrupt_handler);
+}
+
+auto interrupted() -> bool {
+    return interrupt_flag.load();
+}
+
 } // namespace util
 } // namespace shashin
@@ -0,0 +1,389 @@
+#include <shashin/util/raw.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+namespace shashin {
+namespace util {
+
+auto is_raw(fs::path const& path) -> bool {
+    auto extension{path.extension().string()};
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) -> char {
+        return char(std::tolower(c));
+    });
+    return extension == ".nef" || extension == ".nrw" || extension == ".cr2" || extension == ".arw" || extension == ".dng";
+}
+
+// random access to a TIFF file in either byte order, every read is checked against the file size
+class TiffReader {
+public:
+    explicit TiffReader(fs::path const& path)
+        : m_ifs{path, std::ios::binary | std::ios::ate}
+    {
+        if (!m_ifs) {
+            return;
+        }
+        m_size = static_cast<std::size_t>(m_ifs.tellg());
+        unsigned char header[4];
+        if (!read(0, header, sizeof(header))) {
+            return;
+        }
+        if (header[0] == 'I' && header[1] == 'I' && header[2] == 42 && header[3] == 0) {
+            m_big_endian = false;
+        } else if (header[0] == 'M' && header[1] == 'M' && header[2] == 0 && header[3] == 42) {
+            m_big_endian = true;
+        } else {
+            return;
+        }
+        m_valid = true;
+    }
+
+    auto valid() const -> bool {
+        return m_valid;
+    }
+
+    auto size() const -> std::size_t {
+        return m_size;
+    }
+
+    auto big_endian() const -> bool {
+        return m_big_endian;
+    }
+
+    auto read(std::size_t offset, unsigned char* data, std::size_t length) -> bool {
+        if (offset > m_size || length > m_size - offset) {
+            return false;
+        }
+        m_ifs.clear();
+        m_ifs.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        return bool(m_ifs.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(length)));
+    }
+
+    auto u16(unsigned char const* data) const -> std::uint32_t {
+        return m_big_endian
+            ? std::uint32_t(data[0]) << 8 | data[1]
+            : std::uint32_t(data[1]) << 8 | data[0];
+    }
+
+    auto u32(unsigned char const* data) const -> std::uint32_t {
+        return m_big_endian
+            ? std::uint32_t(data[0]) << 24 | std::uint32_t(data[1]) << 16 | std::uint32_t(data[2]) << 8 | data[3]
+            : std::uint32_t(data[3]) << 24 | std::uint32_t(data[2]) << 16 | std::uint32_t(data[1]) << 8 | data[0];
+    }
+
+    // SHORT, LONG and IFD values of an entry, stored in the entry itself if they fit into four bytes
+    auto values(unsigned char const* entry) -> std::vector<std::uint32_t> {
+        auto const type{u16(entry + 2)};
+        auto const count{u32(entry + 4)};
+        auto const width{type == 3 ? 2u : (type == 4 || type == 13) ? 4u : 0u};
+        // a RAW file has at most a handful of strips or sub IFDs in the entries looked at
+        if (width == 0 || count == 0 || count > 1024) {
+            return {};
+        }
+        std::vector<unsigned char> data(std::size_t(width) * count);
+        if (data.size() <= 4) {
+            std::memcpy(data.data(), entry + 8, data.size());
+        } else if (!read(u32(entry + 8), data.data(), data.size())) {
+            return {};
+        }
+        std::vector<std::uint32_t> result(count);
+        for (std::size_t i{0}; i < count; ++i) {
+            result[i] = width == 2 ? u16(data.data() + 2 * i) : u32(data.data() + 4 * i);
+        }
+        return result;
+    }
+
+private:
+    std::ifstream m_ifs;
+    std::size_t m_size{0};
+    bool m_big_endian{false};
+    bool m_valid{false};
+};
+
+// only baseline and progressive Huffman frames can be decoded, CR2 and DNG store the RAW data itself as lossless JPEG
+static auto is_decodable_jpeg(TiffReader& reader, std::size_t offset, std::size_t length) -> bool {
+    unsigned char soi[2];
+    if (!reader.read(offset, soi, sizeof(soi)) || soi[0] != 0xFF || soi[1] != 0xD8) {
+        return false;
+    }
+    auto position{offset + 2};
+    unsigned char segment[4];
+    while (position + sizeof(segment) <= offset + length && reader.read(position, segment, sizeof(segment))) {
+        if (segment[0] != 0xFF) {
+            return false;
+        }
+        auto const marker{segment[1]};
+        if (marker == 0xFF) {
+            ++position;
+            continue;
+        }
+        if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2) {
+            return true;
+        }
+        if ((marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) || marker == 0xDA || marker == 0xD9) {
+            return false;
+        }
+        position += 2 + (std::size_t(segment[2]) << 8 | segment[3]);
+    }
+    return false;
+}
+
+auto raw_preview(fs::path const& path) -> std::tuple<std::size_t, std::size_t, int, std::string> {
+    TiffReader reader{path};
+    if (!reader.valid()) {
+        return {0, 0, 0, path.string() + ": no TIFF based RAW file"};
+    }
+
+    // https://exiftool.org/TagNames/EXIF.html
+    constexpr std::uint32_t compression_tag{0x0103};
+    constexpr std::uint32_t strip_offsets_tag{0x0111};
+    constexpr std::uint32_t orientation_tag{0x0112};
+    constexpr std::uint32_t strip_byte_counts_tag{0x0117};
+    constexpr std::uint32_t sub_ifds_tag{0x014A};
+    constexpr std::uint32_t jpeg_offset_tag{0x0201};
+    constexpr std::uint32_t jpeg_length_tag{0x0202};
+
+    // IFD0 and its chain plus the sub IFDs, where NEF and DNG keep their previews; visited offsets stop cyclic files
+    std::vector<std::tuple<std::size_t, std::size_t>> candidates;
+    int orientation{1};
+    unsigned char header[8];
+    reader.read(0, header, sizeof(header));
+    std::vector<std::uint32_t> pending{reader.u32(header + 4)};
+    std::unordered_set<std::uint32_t> visited;
+    auto first{true};
+    while (!pending.empty() && visited.size() < 64) {
+        auto const ifd_offset{pending.back()};
+        pending.pop_back();
+        if (ifd_offset == 0 || !visited.insert(ifd_offset).second) {
+            continue;
+        }
+        unsigned char count_data[2];
+        if (!reader.read(ifd_offset, count_data, sizeof(count_data))) {
+            continue;
+        }
+        std::vector<unsigned char> entries(std::size_t(reader.u16(count_data)) * 12 + 4);
+        if (!reader.read(ifd_offset + 2, entries.data(), entries.size())) {
+            continue;
+        }
+
+        std::uint32_t compression{0};
+        std::vector<std::uint32_t> strip_offsets;
+        std::vector<std::uint32_t> strip_byte_counts;
+        std::uint32_t jpeg_offset{0};
+        std::uint32_t jpeg_length{0};
+        for (std::size_t k{0}; k + 4 < entries.size(); k += 12) {
+            auto const entry{entries.data() + k};
+            auto const tag{reader.u16(entry)};
+            if (tag == compression_tag || tag == jpeg_offset_tag || tag == jpeg_length_tag || (first && tag == orientation_tag)) {
+                auto const values{reader.values(entry)};
+                auto const value{values.empty() ? 0 : values[0]};
+                if (tag == compression_tag) {
+                    compression = value;
+                } else if (tag == jpeg_offset_tag) {
+                    jpeg_offset = value;
+                } else if (tag == jpeg_length_tag) {
+                    jpeg_length = value;
+                } else if (value >= 1 && value <= 8) {
+                    orientation = int(value);
+                }
+            } else if (tag == strip_offsets_tag) {
+                strip_offsets = reader.values(entry);
+            } else if (tag == strip_byte_counts_tag) {
+                strip_byte_counts = reader.values(entry);
+            } else if (tag == sub_ifds_tag) {
+                auto const sub_ifds{reader.values(entry)};
+                pending.insert(pending.end(), sub_ifds.begin(), sub_ifds.end());
+            }
+        }
+        pending.push_back(reader.u32(entries.data() + entries.size() - 4));
+        first = false;
+
+        if (jpeg_offset > 0 && jpeg_length > 0) {
+            candidates.push_back({jpeg_offset, jpeg_length});
+        }
+        // old style and new style JPEG compression in a single strip
+        if ((compression == 6 || compression == 7) && strip_offsets.size() == 1 && strip_byte_counts.size() == 1 && strip_byte_counts[0] > 0) {
+            candidates.push_back({strip_offsets[0], strip_byte_counts[0]});
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](auto const& a, auto const& b) -> bool {
+        return std::get<1>(a) > std::get<1>(b);
+    });
+    for (auto const& [offset, length]: candidates) {
+        if (offset < reader.size() && length <= reader.size() - offset && is_decodable_jpeg(reader, offset, length)) {
+            return {offset, length, orientation, ""};
+        }
+    }
+    return {0, 0, 0, path.string() + ": no embedded JPEG preview"};
+}
+
+// writes values in the byte order of the reader, so copied entries need no conversion
+static auto put_u16(TiffReader const& reader, std::vector<unsigned char>& data, std::size_t offset, std::uint32_t value) -> void {
+    data[offset + (reader.big_endian() ? 0 : 1)] = static_cast<unsigned char>(value >> 8);
+    data[offset + (reader.big_endian() ? 1 : 0)] = static_cast<unsigned char>(value);
+}
+
+static auto put_u32(TiffReader const& reader, std::vector<unsigned char>& data, std::size_t offset, std::uint32_t value) -> void {
+    for (auto k{0}; k < 4; ++k) {
+        data[offset + std::size_t(reader.big_endian() ? k : 3 - k)] = static_cast<unsigned char>(value >> (24 - 8 * k));
+    }
+}
+
+auto raw_exif(fs::path const& path) -> std::tuple<std::vector<unsigned char>, std::string> {
+    TiffReader reader{path};
+    if (!reader.valid()) {
+        return {std::vector<unsigned char>{}, path.string() + ": no TIFF based RAW file"};
+    }
+
+    constexpr std::uint32_t sub_ifds_tag{0x014A};
+    constexpr std::uint32_t exif_ifd_tag{0x8769};
+    constexpr std::uint32_t gps_ifd_tag{0x8825};
+    constexpr std::uint32_t interoperability_ifd_tag{0xA005};
+    // maker notes and embedded thumbnails are of no use for the columns and can be megabytes
+    constexpr std::uint32_t max_value_size{64 * 1024};
+
+    // IFD0 is copied with the EXIF and GPS IFD appended, each value is moved behind its IFD and every offset rewritten;
+    // pointers to other IFDs are dropped, their offsets would point into nothing
+    std::vector<unsigned char> blob(8);
+    blob[0] = blob[1] = reader.big_endian() ? 'M' : 'I';
+    put_u16(reader, blob, 2, 42);
+    put_u32(reader, blob, 4, 8);
+
+    auto const copy_ifd{[&reader, &blob](std::uint32_t ifd_offset, std::vector<std::tuple<std::uint32_t, std::uint32_t>>& pointers) -> bool {
+        unsigned char count_data[2];
+        if (!reader.read(ifd_offset, count_data, sizeof(count_data))) {
+            return false;
+        }
+        std::vector<unsigned char> entries(std::size_t(reader.u16(count_data)) * 12);
+        if (!reader.read(ifd_offset + 2, entries.data(), entries.size())) {
+            return false;
+        }
+
+        std::vector<std::size_t> kept;
+        for (std::size_t k{0}; k < entries.size(); k += 12) {
+            auto const tag{reader.u16(entries.data() + k)};
+            if (tag != sub_ifds_tag && tag != interoperability_ifd_tag) {
+                kept.push_back(k);
+            }
+        }
+        auto const ifd_position{blob.size()};
+        blob.resize(ifd_position + 2 + kept.size() * 12 + 4, 0);
+        put_u16(reader, blob, ifd_position, std::uint32_t(kept.size()));
+
+        for (std::size_t e{0}; e < kept.size(); ++e) {
+            auto const entry{entries.data() + kept[e]};
+            auto const entry_position{ifd_position + 2 + e * 12};
+            std::memcpy(blob.data() + entry_position, entry, 12);
+
+            auto const tag{reader.u16(entry)};
+            if (tag == exif_ifd_tag || tag == gps_ifd_tag) {
+                pointers.push_back({reader.u32(entry + 8), std::uint32_t(entry_position + 8)});
+                continue;
+            }
+
+            // BYTE, ASCII, SHORT, LONG, RATIONAL, SBYTE, UNDEFINED, SSHORT, SLONG, SRATIONAL, FLOAT, DOUBLE
+            static constexpr std::uint32_t widths[]{0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8};
+            auto const type{reader.u16(entry + 2)};
+            auto const count{reader.u32(entry + 4)};
+            auto const width{type < sizeof(widths) / sizeof(widths[0]) ? widths[type] : 0};
+            auto const size{std::uint64_t(width) * count};
+            if (size <= 4) {
+                continue;
+            }
+            std::vector<unsigned char> value(size <= max_value_size ? std::size_t(size) : 0);
+            if (value.empty() || !reader.read(reader.u32(entry + 8), value.data(), value.size())) {
+                put_u32(reader, blob, entry_position + 4, 0);
+                put_u32(reader, blob, entry_position + 8, 0);
+                continue;
+            }
+            // values start on a word boundary
+            blob.resize(blob.size() + blob.size() % 2, 0);
+            put_u32(reader, blob, entry_position + 8, std::uint32_t(blob.size()));
+            blob.insert(blob.end(), value.begin(), value.end());
+        }
+        return true;
+    }};
+
+    unsigned char header[8];
+    reader.read(0, header, sizeof(header));
+    std::vector<std::tuple<std::uint32_t, std::uint32_t>> pointers;
+    if (!copy_ifd(reader.u32(header + 4), pointers)) {
+        return {std::vector<unsigned char>{}, path.string() + ": no IFD0"};
+    }
+    // the EXIF IFD of some RAW files holds the GPS pointer as well, each IFD is copied once
+    std::unordered_set<std::uint32_t> copied;
+    for (std::size_t p{0}; p < pointers.size(); ++p) {
+        auto const [source, position]{pointers[p]};
+        blob.resize(blob.size() + blob.size() % 2, 0);
+        auto const target{std::uint32_t(blob.size())};
+        if (copied.insert(source).second && copy_ifd(source, pointers)) {
+            put_u32(reader, blob, position, target);
+        } else {
+            put_u32(reader, blob, position, 0);
+        }
+    }
+    return {blob, ""};
+}
+
+auto orient_preview(std::vector<unsigned char>& buffer, int orientation) -> void {
+    if (orientation <= 1 || buffer.size() < 4) {
+        return;
+    }
+
+    // an EXIF segment has to follow SOI or a JFIF segment directly; one with an orientation is kept,
+    // one without, as many previews carry, is replaced so the orientation of the RAW file is not lost
+    std::size_t offset{2};
+    std::size_t exif_offset{0};
+    std::size_t exif_length{0};
+    while (offset + 10 < buffer.size() && buffer[offset] == 0xFF && buffer[offset + 1] >= 0xE0 && buffer[offset + 1] <= 0xEF) {
+        auto const length{std::size_t(buffer[offset + 2]) << 8 | std::size_t(buffer[offset + 3])};
+        if (offset + 2 + length > buffer.size()) {
+            break;
+        }
+        if (buffer[offset + 1] == 0xE1 && length >= 8 && std::memcmp(buffer.data() + offset + 4, "Exif\0\0", 6) == 0) {
+            exif_offset = offset;
+            exif_length = 2 + length;
+            break;
+        }
+        offset += 2 + length;
+    }
+    if (exif_length > 0) {
+        auto const* tiff{buffer.data() + exif_offset + 10};
+        auto const tiff_size{exif_length - 10};
+        auto const big_endian{tiff_size >= 8 && tiff[0] == 'M'};
+        auto const u16{[tiff, big_endian](std::size_t at) -> std::uint32_t {
+            return big_endian ? std::uint32_t(tiff[at]) << 8 | tiff[at + 1] : std::uint32_t(tiff[at + 1]) << 8 | tiff[at];
+        }};
+        auto const u32{[&u16, big_endian](std::size_t at) -> std::uint32_t {
+            return big_endian ? u16(at) << 16 | u16(at + 2) : u16(at + 2) << 16 | u16(at);
+        }};
+        if (tiff_size >= 8) {
+            auto const ifd{std::size_t(u32(4))};
+            auto const entries{ifd + 2 <= tiff_size ? std::size_t(u16(ifd)) : 0};
+            for (std::size_t i{0}; i < entries && ifd + 2 + (i + 1) * 12 <= tiff_size; ++i) {
+                if (u16(ifd + 2 + i * 12) == 0x0112) {
+                    return;
+                }
+            }
+        }
+        buffer.erase(buffer.begin() + std::ptrdiff_t(exif_offset), buffer.begin() + std::ptrdiff_t(exif_offset + exif_length));
+    }
+
+    // big endian TIFF header and an IFD0 with the orientation as its only entry
+    std::vector<unsigned char> const segment{
+        0xFF, 0xE1, 0x00, 0x22,
+        'E', 'x', 'i', 'f', 0x00, 0x00,
+        'M', 'M', 0x00, 0x2A, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x01,
+        0x01, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, static_cast<unsigned char>(orientation), 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    buffer.insert(buffer.begin() + std::ptrdiff_t(exif_length > 0 ? exif_offset : 2), segment.begin(), segment.end());
+}
+
+} // namespace util
+} // namespace shashin
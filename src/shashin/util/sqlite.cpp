@@ -32,5 +32,14 @@ auto sqlite3_bind_int_or_null(sqlite3_stmt* stmt, int i, int value, bool valid)
     }
 }
 
+auto sqlite3_copy(sqlite3* src, sqlite3* dst) -> int {
+    auto* backup{sqlite3_backup_init(dst, "main", src, "main")};
+    if (backup == nullptr) {
+        return sqlite3_errcode(dst);
+    }
+    sqlite3_backup_step(backup, -1);
+    return sqlite3_backup_finish(backup);
+}
+
 } // namespace util
 } // namespace shashin
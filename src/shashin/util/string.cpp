@@ -4,14 +4,13 @@
 #include <regex>
 #include <sstream>
 #include <fstream>
+#include <cstdint>
 
 namespace shashin {
 namespace util {
 
 auto dump_to_file(fs::path const& ofile, std::string const& str) -> void {
-    std::ofstream ofs{ofile};
-    ofs << str;
-    ofs.close();
+    write_file_atomic(ofile, str.data(), str.size());
 }
 
 auto int_to_string(int value) -> std::string {
@@ -54,6 +53,23 @@ auto remove_precision(std::string& input) -> void {
     input = std::regex_replace(input, std::regex("\\.0"), "");
 }
 
+auto base64_encode(unsigned char const* data, std::size_t size) -> std::string {
+    static char const* const alphabet{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+    std::string output;
+    output.reserve((size + 2) / 3 * 4);
+    for (std::size_t i{0}; i < size; i += 3) {
+        auto const remaining{size - i};
+        auto const chunk{std::uint32_t(data[i]) << 16
+            | (remaining > 1 ? std::uint32_t(data[i + 1]) << 8 : 0)
+            | (remaining > 2 ? std::uint32_t(data[i + 2]) : 0)};
+        output.push_back(alphabet[(chunk >> 18) & 0x3F]);
+        output.push_back(alphabet[(chunk >> 12) & 0x3F]);
+        output.push_back(remaining > 1 ? alphabet[(chunk >> 6) & 0x3F] : '=');
+        output.push_back(remaining > 2 ? alphabet[chunk & 0x3F] : '=');
+    }
+    return output;
+}
+
 namespace stackoverflow {
 
 // https://stackoverflow.com/a/51353040/2777836
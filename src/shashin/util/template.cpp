@@ -0,0 +1,201 @@
+#include <shashin/util/template.h>
+#include <stdexcept>
+
+namespace shashin {
+namespace util {
+
+auto html_escape(std::string const& str) -> std::string {
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (auto const c: str) {
+        switch (c) {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            case '\'': escaped += "&#39;"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static auto trim(std::string const& str) -> std::string {
+    auto const first{str.find_first_not_of(" \t\r\n")};
+    if (first == std::string::npos) {
+        return "";
+    }
+    return str.substr(first, str.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+static auto to_string(nlohmann::json const& value) -> std::string {
+    if (value.is_string()) {
+        return value.get<std::string>();
+    }
+    if (value.is_null()) {
+        return "";
+    }
+    return value.dump();
+}
+
+static auto is_truthy(nlohmann::json const& value) -> bool {
+    if (value.is_null()) {
+        return false;
+    }
+    if (value.is_boolean()) {
+        return value.get<bool>();
+    }
+    if (value.is_number()) {
+        return value.get<double>() != 0;
+    }
+    if (value.is_string()) {
+        return !value.get_ref<std::string const&>().empty();
+    }
+    if (value.is_array()) {
+        return !value.empty();
+    }
+    return true;
+}
+
+Template::Template(std::string const& source) {
+    size_t pos{0};
+    m_nodes = parse(source, pos, "");
+}
+
+auto Template::render(nlohmann::json const& context) const -> std::string {
+    std::string out;
+    std::vector<nlohmann::json const*> stack{&context};
+    render(m_nodes, stack, out);
+    return out;
+}
+
+auto Template::parse(std::string const& source, size_t& pos, std::string const& closing) -> std::vector<Node> {
+    std::vector<Node> nodes;
+    while (pos < source.size()) {
+        auto const open{source.find("{{", pos)};
+        if (open == std::string::npos) {
+            nodes.push_back({Kind::text, source.substr(pos), {}});
+            pos = source.size();
+            break;
+        }
+        if (open > pos) {
+            nodes.push_back({Kind::text, source.substr(pos, open - pos), {}});
+        }
+
+        auto const triple{source.compare(open, 3, "{{{") == 0};
+        auto const close{source.find(triple ? "}}}" : "}}", open)};
+        if (close == std::string::npos) {
+            throw std::runtime_error("Failed to compile template: unclosed tag at " + std::to_string(open));
+        }
+        auto const tag{trim(source.substr(open + (triple ? 3 : 2), close - open - (triple ? 3 : 2)))};
+        pos = close + (triple ? 3 : 2);
+
+        if (triple) {
+            nodes.push_back({Kind::raw, tag, {}});
+            continue;
+        }
+        auto const sigil{tag.empty() ? '\0' : tag[0]};
+        auto const name{trim(tag.substr(sigil == '\0' ? 0 : 1))};
+        switch (sigil) {
+            case '!':
+                break;
+            case '&':
+                nodes.push_back({Kind::raw, name, {}});
+                break;
+            case '#':
+            case '^':
+                nodes.push_back({sigil == '#' ? Kind::section : Kind::inverted, name, parse(source, pos, name)});
+                break;
+            case '/':
+                if (name != closing) {
+                    throw std::runtime_error("Failed to compile template: {{/" + name + "}} closes " + (closing.empty() ? "no section" : "{{#" + closing + "}}"));
+                }
+                return nodes;
+            default:
+                nodes.push_back({Kind::escaped, tag, {}});
+        }
+    }
+    if (!closing.empty()) {
+        throw std::runtime_error("Failed to compile template: {{#" + closing + "}} is not closed");
+    }
+    return nodes;
+}
+
+// the first segment is looked up from the innermost context outwards, the others only below it
+auto Template::lookup(std::vector<nlohmann::json const*> const& stack, std::string const& name) -> nlohmann::json const* {
+    if (name == ".") {
+        return stack.back();
+    }
+
+    std::vector<std::string> segments;
+    size_t first{0};
+    for (auto dot{name.find('.')}; dot != std::string::npos; dot = name.find('.', first)) {
+        segments.push_back(name.substr(first, dot - first));
+        first = dot + 1;
+    }
+    segments.push_back(name.substr(first));
+
+    for (auto it{stack.rbegin()}; it != stack.rend(); ++it) {
+        if (!(*it)->is_object() || (*it)->count(segments[0]) == 0) {
+            continue;
+        }
+        auto const* value{&(**it)[segments[0]]};
+        for (size_t k{1}; k < segments.size(); ++k) {
+            if (!value->is_object() || value->count(segments[k]) == 0) {
+                return nullptr;
+            }
+            value = &(*value)[segments[k]];
+        }
+        return value;
+    }
+    return nullptr;
+}
+
+auto Template::render(std::vector<Node> const& nodes, std::vector<nlohmann::json const*>& stack, std::string& out) -> void {
+    for (auto const& node: nodes) {
+        if (node.kind == Kind::text) {
+            out += node.value;
+            continue;
+        }
+
+        auto const* value{lookup(stack, node.value)};
+        switch (node.kind) {
+            case Kind::escaped:
+                if (value != nullptr) {
+                    out += html_escape(to_string(*value));
+                }
+                break;
+            case Kind::raw:
+                if (value != nullptr) {
+                    out += to_string(*value);
+                }
+                break;
+            case Kind::section:
+                if (value == nullptr || !is_truthy(*value)) {
+                    break;
+                }
+                if (value->is_array()) {
+                    for (auto const& item: *value) {
+                        stack.push_back(&item);
+                        render(node.children, stack, out);
+                        stack.pop_back();
+                    }
+                } else {
+                    stack.push_back(value);
+                    render(node.children, stack, out);
+                    stack.pop_back();
+                }
+                break;
+            case Kind::inverted:
+                if (value == nullptr || !is_truthy(*value)) {
+                    render(node.children, stack, out);
+                }
+                break;
+            case Kind::text:
+                break;
+        }
+    }
+}
+
+} // namespace util
+} // namespace shashin
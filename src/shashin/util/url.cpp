@@ -2,6 +2,7 @@
 #include <regex>
 #include <vector>
 #include <algorithm>
+#include <set>
 
 namespace shashin {
 namespace util {
@@ -75,5 +76,21 @@ auto string_to_url(std::string const& str) -> std::string const {
     return url;
 }
 
+// the transliteration of string_to_url, split into its sorted distinct words; bytes of UTF-8 sequences are kept
+auto string_to_tokens(std::string const& str) -> std::vector<std::string> const {
+    std::set<std::string> tokens;
+    std::string token;
+    for (auto const ch : string_to_url(str) + "-") {
+        auto const c{static_cast<unsigned char>(ch)};
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+            token.push_back(ch);
+        } else if (token.size() > 0) {
+            tokens.insert(token);
+            token.clear();
+        }
+    }
+    return {tokens.begin(), tokens.end()};
+}
+
 } // namespace util
 } // namespace shashin
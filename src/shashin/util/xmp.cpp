@@ -0,0 +1,266 @@
+#include <shashin/util/xmp.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace shashin {
+namespace util {
+
+static auto trim(std::string_view str) -> std::string_view {
+    auto const first{str.find_first_not_of(" \t\r\n")};
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return str.substr(first, str.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+XmlTokenizer::XmlTokenizer(char const* data, std::size_t size)
+    : m_data{data, size} {
+}
+
+auto XmlTokenizer::next() -> XmlToken {
+    while (m_pos < m_data.size()) {
+        if (m_data[m_pos] != '<') {
+            auto const end{std::min(m_data.find('<', m_pos), m_data.size())};
+            XmlToken token{XmlTokenType::text, {}, {}, m_data.substr(m_pos, end - m_pos)};
+            m_pos = end;
+            return token;
+        }
+
+        auto const rest{m_data.substr(m_pos)};
+        if (rest.compare(0, 9, "<![CDATA[") == 0) {
+            auto const end{m_data.find("]]>", m_pos + 9)};
+            if (end == std::string_view::npos) {
+                break;
+            }
+            XmlToken token{XmlTokenType::text, {}, {}, m_data.substr(m_pos + 9, end - m_pos - 9)};
+            m_pos = end + 3;
+            return token;
+        }
+        if (rest.compare(0, 4, "<!--") == 0) {
+            auto const end{m_data.find("-->", m_pos + 4)};
+            if (end == std::string_view::npos) {
+                break;
+            }
+            m_pos = end + 3;
+            continue;
+        }
+        if (rest.compare(0, 2, "<?") == 0 || rest.compare(0, 2, "<!") == 0) {
+            auto const end{m_data.find('>', m_pos + 2)};
+            if (end == std::string_view::npos) {
+                break;
+            }
+            m_pos = end + 1;
+            continue;
+        }
+
+        // the end of the tag is the first '>' outside of a quoted attribute value
+        auto end{m_pos + 1};
+        char quote{'\0'};
+        for (; end < m_data.size(); ++end) {
+            auto const c{m_data[end]};
+            if (quote != '\0') {
+                quote = c == quote ? '\0' : quote;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                break;
+            }
+        }
+        if (end >= m_data.size()) {
+            break;
+        }
+
+        auto tag{m_data.substr(m_pos + 1, end - m_pos - 1)};
+        m_pos = end + 1;
+        XmlToken token;
+        if (tag.size() > 0 && tag[0] == '/') {
+            token.type = XmlTokenType::close;
+            token.name = trim(tag.substr(1));
+            return token;
+        }
+        token.type = XmlTokenType::open;
+        if (tag.size() > 0 && tag.back() == '/') {
+            token.type = XmlTokenType::empty;
+            tag.remove_suffix(1);
+        }
+        auto const name_end{std::min(tag.find_first_of(" \t\r\n"), tag.size())};
+        token.name = tag.substr(0, name_end);
+        token.attributes = tag.substr(name_end);
+        return token;
+    }
+    m_pos = m_data.size();
+    return {};
+}
+
+auto next_xml_attribute(std::string_view& attributes, std::string_view& name, std::string_view& value) -> bool {
+    attributes = trim(attributes);
+    auto const equals{attributes.find('=')};
+    if (equals == std::string_view::npos) {
+        return false;
+    }
+    name = trim(attributes.substr(0, equals));
+    auto const open{attributes.find_first_of("\"'", equals)};
+    if (open == std::string_view::npos) {
+        return false;
+    }
+    auto const close{attributes.find(attributes[open], open + 1)};
+    if (close == std::string_view::npos) {
+        return false;
+    }
+    value = attributes.substr(open + 1, close - open - 1);
+    attributes.remove_prefix(close + 1);
+    return true;
+}
+
+static auto append_utf8(std::string& out, unsigned long code) -> void {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x110000) {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+auto xml_unescape(std::string_view text) -> std::string {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i{0}; i < text.size(); ++i) {
+        auto const semicolon{text[i] == '&' ? text.find(';', i) : std::string_view::npos};
+        if (semicolon == std::string_view::npos || semicolon - i > 10) {
+            out += text[i];
+            continue;
+        }
+        auto const entity{text.substr(i + 1, semicolon - i - 1)};
+        if (entity == "amp") {
+            out += '&';
+        } else if (entity == "lt") {
+            out += '<';
+        } else if (entity == "gt") {
+            out += '>';
+        } else if (entity == "quot") {
+            out += '"';
+        } else if (entity == "apos") {
+            out += '\'';
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            auto const hex{entity[1] == 'x' || entity[1] == 'X'};
+            append_utf8(out, std::strtoul(std::string{entity.substr(hex ? 2 : 1)}.c_str(), nullptr, hex ? 16 : 10));
+        } else {
+            out += text.substr(i, semicolon - i + 1);
+        }
+        i = semicolon;
+    }
+    return out;
+}
+
+// the namespace prefixes are the ones the writers use, xap is the pre-2004 name of xmp
+static auto is_rating(std::string_view name) -> bool {
+    return name == "xmp:Rating" || name == "xap:Rating";
+}
+
+static auto is_label(std::string_view name) -> bool {
+    return name == "xmp:Label" || name == "xap:Label";
+}
+
+static auto is_tagged(std::string_view name) -> bool {
+    return name == "photomechanic:Tagged" || name == "xmpDM:good";
+}
+
+auto xmp_info(char const* data, std::size_t size) -> std::tuple<int, std::string, int, std::string, std::vector<std::string>> {
+    auto rating{0};
+    std::string label;
+    auto tagged{false};
+    std::string caption;
+    std::vector<std::string> keywords;
+
+    auto const set{[&rating, &label, &tagged](std::string_view name, std::string_view value) -> void {
+        value = trim(value);
+        if (is_rating(name)) {
+            rating = std::max(-1, std::min(5, std::atoi(std::string{value}.c_str())));
+        } else if (is_label(name)) {
+            label = xml_unescape(value);
+        } else if (is_tagged(name)) {
+            tagged = value == "True" || value == "true" || value == "1";
+        }
+    }};
+
+    // property is the element of rdf:Description being read, a value is its text or the text of one of its rdf:li
+    XmlTokenizer tokenizer{data, size};
+    std::string_view property;
+    auto in_item{false};
+    for (auto token{tokenizer.next()}; token.type != XmlTokenType::end; token = tokenizer.next()) {
+        switch (token.type) {
+            case XmlTokenType::open:
+            case XmlTokenType::empty: {
+                std::string_view attributes{token.attributes};
+                std::string_view name;
+                std::string_view value;
+                while (next_xml_attribute(attributes, name, value)) {
+                    set(name, value);
+                }
+                if (token.type == XmlTokenType::open) {
+                    if (token.name == "rdf:li") {
+                        in_item = true;
+                    } else if (property.empty() && (token.name == "dc:subject" || token.name == "dc:description" || is_rating(token.name) || is_label(token.name) || is_tagged(token.name))) {
+                        property = token.name;
+                    }
+                }
+                break;
+            }
+            case XmlTokenType::close:
+                if (token.name == "rdf:li") {
+                    in_item = false;
+                } else if (token.name == property) {
+                    property = {};
+                }
+                break;
+            case XmlTokenType::text: {
+                auto const text{trim(token.text)};
+                if (property.empty() || text.empty()) {
+                    break;
+                }
+                if (property == "dc:subject" && in_item) {
+                    keywords.push_back(xml_unescape(text));
+                } else if (property == "dc:description" && in_item && caption.empty()) {
+                    caption = xml_unescape(text);
+                } else if (!in_item) {
+                    set(property, text);
+                }
+                break;
+            }
+            case XmlTokenType::end:
+                break;
+        }
+    }
+
+    std::sort(keywords.begin(), keywords.end());
+    keywords.erase(std::unique(keywords.begin(), keywords.end()), keywords.end());
+    auto const pick{rating < 0 ? -1 : (tagged ? 1 : 0)};
+    return {rating, label, pick, caption, keywords};
+}
+
+auto xmp_sidecar_path(fs::path const& image_path) -> fs::path {
+    std::error_code ec;
+    auto appended{image_path};
+    appended += ".xmp";
+    if (fs::is_regular_file(appended, ec)) {
+        return appended;
+    }
+    auto replaced{image_path};
+    replaced.replace_extension(".xmp");
+    if (fs::is_regular_file(replaced, ec)) {
+        return replaced;
+    }
+    return {};
+}
+
+} // namespace util
+} // namespace shashin